@@ -0,0 +1,121 @@
+"""
+用主机构建检查推送 从pty送入实时样本和一批补发样本
+用push_sink解码收到的UDP帧 逐条和送入的比较 再确认metrics中没有丢弃
+
+    python check_publisher.py <esp01s_host_udp> [port_offset]
+"""
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+import tty
+import urllib.request
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                "..", "..", "Python", "src"))
+import numpy as np
+
+import protocol
+import push_sink
+
+HOST_IP = "127.0.0.1"
+UDP_PORT = 5020
+METRICS_PORT = 80
+STARTUP_TIMEOUT_S = 10
+RECEIVE_TIMEOUT_S = 5
+# 帧之间留出空闲 让接收超时把它们分成两帧
+FRAME_GAP_S = 0.05
+FIRST_TIMESTAMP = 1767225600
+# 16.21和10.23换成float乘100后略小于整数 截断成centi会差1 ESP01S应四舍五入
+LIVE_SAMPLES = [(16.21, 10.23), (-3.75, 60.0), (0.0, 99.5)]
+BATCH_SAMPLES = [(7, 2015, 5050), (8, 2020, 5100), (9, -125, 0)]
+
+
+def expected_records() -> np.ndarray:
+    """实时样本推送时sequence为0 补发的样本原样推送"""
+    records = [(0, round(t * 100), round(h * 100), FIRST_TIMESTAMP + i)
+               for i, (t, h) in enumerate(LIVE_SAMPLES)]
+    records += [(sequence, t, h, FIRST_TIMESTAMP - 60 * (len(BATCH_SAMPLES) - i))
+                for i, (sequence, t, h) in enumerate(BATCH_SAMPLES)]
+    return np.array(records, dtype=protocol.SAMPLE_RECORD)
+
+
+def wait_for(path: str, process: subprocess.Popen) -> None:
+    deadline = time.monotonic() + STARTUP_TIMEOUT_S
+    while not os.path.exists(path):
+        if process.poll() is not None or time.monotonic() > deadline:
+            raise SystemExit(f"esp01s_host did not create {path}")
+        time.sleep(0.1)
+
+
+def send_frames(uart: int, expected: np.ndarray) -> None:
+    live = len(LIVE_SAMPLES)
+    for (temperature, humidity), record in zip(LIVE_SAMPLES, expected[:live]):
+        os.write(uart, protocol.EspSample.encode(temperature=temperature, humidity=humidity,
+                                                 timestamp=record["timestamp"]))
+        time.sleep(FRAME_GAP_S)
+    os.write(uart, protocol.EspSampleBatch.encode(tail=expected[live:]))
+    time.sleep(FRAME_GAP_S)
+
+
+def receive_records(sink: socket.socket, count: int) -> np.ndarray:
+    received = []
+    deadline = time.monotonic() + RECEIVE_TIMEOUT_S
+    while len(received) < count and time.monotonic() < deadline:
+        sink.settimeout(max(deadline - time.monotonic(), 0.01))
+        try:
+            frame, _ = sink.recvfrom(protocol.MAX_FRAME_SIZE)
+        except socket.timeout:
+            break
+        records = push_sink.handle_frame(HOST_IP, frame)
+        if records is None:
+            raise SystemExit("broken frame from the publisher")
+        received.extend(records.tolist())
+    return np.array(received, dtype=protocol.SAMPLE_RECORD)
+
+
+def read_counter(port_offset: int, name: str) -> int:
+    url = f"http://{HOST_IP}:{METRICS_PORT + port_offset}/metrics"
+    with urllib.request.urlopen(url, timeout=RECEIVE_TIMEOUT_S) as response:
+        for line in response.read().decode().splitlines():
+            if line.startswith(name + " "):
+                return int(line.split()[1])
+    raise SystemExit(f"{name} missing from {url}")
+
+
+def main() -> None:
+    if len(sys.argv) < 2:
+        raise SystemExit(__doc__)
+    port_offset = int(sys.argv[2]) if len(sys.argv) > 2 else 1000
+    expected = expected_records()
+    sink = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sink.bind((HOST_IP, UDP_PORT + port_offset))
+    with tempfile.TemporaryDirectory() as directory:
+        uart_path = os.path.join(directory, "uart")
+        environment = dict(os.environ, ESP01S_HOST_UART=uart_path, ESP01S_HOST_IP=HOST_IP)
+        process = subprocess.Popen([sys.argv[1]], env=environment,
+                                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        try:
+            wait_for(uart_path, process)
+            uart = os.open(uart_path, os.O_RDWR | os.O_NOCTTY)
+            tty.setraw(uart)
+            send_frames(uart, expected)
+            received = receive_records(sink, len(expected))
+            drops = read_counter(port_offset, "humidistat_publisher_dropped_samples_total")
+            os.close(uart)
+        finally:
+            process.terminate()
+            process.wait()
+    if push_sink.lost_frames.get(HOST_IP, 0) != 0:
+        raise SystemExit(f"{push_sink.lost_frames[HOST_IP]} frames lost")
+    if len(received) != len(expected) or not np.array_equal(received, expected):
+        raise SystemExit(f"pushed {received.tolist()}, expected {expected.tolist()}")
+    if drops != 0:
+        raise SystemExit(f"{drops} samples dropped")
+    print(f"{len(received)} samples pushed and decoded")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,38 @@
+#ifndef HOST_ESP_EVENT_H
+#define HOST_ESP_EVENT_H
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_event_base.h"
+#include "esp_wifi_types.h"
+#include "tcpip_adapter.h"
+
+extern esp_event_base_t const WIFI_EVENT;
+extern esp_event_base_t const IP_EVENT;
+
+typedef enum {
+    WIFI_EVENT_WIFI_READY = 0,
+    WIFI_EVENT_SCAN_DONE,
+    WIFI_EVENT_STA_START,
+    WIFI_EVENT_STA_STOP,
+    WIFI_EVENT_STA_CONNECTED,
+    WIFI_EVENT_STA_DISCONNECTED,
+} wifi_event_t;
+
+typedef enum {
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+} ip_event_t;
+
+/**
+ * @brief 与IDF相同 回调在独立的事件任务中执行
+ */
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_register(esp_event_base_t event_base,
+                                     int32_t event_id,
+                                     esp_event_handler_t event_handler,
+                                     void *event_handler_arg);
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
+                         const void *event_data, size_t event_data_size,
+                         uint32_t ticks_to_wait);
+
+#endif // HOST_ESP_EVENT_H
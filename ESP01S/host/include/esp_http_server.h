@@ -0,0 +1,58 @@
+#ifndef HOST_ESP_HTTP_SERVER_H
+#define HOST_ESP_HTTP_SERVER_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+/**
+ * @brief 只实现metrics用到的部分 每个请求处理完即关闭连接
+ */
+typedef void *httpd_handle_t;
+
+typedef enum {
+    HTTP_GET = 1,
+} httpd_method_t;
+
+typedef struct httpd_req {
+    const char *uri;
+    int fd;
+    const char *content_type;
+} httpd_req_t;
+
+typedef struct {
+    unsigned task_priority;
+    size_t stack_size;
+    uint16_t server_port;
+    uint16_t max_open_sockets;
+    uint16_t max_uri_handlers;
+    bool lru_purge_enable;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() {  \
+    .task_priority = 5,           \
+    .stack_size = 4096,           \
+    .server_port = 80,            \
+    .max_open_sockets = 7,        \
+    .max_uri_handlers = 8,        \
+    .lru_purge_enable = false,    \
+}
+
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *r);
+    void *user_ctx;
+} httpd_uri_t;
+
+/**
+ * @brief 监听ESP01S_HOST_IP 端口为server_port加上HOST_PORT_OFFSET
+ */
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
+                                     const httpd_uri_t *uri_handler);
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type);
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len);
+
+#endif // HOST_ESP_HTTP_SERVER_H
@@ -0,0 +1,36 @@
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+#include <stdint.h>
+#include <stdio.h>
+
+#define ESP_LOG_NONE 0
+#define ESP_LOG_ERROR 1
+#define ESP_LOG_WARN 2
+#define ESP_LOG_INFO 3
+#define ESP_LOG_DEBUG 4
+#define ESP_LOG_VERBOSE 5
+
+/* 压测时每帧都打印会成为瓶颈 默认只输出警告和错误 */
+#ifndef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_WARN
+#endif
+
+/**
+ * @brief 启动以来的毫秒数
+ */
+uint32_t esp_log_timestamp(void);
+
+#define ESP_LOG_AT(level, letter, tag, format, ...)                          \
+    do {                                                                     \
+        if (LOG_LOCAL_LEVEL >= (level)) {                                    \
+            printf(letter " (%u) %s: " format "\n",                          \
+                   (unsigned)esp_log_timestamp(), tag, ##__VA_ARGS__);       \
+        }                                                                    \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_AT(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_AT(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_AT(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_AT(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+
+#endif // HOST_ESP_LOG_H
@@ -0,0 +1,31 @@
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+} esp_mac_type_t;
+
+#define CHIP_FEATURE_EMB_FLASH (1 << 0)
+
+#define MAC2STR(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
+#define MACSTR "%02x:%02x:%02x:%02x:%02x:%02x"
+
+typedef struct {
+    uint32_t features;
+    uint8_t cores;
+    uint8_t revision;
+} esp_chip_info_t;
+
+/**
+ * @brief 环境变量ESP01S_HOST_MAC指定时用它 否则由进程号生成本地管理地址
+ * 同时运行多个实例时每个实例的mDNS名称不同
+ */
+esp_err_t esp_read_mac(uint8_t mac[6], esp_mac_type_t type);
+uint32_t esp_get_free_heap_size(void);
+void esp_chip_info(esp_chip_info_t *info);
+void esp_restart(void);
+
+#endif // HOST_ESP_SYSTEM_H
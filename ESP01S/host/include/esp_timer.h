@@ -0,0 +1,10 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+#include <stdint.h>
+
+/**
+ * @brief 启动以来的微秒数 取自CLOCK_MONOTONIC
+ */
+int64_t esp_timer_get_time(void);
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,30 @@
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_interface.h"
+#include "esp_system.h"
+#include "esp_wifi_types.h"
+
+typedef struct {
+    int reserved;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_DEFAULT() { 0 }
+
+/**
+ * @brief 模拟的AP 连接总是成功 IP取环境变量ESP01S_HOST_IP 默认127.0.0.1
+ * BSSID和信道固定 快速连接的缓存可以命中
+ */
+esp_err_t esp_wifi_init(const wifi_init_config_t *config);
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_get_config(esp_interface_t interface, wifi_config_t *conf);
+esp_err_t esp_wifi_set_config(esp_interface_t interface, wifi_config_t *conf);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_disconnect(void);
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info);
+
+#endif // HOST_ESP_WIFI_H
@@ -0,0 +1,23 @@
+#ifndef HOST_LWIP_SOCKETS_H
+#define HOST_LWIP_SOCKETS_H
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief bind改到ESP01S_HOST_IP 端口加上HOST_PORT_OFFSET
+ */
+int host_bind(int fd, const struct sockaddr *address, socklen_t length);
+/**
+ * @brief 不阻塞地轮询 没有就绪时让出一个tick 阻塞的select会卡住POSIX移植的调度器
+ */
+int host_select(int nfds, fd_set *readfds, fd_set *writefds,
+                fd_set *exceptfds, struct timeval *timeout);
+
+#define bind host_bind
+#define select host_select
+
+#endif // HOST_LWIP_SOCKETS_H
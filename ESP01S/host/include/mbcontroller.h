@@ -0,0 +1,79 @@
+#ifndef HOST_MBCONTROLLER_H
+#define HOST_MBCONTROLLER_H
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_bit_defs.h"
+#include "esp_err.h"
+#include "FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+/**
+ * @brief 与esp-modbus从站接口相同的最小Modbus TCP实现
+ * 支持功能码03 04 06 16 寄存器区域和事件通知的语义与esp-modbus一致
+ */
+typedef enum {
+    MB_PARAM_HOLDING = 0x00,
+    MB_PARAM_INPUT,
+    MB_PARAM_COIL,
+    MB_PARAM_DISCRETE,
+    MB_PARAM_COUNT,
+    MB_PARAM_UNKNOWN = 0xFF,
+} mb_param_type_t;
+
+typedef enum {
+    MB_EVENT_NO_EVENTS = 0x00,
+    MB_EVENT_HOLDING_REG_WR = BIT0,
+    MB_EVENT_HOLDING_REG_RD = BIT1,
+    MB_EVENT_INPUT_REG_RD = BIT3,
+    MB_EVENT_COILS_WR = BIT4,
+    MB_EVENT_COILS_RD = BIT5,
+    MB_EVENT_DISCRETE_RD = BIT6,
+    MB_EVENT_STACK_STARTED = BIT7,
+} mb_event_group_t;
+
+typedef enum {
+    MB_MODE_RTU,
+    MB_MODE_ASCII,
+    MB_MODE_TCP,
+    MB_MODE_UDP,
+} mb_mode_type_t;
+
+typedef enum {
+    MB_IPV4 = 0,
+    MB_IPV6 = 1,
+} mb_tcp_addr_type_t;
+
+typedef struct {
+    mb_mode_type_t ip_mode;
+    uint16_t ip_port;
+    mb_tcp_addr_type_t ip_addr_type;
+    void *ip_addr;
+    void *ip_netif_ptr;
+} mb_communication_info_t;
+
+typedef struct {
+    uint16_t start_offset;
+    mb_param_type_t type;
+    void *address;
+    size_t size;
+} mb_register_area_descriptor_t;
+
+typedef struct {
+    uint32_t time_stamp;
+    uint16_t mb_offset;
+    mb_event_group_t type;
+    uint8_t *address;
+    size_t size;
+} mb_param_info_t;
+
+esp_err_t mbc_slave_init_tcp(void **handler);
+esp_err_t mbc_slave_setup(void *comm_info);
+esp_err_t mbc_slave_set_descriptor(mb_register_area_descriptor_t descr_data);
+esp_err_t mbc_slave_start(void);
+esp_err_t mbc_slave_destroy(void);
+mb_event_group_t mbc_slave_check_event(mb_event_group_t group);
+esp_err_t mbc_slave_get_param_info(mb_param_info_t *reg_info, uint32_t timeout);
+
+#endif // HOST_MBCONTROLLER_H
@@ -0,0 +1,25 @@
+#ifndef HOST_NVS_H
+#define HOST_NVS_H
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* 主机上的NVS只保存在内存中 进程退出即丢失 */
+typedef uint32_t nvs_handle;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode open_mode,
+                   nvs_handle *out_handle);
+void nvs_close(nvs_handle handle);
+esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *out_value,
+                       size_t *length);
+esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value,
+                       size_t length);
+esp_err_t nvs_erase_key(nvs_handle handle, const char *key);
+esp_err_t nvs_commit(nvs_handle handle);
+
+#endif // HOST_NVS_H
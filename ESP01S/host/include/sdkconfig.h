@@ -0,0 +1,33 @@
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+/* 主机构建用到的配置项 取值与ESP01S/sdkconfig一致
+ * 监听端口在此基础上加HOST_PORT_OFFSET 见CMakeLists.txt */
+
+#define CONFIG_FMB_TCP_PORT_DEFAULT 502
+#define CONFIG_FMB_TCP_PORT_MAX_CONN 5
+#define CONFIG_FMB_CONTROLLER_SLAVE_ID_SUPPORT 1
+#define CONFIG_FMB_CONTROLLER_SLAVE_ID 0x00112233
+#define CONFIG_FMB_CONTROLLER_NOTIFY_TIMEOUT 20
+#define CONFIG_FMB_CONTROLLER_NOTIFY_QUEUE_SIZE 20
+#define CONFIG_FMB_PORT_TASK_STACK_SIZE 4096
+#define CONFIG_FMB_PORT_TASK_PRIO 10
+
+#define CONFIG_MODBUS_FAST_SLAVE 1
+#define CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS 4
+#define CONFIG_MODBUS_FAST_SLAVE_IDLE_TIMEOUT_S 10
+#define CONFIG_MODBUS_INPUT_FORMAT_FLOAT32 1
+#define CONFIG_MODBUS_INPUT_WORD_ORDER_HIGH_FIRST 1
+#define CONFIG_MODBUS_HOLDING_WORD_ORDER_HIGH_FIRST 1
+
+/* check_publisher.py用的构建打开UDP推送 见CMakeLists.txt */
+#ifdef HOST_PUBLISHER_UDP
+#define CONFIG_PUBLISHER_TRANSPORT_UDP 1
+#define CONFIG_PUBLISHER_UDP_HOST "127.0.0.1"
+#define CONFIG_PUBLISHER_UDP_PORT (5020 + HOST_PORT_OFFSET)
+#define CONFIG_PUBLISHER_BATCH_SIZE 1
+#define CONFIG_PUBLISHER_BATCH_TIMEOUT_MS 1000
+#else
+#define CONFIG_PUBLISHER_TRANSPORT_NONE 1
+#endif
+
+#endif // HOST_SDKCONFIG_H
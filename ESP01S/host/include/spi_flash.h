@@ -0,0 +1,10 @@
+#ifndef HOST_SPI_FLASH_H
+#define HOST_SPI_FLASH_H
+#include <stdint.h>
+
+/* ESP01S为1MB flash */
+static inline uint32_t spi_flash_get_chip_size(void) {
+    return 1024 * 1024;
+}
+
+#endif // HOST_SPI_FLASH_H
@@ -0,0 +1,72 @@
+#ifndef HOST_TCPIP_ADAPTER_H
+#define HOST_TCPIP_ADAPTER_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_ERR_TCPIP_ADAPTER_BASE 0x5000
+#define ESP_ERR_TCPIP_ADAPTER_DHCP_ALREADY_STARTED (ESP_ERR_TCPIP_ADAPTER_BASE + 0x04)
+
+/* 与lwIP相同 网络字节序 */
+typedef struct {
+    uint32_t addr;
+} ip4_addr_t;
+
+typedef struct {
+    ip4_addr_t ip;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+} tcpip_adapter_ip_info_t;
+
+typedef enum {
+    TCPIP_ADAPTER_IF_STA = 0,
+    TCPIP_ADAPTER_IF_AP,
+    TCPIP_ADAPTER_IF_MAX,
+} tcpip_adapter_if_t;
+
+typedef struct {
+    tcpip_adapter_ip_info_t ip_info;
+    bool ip_changed;
+} ip_event_got_ip_t;
+
+/* 主机上只有IPv4 */
+typedef ip4_addr_t ip_addr_t;
+
+typedef enum {
+    TCPIP_ADAPTER_DNS_MAIN = 0,
+    TCPIP_ADAPTER_DNS_BACKUP,
+    TCPIP_ADAPTER_DNS_FALLBACK,
+    TCPIP_ADAPTER_DNS_MAX,
+} tcpip_adapter_dns_type_t;
+
+typedef struct {
+    ip_addr_t ip;
+} tcpip_adapter_dns_info_t;
+
+#define esp_ip4_addr1_16(ipaddr) ((uint16_t)(((const uint8_t *)(&(ipaddr)->addr))[0]))
+#define esp_ip4_addr2_16(ipaddr) ((uint16_t)(((const uint8_t *)(&(ipaddr)->addr))[1]))
+#define esp_ip4_addr3_16(ipaddr) ((uint16_t)(((const uint8_t *)(&(ipaddr)->addr))[2]))
+#define esp_ip4_addr4_16(ipaddr) ((uint16_t)(((const uint8_t *)(&(ipaddr)->addr))[3]))
+#define IP2STR(ipaddr) esp_ip4_addr1_16(ipaddr), esp_ip4_addr2_16(ipaddr), \
+                       esp_ip4_addr3_16(ipaddr), esp_ip4_addr4_16(ipaddr)
+#define IPSTR "%d.%d.%d.%d"
+
+/**
+ * @brief 主机上没有DHCP 停止DHCP只是记下状态 连接时用set_ip_info设置的地址
+ * 已连接时重新启动DHCP会马上再发一次GOT_IP
+ */
+esp_err_t tcpip_adapter_dhcpc_start(tcpip_adapter_if_t tcpip_if);
+esp_err_t tcpip_adapter_dhcpc_stop(tcpip_adapter_if_t tcpip_if);
+esp_err_t tcpip_adapter_set_ip_info(tcpip_adapter_if_t tcpip_if,
+                                    const tcpip_adapter_ip_info_t *ip_info);
+esp_err_t tcpip_adapter_get_ip_info(tcpip_adapter_if_t tcpip_if,
+                                    tcpip_adapter_ip_info_t *ip_info);
+esp_err_t tcpip_adapter_set_dns_info(tcpip_adapter_if_t tcpip_if,
+                                     tcpip_adapter_dns_type_t type,
+                                     tcpip_adapter_dns_info_t *dns);
+esp_err_t tcpip_adapter_get_dns_info(tcpip_adapter_if_t tcpip_if,
+                                     tcpip_adapter_dns_type_t type,
+                                     tcpip_adapter_dns_info_t *dns);
+esp_err_t tcpip_adapter_get_netif(tcpip_adapter_if_t tcpip_if, void **netif);
+
+#endif // HOST_TCPIP_ADAPTER_H
@@ -0,0 +1,71 @@
+#ifndef HOST_UART_H
+#define HOST_UART_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief UART0由一个pty代替 从设备路径在启动时打印
+ * 设置环境变量ESP01S_HOST_UART时再在该路径创建指向它的符号链接
+ */
+typedef enum {
+    UART_NUM_0 = 0,
+    UART_NUM_1,
+    UART_NUM_MAX,
+} uart_port_t;
+
+typedef enum {
+    UART_DATA_5_BITS,
+    UART_DATA_6_BITS,
+    UART_DATA_7_BITS,
+    UART_DATA_8_BITS,
+} uart_word_length_t;
+
+typedef enum {
+    UART_STOP_BITS_1 = 1,
+    UART_STOP_BITS_1_5,
+    UART_STOP_BITS_2,
+} uart_stop_bits_t;
+
+typedef enum {
+    UART_PARITY_DISABLE,
+    UART_PARITY_EVEN = 2,
+    UART_PARITY_ODD,
+} uart_parity_t;
+
+typedef enum {
+    UART_HW_FLOWCTRL_DISABLE,
+    UART_HW_FLOWCTRL_RTS,
+    UART_HW_FLOWCTRL_CTS,
+    UART_HW_FLOWCTRL_CTS_RTS,
+} uart_hw_flowcontrol_t;
+
+typedef struct {
+    int baud_rate;
+    uart_word_length_t data_bits;
+    uart_parity_t parity;
+    uart_stop_bits_t stop_bits;
+    uart_hw_flowcontrol_t flow_ctrl;
+    uint8_t rx_flow_ctrl_thresh;
+} uart_config_t;
+
+#define UART_RXFIFO_FULL_INT_ENA_M (1 << 0)
+#define UART_RXFIFO_TOUT_INT_ENA_M (1 << 8)
+
+typedef struct {
+    uint32_t intr_enable_mask;
+    uint8_t rx_timeout_thresh;
+    uint8_t txfifo_empty_intr_thresh;
+    uint8_t rxfifo_full_thresh;
+} uart_intr_config_t;
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *config);
+esp_err_t uart_isr_register(uart_port_t uart_num, void (*fn)(void *),
+                            void *arg);
+/**
+ * @brief 按阈值启动模拟中断的任务 之后pty上收到的字节进入模拟的RX FIFO
+ */
+esp_err_t uart_intr_config(uart_port_t uart_num,
+                           const uart_intr_config_t *intr_conf);
+
+#endif // HOST_UART_H
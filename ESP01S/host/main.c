@@ -0,0 +1,63 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "freertos/task.h"
+
+/* 最多统计这么多个任务 */
+#define MAX_REPORTED_TASKS 24
+
+void app_main(void);
+
+static void app_main_task(void *pvParameters);
+static void stats_task(void *pvParameters);
+
+/**
+ * @brief 和ESP8266上一样 app_main在一个任务中执行 返回后删除该任务
+ */
+static void app_main_task(void *pvParameters) {
+    app_main();
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief 定期打印每个任务栈的历史最小剩余 用于确定设备上的栈大小
+ * POSIX移植中栈由pthread分配 数值只能作为参考 以设备上的测量为准
+ */
+static void stats_task(void *pvParameters) {
+    const TickType_t period = pdMS_TO_TICKS(1000 * (intptr_t)pvParameters);
+    TaskStatus_t tasks[MAX_REPORTED_TASKS];
+    while (1) {
+        vTaskDelay(period);
+        UBaseType_t count = uxTaskGetSystemState(tasks, MAX_REPORTED_TASKS,
+                                                 NULL);
+        printf("%-28s %4s %10s\n", "task", "prio", "stack_free");
+        for (UBaseType_t i = 0; i < count; i++) {
+            printf("%-28s %4u %10u\n", tasks[i].pcTaskName,
+                   (unsigned)tasks[i].uxCurrentPriority,
+                   (unsigned)(tasks[i].usStackHighWaterMark *
+                              sizeof(StackType_t)));
+        }
+        fflush(stdout);
+    }
+}
+
+void vAssertCalled(const char *file, int line) {
+    fprintf(stderr, "Assertion failed at %s:%d\n", file, line);
+    abort();
+}
+
+int main(void) {
+    // 对端关闭连接或pty时不退出
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    xTaskCreate(app_main_task, "main", 3584, NULL, 1, NULL);
+    const char *stats_seconds = getenv("ESP01S_HOST_STATS_S");
+    if (stats_seconds != NULL && atoi(stats_seconds) > 0) {
+        xTaskCreate(stats_task, "host_stats", 4096,
+                    (void *)(intptr_t)atoi(stats_seconds), 1, NULL);
+    }
+    vTaskStartScheduler();
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,64 @@
+#ifndef UART_FIFO_H
+#define UART_FIFO_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+/**
+ * @brief main/port/uart_fifo.h的主机版本 读写模拟的UART0 FIFO
+ * 模拟中断的任务只在FIFO到达阈值或空闲超时时调用app_uart的中断函数
+ */
+#define UART_FIFO_SIZE 128
+
+typedef struct {
+    uint8_t rx[UART_FIFO_SIZE];
+    uint16_t rx_head;
+    uint16_t rx_count;
+    bool is_rx_timeout;
+} host_uart_fifo_t;
+
+extern host_uart_fifo_t host_uart0;
+
+/**
+ * @brief 直接写到pty 对端来不及读时等待
+ */
+void host_uart_write_byte(uint8_t byte);
+
+/* ESP8266的portYIELD_FROM_ISR不带参数 POSIX移植的带一个参数 */
+#undef portYIELD_FROM_ISR
+#define portYIELD_FROM_ISR() portYIELD()
+
+static inline uint32_t uart_fifo_interrupt_status(void) {
+    return host_uart0.is_rx_timeout;
+}
+
+static inline bool uart_fifo_is_rx_timeout(void) {
+    return host_uart0.is_rx_timeout;
+}
+
+static inline void uart_fifo_clear_interrupt(uint32_t status) {
+    (void)status;
+    host_uart0.is_rx_timeout = false;
+}
+
+static inline uint32_t uart_fifo_rx_count(void) {
+    return host_uart0.rx_count;
+}
+
+static inline uint8_t uart_fifo_read(void) {
+    uint8_t byte = host_uart0.rx[host_uart0.rx_head];
+    host_uart0.rx_head = (host_uart0.rx_head + 1) % UART_FIFO_SIZE;
+    host_uart0.rx_count--;
+    return byte;
+}
+
+/* 发送直接进pty 不会积压 */
+static inline uint32_t uart_fifo_tx_count(void) {
+    return 0;
+}
+
+static inline void uart_fifo_write(uint8_t byte) {
+    host_uart_write_byte(byte);
+}
+
+#endif // UART_FIFO_H
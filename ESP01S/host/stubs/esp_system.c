@@ -0,0 +1,101 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "host_net.h"
+
+static int64_t monotonic_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int64_t start_us = 0;
+
+int64_t esp_timer_get_time(void) {
+    if (start_us == 0) {
+        start_us = monotonic_us();
+    }
+    return monotonic_us() - start_us;
+}
+
+uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+esp_err_t esp_read_mac(uint8_t mac[6], esp_mac_type_t type) {
+    (void)type;
+    const char *text = getenv("ESP01S_HOST_MAC");
+    unsigned int bytes[6];
+    if (text != NULL &&
+        sscanf(text, "%x:%x:%x:%x:%x:%x", &bytes[0], &bytes[1], &bytes[2],
+               &bytes[3], &bytes[4], &bytes[5]) == 6) {
+        for (int i = 0; i < 6; i++) {
+            mac[i] = (uint8_t)bytes[i];
+        }
+        return ESP_OK;
+    }
+    // 02开头为本地管理地址 后四字节取进程号
+    uint32_t pid = (uint32_t)getpid();
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    mac[2] = (uint8_t)(pid >> 24);
+    mac[3] = (uint8_t)(pid >> 16);
+    mac[4] = (uint8_t)(pid >> 8);
+    mac[5] = (uint8_t)pid;
+    return ESP_OK;
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    struct mallinfo2 info = mallinfo2();
+    return (uint32_t)info.fordblks;
+}
+
+void esp_chip_info(esp_chip_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    info->cores = 1;
+}
+
+void esp_restart(void) {
+    fprintf(stderr, "esp_restart() called, exiting\n");
+    exit(EXIT_FAILURE);
+}
+
+struct in_addr host_net_address(void) {
+    struct in_addr address = { .s_addr = htonl(INADDR_LOOPBACK) };
+    const char *text = getenv("ESP01S_HOST_IP");
+    if (text != NULL && inet_pton(AF_INET, text, &address) != 1) {
+        fprintf(stderr, "Invalid ESP01S_HOST_IP %s, using 127.0.0.1\n", text);
+        address.s_addr = htonl(INADDR_LOOPBACK);
+    }
+    return address;
+}
+
+int host_net_listen(uint16_t device_port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)(device_port + HOST_PORT_OFFSET)),
+        .sin_addr = host_net_address(),
+    };
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(fd, 16) != 0) {
+        perror("host_net_listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
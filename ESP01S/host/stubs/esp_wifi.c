@@ -0,0 +1,266 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "host_net.h"
+#include "tcpip_adapter.h"
+
+#define EVENT_QUEUE_LENGTH 16
+#define MAX_EVENT_HANDLERS 8
+#define EVENT_DATA_SIZE 48
+
+/* 模拟AP的BSSID和信道 */
+static const uint8_t kHostBssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+#define HOST_CHANNEL 6
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    uint8_t data[EVENT_DATA_SIZE];
+} host_event_t;
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} host_handler_t;
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+static const char kTag[] = "HOST_WIFI";
+static QueueHandle_t event_queue = NULL;
+static host_handler_t handlers[MAX_EVENT_HANDLERS];
+static int handler_count = 0;
+static wifi_config_t sta_config = {0};
+static bool is_connected = false;
+static bool is_dhcp_stopped = false;
+static tcpip_adapter_ip_info_t static_ip = {0};
+static tcpip_adapter_ip_info_t current_ip = {0};
+static int netif_placeholder = 0;
+static tcpip_adapter_dns_info_t dns_main = {0};
+
+/**
+ * @brief 与IDF的默认事件循环一样 所有回调在同一个任务中依次执行
+ */
+static esp_err_t post_got_ip(void);
+
+static void event_task(void *pvParameters) {
+    host_event_t event;
+    while (1) {
+        if (xQueueReceive(event_queue, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        for (int i = 0; i < handler_count; i++) {
+            if (handlers[i].base == event.base &&
+                (handlers[i].id == ESP_EVENT_ANY_ID ||
+                 handlers[i].id == event.id)) {
+                handlers[i].handler(handlers[i].arg, event.base, event.id,
+                                    event.data);
+            }
+        }
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void) {
+    event_queue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(host_event_t));
+    if (event_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskCreate(event_task, "sys_evt", 4096, NULL, 20, NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base,
+                                     int32_t event_id,
+                                     esp_event_handler_t event_handler,
+                                     void *event_handler_arg) {
+    if (handler_count >= MAX_EVENT_HANDLERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    handlers[handler_count++] = (host_handler_t){
+        .base = event_base,
+        .id = event_id,
+        .handler = event_handler,
+        .arg = event_handler_arg,
+    };
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
+                         const void *event_data, size_t event_data_size,
+                         uint32_t ticks_to_wait) {
+    host_event_t event = {.base = event_base, .id = event_id};
+    if (event_data_size > sizeof(event.data)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (event_data != NULL) {
+        memcpy(event.data, event_data, event_data_size);
+    }
+    return xQueueSend(event_queue, &event, ticks_to_wait) == pdTRUE
+               ? ESP_OK
+               : ESP_FAIL;
+}
+
+esp_err_t esp_netif_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config) {
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage) {
+    (void)storage;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode) {
+    (void)mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(esp_interface_t interface, wifi_config_t *conf) {
+    (void)interface;
+    *conf = sta_config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(esp_interface_t interface, wifi_config_t *conf) {
+    (void)interface;
+    sta_config = *conf;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void) {
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0,
+                          portMAX_DELAY);
+}
+
+/**
+ * @brief 关联总是成功 DHCP停止时用set_ip_info设置的地址 否则用ESP01S_HOST_IP
+ */
+esp_err_t esp_wifi_connect(void) {
+    if (is_connected) {
+        return ESP_OK;
+    }
+    is_connected = true;
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, NULL, 0,
+                   portMAX_DELAY);
+    return post_got_ip();
+}
+
+static esp_err_t post_got_ip(void) {
+    ip_event_got_ip_t event = {0};
+    if (is_dhcp_stopped && static_ip.ip.addr != 0) {
+        event.ip_info = static_ip;
+    } else {
+        event.ip_info.ip.addr = host_net_address().s_addr;
+        event.ip_info.netmask.addr = htonl(0xFF000000);
+        event.ip_info.gw.addr = event.ip_info.ip.addr;
+    }
+    event.ip_changed = event.ip_info.ip.addr != current_ip.ip.addr;
+    current_ip = event.ip_info;
+    ESP_LOGI(kTag, "Connected to %.32s, ip " IPSTR, sta_config.sta.ssid,
+             IP2STR(&current_ip.ip));
+    return esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event),
+                          portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_disconnect(void) {
+    if (!is_connected) {
+        return ESP_OK;
+    }
+    is_connected = false;
+    // 与SDK一样 主动断开的原因是ASSOC_LEAVE
+    wifi_event_sta_disconnected_t event = {0};
+    memcpy(event.ssid, sta_config.sta.ssid, sizeof(event.ssid));
+    event.ssid_len = (uint8_t)strnlen((const char *)event.ssid, sizeof(event.ssid));
+    memcpy(event.bssid, kHostBssid, sizeof(kHostBssid));
+    event.reason = WIFI_REASON_ASSOC_LEAVE;
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event,
+                          sizeof(event), portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type) {
+    (void)type;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info) {
+    if (!is_connected) {
+        return ESP_FAIL;
+    }
+    memset(ap_info, 0, sizeof(*ap_info));
+    memcpy(ap_info->bssid, kHostBssid, sizeof(kHostBssid));
+    memcpy(ap_info->ssid, sta_config.sta.ssid, sizeof(sta_config.sta.ssid));
+    ap_info->primary = HOST_CHANNEL;
+    ap_info->rssi = -40;
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_dhcpc_start(tcpip_adapter_if_t tcpip_if) {
+    (void)tcpip_if;
+    if (!is_dhcp_stopped) {
+        return ESP_ERR_TCPIP_ADAPTER_DHCP_ALREADY_STARTED;
+    }
+    is_dhcp_stopped = false;
+    // 已连接时模拟DHCP马上分到地址
+    return is_connected ? post_got_ip() : ESP_OK;
+}
+
+esp_err_t tcpip_adapter_dhcpc_stop(tcpip_adapter_if_t tcpip_if) {
+    (void)tcpip_if;
+    is_dhcp_stopped = true;
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_set_ip_info(tcpip_adapter_if_t tcpip_if,
+                                    const tcpip_adapter_ip_info_t *ip_info) {
+    (void)tcpip_if;
+    static_ip = *ip_info;
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_get_ip_info(tcpip_adapter_if_t tcpip_if,
+                                    tcpip_adapter_ip_info_t *ip_info) {
+    (void)tcpip_if;
+    *ip_info = current_ip;
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_set_dns_info(tcpip_adapter_if_t tcpip_if,
+                                     tcpip_adapter_dns_type_t type,
+                                     tcpip_adapter_dns_info_t *dns) {
+    (void)tcpip_if;
+    if (type != TCPIP_ADAPTER_DNS_MAIN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    dns_main = *dns;
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_get_dns_info(tcpip_adapter_if_t tcpip_if,
+                                     tcpip_adapter_dns_type_t type,
+                                     tcpip_adapter_dns_info_t *dns) {
+    (void)tcpip_if;
+    if (type != TCPIP_ADAPTER_DNS_MAIN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *dns = dns_main;
+    return ESP_OK;
+}
+
+esp_err_t tcpip_adapter_get_netif(tcpip_adapter_if_t tcpip_if, void **netif) {
+    (void)tcpip_if;
+    *netif = &netif_placeholder;
+    return ESP_OK;
+}
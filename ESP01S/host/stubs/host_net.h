@@ -0,0 +1,24 @@
+#ifndef HOST_NET_H
+#define HOST_NET_H
+#include <stdint.h>
+#include <netinet/in.h>
+
+/* 特权端口要root才能监听 所有监听端口都加上这个偏移 */
+#ifndef HOST_PORT_OFFSET
+#define HOST_PORT_OFFSET 0
+#endif
+
+/**
+ * @brief 模拟设备的IP 取环境变量ESP01S_HOST_IP 默认127.0.0.1
+ * 多个实例用127.0.0.x中不同的地址 就能同时监听相同的端口
+ */
+struct in_addr host_net_address(void);
+
+/**
+ * @brief 在host_net_address上创建非阻塞的监听socket
+ *
+ * @return 失败时返回-1
+ */
+int host_net_listen(uint16_t device_port);
+
+#endif // HOST_NET_H
@@ -0,0 +1,158 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "host_net.h"
+
+#define MAX_URI_HANDLERS 4
+#define REQUEST_BUFFER_SIZE 1024
+/* 请求头迟迟收不完时放弃这个连接 */
+#define REQUEST_TIMEOUT_MS 1000
+
+typedef struct {
+    int listen_fd;
+    TaskHandle_t task;
+    httpd_uri_t handlers[MAX_URI_HANDLERS];
+    int handler_count;
+} host_httpd_t;
+
+static void server_task(void *pvParameters);
+static void serve_connection(host_httpd_t *server, int fd);
+static esp_err_t send_all(int fd, const char *data, size_t length);
+
+static const char kTag[] = "HOST_HTTPD";
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    host_httpd_t *server = calloc(1, sizeof(host_httpd_t));
+    if (server == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    server->listen_fd = host_net_listen(config->server_port);
+    if (server->listen_fd < 0) {
+        free(server);
+        return ESP_FAIL;
+    }
+    xTaskCreate(server_task, "httpd", config->stack_size, server,
+                config->task_priority, &server->task);
+    *handle = server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    host_httpd_t *server = handle;
+    vTaskDelete(server->task);
+    close(server->listen_fd);
+    free(server);
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
+                                     const httpd_uri_t *uri_handler) {
+    host_httpd_t *server = handle;
+    if (server->handler_count >= MAX_URI_HANDLERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    server->handlers[server->handler_count++] = *uri_handler;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type) {
+    r->content_type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+    char header[160];
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.1 200 OK\r\n"
+                          "Content-Type: %s\r\n"
+                          "Content-Length: %d\r\n"
+                          "Connection: close\r\n\r\n",
+                          r->content_type, (int)buf_len);
+    if (send_all(r->fd, header, length) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return send_all(r->fd, buf, buf_len);
+}
+
+static void server_task(void *pvParameters) {
+    host_httpd_t *server = pvParameters;
+    while (1) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            vTaskDelay(1);
+            continue;
+        }
+        serve_connection(server, fd);
+        close(fd);
+    }
+}
+
+/**
+ * @brief 只看请求行 方法不是GET或路径没有注册时回复404
+ */
+static void serve_connection(host_httpd_t *server, int fd) {
+    char request[REQUEST_BUFFER_SIZE];
+    size_t length = 0;
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(REQUEST_TIMEOUT_MS);
+    while (length < sizeof(request) - 1) {
+        ssize_t received = recv(fd, request + length,
+                                sizeof(request) - 1 - length, MSG_DONTWAIT);
+        if (received > 0) {
+            length += received;
+            request[length] = '\0';
+            if (strstr(request, "\r\n\r\n") != NULL) {
+                break;
+            }
+        } else if (received == 0 ||
+                   (errno != EAGAIN && errno != EINTR) ||
+                   (int32_t)(xTaskGetTickCount() - deadline) > 0) {
+            return;
+        } else {
+            vTaskDelay(1);
+        }
+    }
+    request[length] = '\0';
+
+    char path[128];
+    if (sscanf(request, "GET %127s ", path) == 1) {
+        for (int i = 0; i < server->handler_count; i++) {
+            if (server->handlers[i].method == HTTP_GET &&
+                strcmp(server->handlers[i].uri, path) == 0) {
+                httpd_req_t req = {
+                    .uri = path,
+                    .fd = fd,
+                    .content_type = "text/html",
+                };
+                server->handlers[i].handler(&req);
+                return;
+            }
+        }
+    }
+    ESP_LOGW(kTag, "No handler for %.40s", request);
+    static const char kNotFound[] =
+        "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    send_all(fd, kNotFound, sizeof(kNotFound) - 1);
+}
+
+static esp_err_t send_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent > 0) {
+            data += sent;
+            length -= sent;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EINTR)) {
+            vTaskDelay(1);
+        } else {
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,336 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "host_net.h"
+#include "mbcontroller.h"
+#include "sdkconfig.h"
+
+/* MBAP头7字节 PDU最长253字节 */
+#define MB_TCP_HEADER_SIZE 7
+#define MB_TCP_FRAME_SIZE 260
+#define MB_REGISTER_MAX_READ 125
+#define MB_REGISTER_MAX_WRITE 123
+#define MB_EXCEPTION_ILLEGAL_FUNCTION 0x01
+#define MB_EXCEPTION_ILLEGAL_DATA_ADDRESS 0x02
+#define MB_EXCEPTION_ILLEGAL_DATA_VALUE 0x03
+#define MAX_AREAS 4
+
+typedef struct {
+    int fd;
+    uint8_t frame[MB_TCP_FRAME_SIZE];
+    uint16_t length;
+} mb_connection_t;
+
+static void mb_port_task(void *pvParameters);
+static void accept_connections(void);
+static bool receive_requests(mb_connection_t *connection);
+static uint16_t handle_pdu(const uint8_t request[], uint16_t length,
+                           uint8_t response[]);
+static uint16_t access_registers(mb_param_type_t type, uint16_t address,
+                                 uint16_t count, uint8_t data[], bool is_write);
+static void notify(mb_event_group_t event, uint16_t address,
+                   uint8_t *instance, uint16_t count);
+
+static const char kTag[] = "HOST_MB";
+static mb_communication_info_t comm_info = {0};
+static mb_register_area_descriptor_t areas[MAX_AREAS];
+static int area_count = 0;
+static EventGroupHandle_t event_group = NULL;
+static QueueHandle_t param_queue = NULL;
+static TaskHandle_t port_task = NULL;
+static int listen_fd = -1;
+static mb_connection_t connections[CONFIG_FMB_TCP_PORT_MAX_CONN];
+
+esp_err_t mbc_slave_init_tcp(void **handler) {
+    event_group = xEventGroupCreate();
+    param_queue = xQueueCreate(CONFIG_FMB_CONTROLLER_NOTIFY_QUEUE_SIZE,
+                               sizeof(mb_param_info_t));
+    if (event_group == NULL || param_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    area_count = 0;
+    for (int i = 0; i < CONFIG_FMB_TCP_PORT_MAX_CONN; i++) {
+        connections[i].fd = -1;
+    }
+    *handler = &comm_info;
+    return ESP_OK;
+}
+
+esp_err_t mbc_slave_setup(void *comm_info_ptr) {
+    comm_info = *(mb_communication_info_t *)comm_info_ptr;
+    return comm_info.ip_mode == MB_MODE_TCP ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mbc_slave_set_descriptor(mb_register_area_descriptor_t descr_data) {
+    if (area_count >= MAX_AREAS || descr_data.address == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    areas[area_count++] = descr_data;
+    return ESP_OK;
+}
+
+esp_err_t mbc_slave_start(void) {
+    listen_fd = host_net_listen(comm_info.ip_port);
+    if (listen_fd < 0) {
+        return ESP_FAIL;
+    }
+    xTaskCreate(mb_port_task, "mb_port", CONFIG_FMB_PORT_TASK_STACK_SIZE, NULL,
+                CONFIG_FMB_PORT_TASK_PRIO, &port_task);
+    xEventGroupSetBits(event_group, MB_EVENT_STACK_STARTED);
+    ESP_LOGI(kTag, "Modbus TCP on port %d",
+             comm_info.ip_port + HOST_PORT_OFFSET);
+    return ESP_OK;
+}
+
+esp_err_t mbc_slave_destroy(void) {
+    if (port_task != NULL) {
+        vTaskDelete(port_task);
+        port_task = NULL;
+    }
+    for (int i = 0; i < CONFIG_FMB_TCP_PORT_MAX_CONN; i++) {
+        if (connections[i].fd >= 0) {
+            close(connections[i].fd);
+            connections[i].fd = -1;
+        }
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        listen_fd = -1;
+    }
+    vEventGroupDelete(event_group);
+    vQueueDelete(param_queue);
+    event_group = NULL;
+    param_queue = NULL;
+    return ESP_OK;
+}
+
+mb_event_group_t mbc_slave_check_event(mb_event_group_t group) {
+    EventBits_t bits = xEventGroupWaitBits(event_group, group, pdTRUE, pdFALSE,
+                                           portMAX_DELAY);
+    return (mb_event_group_t)(bits & group);
+}
+
+esp_err_t mbc_slave_get_param_info(mb_param_info_t *reg_info,
+                                   uint32_t timeout) {
+    return xQueueReceive(param_queue, reg_info, pdMS_TO_TICKS(timeout)) == pdTRUE
+               ? ESP_OK
+               : ESP_ERR_TIMEOUT;
+}
+
+/**
+ * @brief 接受新连接并处理所有连接上已收到的请求 没有数据时让出一个tick
+ */
+static void mb_port_task(void *pvParameters) {
+    while (1) {
+        accept_connections();
+        bool is_busy = false;
+        for (int i = 0; i < CONFIG_FMB_TCP_PORT_MAX_CONN; i++) {
+            if (connections[i].fd >= 0 && receive_requests(&connections[i])) {
+                is_busy = true;
+            }
+        }
+        if (!is_busy) {
+            vTaskDelay(1);
+        }
+    }
+}
+
+static void accept_connections(void) {
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        int slot = -1;
+        for (int i = 0; i < CONFIG_FMB_TCP_PORT_MAX_CONN; i++) {
+            if (connections[i].fd < 0) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            ESP_LOGW(kTag, "Too many connections, closing the new one");
+            close(fd);
+            continue;
+        }
+        connections[slot].fd = fd;
+        connections[slot].length = 0;
+    }
+}
+
+/**
+ * @brief 收到完整的ADU就回复 一次recv可能带多个请求 也可能只有半个
+ *
+ * @return 这次收到了数据时返回true
+ */
+static bool receive_requests(mb_connection_t *connection) {
+    ssize_t received = recv(connection->fd, connection->frame + connection->length,
+                             sizeof(connection->frame) - connection->length,
+                             MSG_DONTWAIT);
+    if (received < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return false;
+    }
+    if (received <= 0) {
+        close(connection->fd);
+        connection->fd = -1;
+        return false;
+    }
+    connection->length += received;
+
+    while (connection->length >= MB_TCP_HEADER_SIZE) {
+        uint8_t *frame = connection->frame;
+        uint16_t pdu_length = ((frame[4] << 8) | frame[5]) - 1;
+        if (pdu_length == 0 || pdu_length > MB_TCP_FRAME_SIZE - MB_TCP_HEADER_SIZE) {
+            ESP_LOGW(kTag, "Bad MBAP length, closing connection");
+            close(connection->fd);
+            connection->fd = -1;
+            return true;
+        }
+        uint16_t adu_length = MB_TCP_HEADER_SIZE + pdu_length;
+        if (connection->length < adu_length) {
+            break;
+        }
+        uint8_t response[MB_TCP_FRAME_SIZE];
+        memcpy(response, frame, MB_TCP_HEADER_SIZE);
+        uint16_t response_pdu = handle_pdu(frame + MB_TCP_HEADER_SIZE,
+                                           pdu_length,
+                                           response + MB_TCP_HEADER_SIZE);
+        response[4] = (response_pdu + 1) >> 8;
+        response[5] = (response_pdu + 1) & 0xFF;
+        send(connection->fd, response, MB_TCP_HEADER_SIZE + response_pdu,
+             MSG_NOSIGNAL);
+        connection->length -= adu_length;
+        memmove(frame, frame + adu_length, connection->length);
+    }
+    return true;
+}
+
+/**
+ * @brief 处理03 04 06 16 其余功能码回复异常01
+ *
+ * @return 响应PDU的长度
+ */
+static uint16_t handle_pdu(const uint8_t request[], uint16_t length,
+                           uint8_t response[]) {
+    uint8_t function = request[0];
+    uint16_t address = length >= 3 ? (request[1] << 8) | request[2] : 0;
+    uint16_t count = length >= 5 ? (request[3] << 8) | request[4] : 0;
+    uint8_t exception = 0;
+    uint16_t response_length = 0;
+    response[0] = function;
+
+    switch (function) {
+    case 0x03:
+    case 0x04:
+        if (length != 5 || count == 0 || count > MB_REGISTER_MAX_READ) {
+            exception = MB_EXCEPTION_ILLEGAL_DATA_VALUE;
+            break;
+        }
+        exception = access_registers(
+            function == 0x03 ? MB_PARAM_HOLDING : MB_PARAM_INPUT, address,
+            count, &response[2], false);
+        response[1] = count * 2;
+        response_length = 2 + count * 2;
+        break;
+    case 0x06:
+        if (length != 5) {
+            exception = MB_EXCEPTION_ILLEGAL_DATA_VALUE;
+            break;
+        }
+        exception = access_registers(MB_PARAM_HOLDING, address, 1,
+                                     (uint8_t *)&request[3], true);
+        memcpy(response, request, 5);
+        response_length = 5;
+        break;
+    case 0x10:
+        if (length < 6 || count == 0 || count > MB_REGISTER_MAX_WRITE ||
+            request[5] != count * 2 || length != 6 + count * 2) {
+            exception = MB_EXCEPTION_ILLEGAL_DATA_VALUE;
+            break;
+        }
+        exception = access_registers(MB_PARAM_HOLDING, address, count,
+                                     (uint8_t *)&request[6], true);
+        memcpy(response, request, 5);
+        response_length = 5;
+        break;
+    default:
+        exception = MB_EXCEPTION_ILLEGAL_FUNCTION;
+        break;
+    }
+
+    if (exception != 0) {
+        response[0] = function | 0x80;
+        response[1] = exception;
+        return 2;
+    }
+    return response_length;
+}
+
+/**
+ * @brief 寄存器在内存中按小端存放 线上按大端传输 与esp-modbus相同
+ * 访问整个落在某个已登记区域内才成功 否则返回异常02
+ *
+ * @return 0或异常码
+ */
+static uint16_t access_registers(mb_param_type_t type, uint16_t address,
+                                 uint16_t count, uint8_t data[], bool is_write) {
+    for (int i = 0; i < area_count; i++) {
+        const mb_register_area_descriptor_t *area = &areas[i];
+        uint32_t area_count_regs = area->size / 2;
+        if (area->type != type || address < area->start_offset ||
+            address + count > area->start_offset + area_count_regs) {
+            continue;
+        }
+        uint8_t *instance = (uint8_t *)area->address +
+                            (address - area->start_offset) * 2;
+        taskENTER_CRITICAL();
+        for (uint16_t reg = 0; reg < count; reg++) {
+            uint8_t *value = instance + reg * 2;
+            if (is_write) {
+                value[1] = data[reg * 2];
+                value[0] = data[reg * 2 + 1];
+            } else {
+                data[reg * 2] = value[1];
+                data[reg * 2 + 1] = value[0];
+            }
+        }
+        taskEXIT_CRITICAL();
+        mb_event_group_t event;
+        if (type == MB_PARAM_INPUT) {
+            event = MB_EVENT_INPUT_REG_RD;
+        } else {
+            event = is_write ? MB_EVENT_HOLDING_REG_WR : MB_EVENT_HOLDING_REG_RD;
+        }
+        notify(event, address, instance, count);
+        return 0;
+    }
+    return MB_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+}
+
+/**
+ * @brief 与esp-modbus一样 队列满时等待CONFIG_FMB_CONTROLLER_NOTIFY_TIMEOUT后丢弃
+ */
+static void notify(mb_event_group_t event, uint16_t address,
+                   uint8_t *instance, uint16_t count) {
+    mb_param_info_t info = {
+        .time_stamp = (uint32_t)esp_timer_get_time(),
+        .mb_offset = address,
+        .type = event,
+        .address = instance,
+        .size = count,
+    };
+    if (xQueueSend(param_queue, &info,
+                   pdMS_TO_TICKS(CONFIG_FMB_CONTROLLER_NOTIFY_TIMEOUT)) != pdTRUE) {
+        ESP_LOGW(kTag, "Parameter queue full, event info dropped");
+    }
+    xEventGroupSetBits(event_group, event);
+}
@@ -0,0 +1,42 @@
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "mdns.h"
+
+/* 只打印 收集端在主机上直接用ESP01S_HOST_IP访问 */
+static const char kTag[] = "HOST_MDNS";
+
+esp_err_t mdns_init(void) {
+    return ESP_OK;
+}
+
+void mdns_free(void) {
+}
+
+esp_err_t mdns_hostname_set(const char *hostname) {
+    ESP_LOGI(kTag, "hostname %s.local", hostname);
+    return ESP_OK;
+}
+
+esp_err_t mdns_instance_name_set(const char *instance_name) {
+    ESP_LOGI(kTag, "instance %s", instance_name);
+    return ESP_OK;
+}
+
+esp_err_t mdns_service_add(const char *instance_name, const char *service_type,
+                           const char *proto, uint16_t port,
+                           mdns_txt_item_t txt[], size_t num_items) {
+    ESP_LOGI(kTag, "service %s.%s.%s port %u", instance_name, service_type,
+             proto, port);
+    for (size_t i = 0; i < num_items; i++) {
+        ESP_LOGI(kTag, "  txt %s=%s", txt[i].key, txt[i].value);
+    }
+    return ESP_OK;
+}
+
+esp_err_t mdns_service_txt_item_set(const char *service_type,
+                                    const char *proto, const char *key,
+                                    const char *value) {
+    ESP_LOGI(kTag, "service %s.%s txt %s=%s", service_type, proto, key, value);
+    return ESP_OK;
+}
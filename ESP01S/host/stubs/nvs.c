@@ -0,0 +1,130 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+/* 只有fast_connect在用 几项足够 */
+#define NVS_MAX_ENTRIES 16
+#define NVS_MAX_NAMESPACES 8
+#define NVS_MAX_KEY_LENGTH 16
+#define NVS_MAX_BLOB_SIZE 256
+
+typedef struct {
+    bool is_used;
+    nvs_handle namespace_index;
+    char key[NVS_MAX_KEY_LENGTH];
+    uint8_t value[NVS_MAX_BLOB_SIZE];
+    size_t length;
+} nvs_entry_t;
+
+static char namespaces[NVS_MAX_NAMESPACES][NVS_MAX_KEY_LENGTH];
+static nvs_entry_t entries[NVS_MAX_ENTRIES];
+
+static nvs_entry_t *find_entry(nvs_handle handle, const char *key) {
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if (entries[i].is_used && entries[i].namespace_index == handle &&
+            strncmp(entries[i].key, key, NVS_MAX_KEY_LENGTH) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    taskENTER_CRITICAL();
+    memset(entries, 0, sizeof(entries));
+    taskEXIT_CRITICAL();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode open_mode,
+                   nvs_handle *out_handle) {
+    (void)open_mode;
+    esp_err_t result = ESP_ERR_NO_MEM;
+    taskENTER_CRITICAL();
+    for (int i = 0; i < NVS_MAX_NAMESPACES; i++) {
+        if (namespaces[i][0] == '\0') {
+            strncpy(namespaces[i], name, NVS_MAX_KEY_LENGTH - 1);
+        }
+        if (strncmp(namespaces[i], name, NVS_MAX_KEY_LENGTH - 1) == 0) {
+            *out_handle = (nvs_handle)i;
+            result = ESP_OK;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return result;
+}
+
+void nvs_close(nvs_handle handle) {
+    (void)handle;
+}
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *out_value,
+                       size_t *length) {
+    esp_err_t result = ESP_ERR_NVS_NOT_FOUND;
+    taskENTER_CRITICAL();
+    nvs_entry_t *entry = find_entry(handle, key);
+    if (entry != NULL) {
+        if (out_value == NULL) {
+            *length = entry->length;
+            result = ESP_OK;
+        } else if (*length < entry->length) {
+            result = ESP_ERR_INVALID_SIZE;
+        } else {
+            memcpy(out_value, entry->value, entry->length);
+            *length = entry->length;
+            result = ESP_OK;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return result;
+}
+
+esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value,
+                       size_t length) {
+    if (length > NVS_MAX_BLOB_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t result = ESP_ERR_NO_MEM;
+    taskENTER_CRITICAL();
+    nvs_entry_t *entry = find_entry(handle, key);
+    for (int i = 0; entry == NULL && i < NVS_MAX_ENTRIES; i++) {
+        if (!entries[i].is_used) {
+            entry = &entries[i];
+            entry->is_used = true;
+            entry->namespace_index = handle;
+            strncpy(entry->key, key, NVS_MAX_KEY_LENGTH - 1);
+        }
+    }
+    if (entry != NULL) {
+        memcpy(entry->value, value, length);
+        entry->length = length;
+        result = ESP_OK;
+    }
+    taskEXIT_CRITICAL();
+    return result;
+}
+
+esp_err_t nvs_erase_key(nvs_handle handle, const char *key) {
+    esp_err_t result = ESP_ERR_NVS_NOT_FOUND;
+    taskENTER_CRITICAL();
+    nvs_entry_t *entry = find_entry(handle, key);
+    if (entry != NULL) {
+        entry->is_used = false;
+        result = ESP_OK;
+    }
+    taskEXIT_CRITICAL();
+    return result;
+}
+
+esp_err_t nvs_commit(nvs_handle handle) {
+    (void)handle;
+    return ESP_OK;
+}
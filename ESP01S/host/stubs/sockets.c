@@ -0,0 +1,57 @@
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include "FreeRTOS.h"
+#include "freertos/task.h"
+#include "host_net.h"
+
+/* 不包含lwip/sockets.h 这里调用的是系统的bind和select */
+int host_bind(int fd, const struct sockaddr *address, socklen_t length) {
+    struct sockaddr_in host_address;
+    memcpy(&host_address, address, sizeof(host_address));
+    host_address.sin_addr = host_net_address();
+    host_address.sin_port =
+        htons((uint16_t)(ntohs(host_address.sin_port) + HOST_PORT_OFFSET));
+    return bind(fd, (struct sockaddr *)&host_address, sizeof(host_address));
+}
+
+int host_select(int nfds, fd_set *readfds, fd_set *writefds,
+                fd_set *exceptfds, struct timeval *timeout) {
+    TickType_t wait = portMAX_DELAY;
+    if (timeout != NULL) {
+        wait = pdMS_TO_TICKS(timeout->tv_sec * 1000 + timeout->tv_usec / 1000);
+    }
+    TickType_t start = xTaskGetTickCount();
+    fd_set read_copy, write_copy, except_copy;
+    while (1) {
+        if (readfds != NULL) {
+            read_copy = *readfds;
+        }
+        if (writefds != NULL) {
+            write_copy = *writefds;
+        }
+        if (exceptfds != NULL) {
+            except_copy = *exceptfds;
+        }
+        struct timeval poll = {0, 0};
+        int ready = select(nfds, readfds != NULL ? &read_copy : NULL,
+                           writefds != NULL ? &write_copy : NULL,
+                           exceptfds != NULL ? &except_copy : NULL, &poll);
+        if (ready != 0 || xTaskGetTickCount() - start >= wait) {
+            if (ready >= 0) {
+                if (readfds != NULL) {
+                    *readfds = read_copy;
+                }
+                if (writefds != NULL) {
+                    *writefds = write_copy;
+                }
+                if (exceptfds != NULL) {
+                    *exceptfds = except_copy;
+                }
+            }
+            return ready;
+        }
+        vTaskDelay(1);
+    }
+}
@@ -0,0 +1,145 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "uart.h"
+#include "uart_fifo.h"
+
+/* 比所有应用任务都高 相当于中断 */
+#define UART_ISR_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+
+static void uart_isr_task(void *pvParameters);
+static int open_pty(void);
+
+host_uart_fifo_t host_uart0 = {0};
+
+static const char kTag[] = "HOST_UART";
+static int pty_master = -1;
+static void (*isr_handler)(void *) = NULL;
+static void *isr_arg = NULL;
+static uint16_t rxfifo_full_thresh = UART_FIFO_SIZE;
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *config) {
+    (void)config;
+    if (uart_num != UART_NUM_0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pty_master < 0) {
+        pty_master = open_pty();
+    }
+    return pty_master < 0 ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t uart_isr_register(uart_port_t uart_num, void (*fn)(void *),
+                            void *arg) {
+    if (uart_num != UART_NUM_0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    isr_handler = fn;
+    isr_arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t uart_intr_config(uart_port_t uart_num,
+                           const uart_intr_config_t *intr_conf) {
+    if (uart_num != UART_NUM_0 || pty_master < 0 || isr_handler == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (intr_conf->intr_enable_mask & UART_RXFIFO_FULL_INT_ENA_M) {
+        rxfifo_full_thresh = intr_conf->rxfifo_full_thresh;
+    }
+    xTaskCreate(uart_isr_task, "uart_isr", 2048, NULL, UART_ISR_TASK_PRIORITY,
+                NULL);
+    return ESP_OK;
+}
+
+void host_uart_write_byte(uint8_t byte) {
+    while (write(pty_master, &byte, 1) < 0) {
+        if (errno == EAGAIN) {
+            // 对端没读走 和TX FIFO满一样等一等
+            vTaskDelay(1);
+        } else if (errno != EINTR) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 每个tick从pty取字节放进模拟FIFO
+ * 到达阈值时调用中断函数 FIFO中有数据且一个tick内没有新字节时按接收超时调用
+ * POSIX移植中阻塞的系统调用会卡住整个调度器 所以pty是非阻塞的
+ */
+static void uart_isr_task(void *pvParameters) {
+    bool has_pending = false;
+    while (1) {
+        bool has_received = false;
+        uint8_t chunk[UART_FIFO_SIZE];
+        while (1) {
+            ssize_t length = read(pty_master, chunk,
+                                  UART_FIFO_SIZE - host_uart0.rx_count);
+            if (length < 0 && errno == EINTR) {
+                continue;
+            }
+            if (length <= 0) {
+                break;
+            }
+            has_received = true;
+            has_pending = true;
+            for (ssize_t i = 0; i < length; i++) {
+                uint16_t tail = (host_uart0.rx_head + host_uart0.rx_count) %
+                                UART_FIFO_SIZE;
+                host_uart0.rx[tail] = chunk[i];
+                host_uart0.rx_count++;
+                if (host_uart0.rx_count >= rxfifo_full_thresh) {
+                    isr_handler(isr_arg);
+                }
+            }
+        }
+        if (!has_received && has_pending) {
+            host_uart0.is_rx_timeout = true;
+            isr_handler(isr_arg);
+            has_pending = false;
+        }
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * @brief 从设备端设成raw并一直打开 对端关闭后主设备端不会收到EIO
+ */
+static int open_pty(void) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    const char *slave_path = ptsname(master);
+    int slave = open(slave_path, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    if (slave < 0 || tcgetattr(slave, &tio) != 0) {
+        perror(slave_path);
+        close(master);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    printf("UART0 is %s\n", slave_path);
+    const char *link_path = getenv("ESP01S_HOST_UART");
+    if (link_path != NULL) {
+        unlink(link_path);
+        if (symlink(slave_path, link_path) != 0) {
+            perror(link_path);
+        } else {
+            printf("UART0 linked to %s\n", link_path);
+        }
+    }
+    fflush(stdout);
+    ESP_LOGI(kTag, "Waiting for frames on %s", slave_path);
+    return master;
+}
@@ -8,12 +8,14 @@
 
 #include "wifi_module.h"
 #include "app_uart.h"
+#include "publisher.h"
 
 void app_main() {
     /* Print chip information */
     esp_chip_info_t chip_info;
     esp_chip_info(&chip_info);
     app_uart_init();
+    publisher_init();
     printf("This is ESP8266 chip with %d CPU cores, WiFi, ", chip_info.cores);
     printf("silicon revision %d, ", chip_info.revision);
 
@@ -1,5 +1,7 @@
 #ifndef APP_MAIN_H
 #define APP_MAIN_H
 
+/* 通过mDNS的TXT记录发布 上位机据此区分固件 */
+#define FIRMWARE_VERSION "1.3.0"
 
 #endif // APP_MAIN_H
@@ -3,46 +3,84 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include "FreeRTOS.h"
 #include "modbus//tcp/tcp_slave.h"
 #include "wifi/wifi_module.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "mdns/mdns_service.h"
+#include "metrics/metrics.h"
 #include "portmacro.h"
 #include "projdefs.h"
+#include "protocol.h"
+#include "publisher/publisher.h"
 #include "uart.h"
+#include "uart_fifo.h"
 
-#define BUF_SIZE 1024
+#define UART_BAUD_RATE 115200
+/* 两块接收缓冲轮流使用 中断填一块 任务解析另一块 */
+#define FRAME_SLOT_COUNT 2
+/* 串口空闲超过约10个字节的时间即认为一帧结束 115200下约0.9ms */
+#define RX_IDLE_TIMEOUT_SYMBOLS 10
+/* FIFO共128字节 到一半就取走 */
+#define RX_FIFO_FULL_THRESHOLD 64
+/* TX FIFO共128字节 留一点余量 */
+#define TX_FIFO_LIMIT 126
+/* 带追踪信息的样本帧从开始发送到接收超时中断的时间 每字节10位 */
+#define TRACED_SAMPLE_WIRE_US                                             \
+    ((PROTOCOL_ESP_TRACED_SAMPLE_SIZE + RX_IDLE_TIMEOUT_SYMBOLS) * 10 *   \
+     1000000ULL / UART_BAUD_RATE)
 
 static void app_uart_receive_event_task(void * pvParameters);
-static void reset_frame_buffer(uart_buffer_t *frame_buffer);
+static void app_uart_isr(void *arg);
+static void app_uart_write(const uint8_t data[], uint16_t len);
+static void release_frame_slot(uart_buffer_t *frame_buffer);
 static void distribution_command(uart_buffer_t *frame_buffer);
 static bool is_data_broken(uint8_t data[], uint16_t len);
 static void receive_one_frame_operation(uart_buffer_t *frame_buffer);
-static void timer_one_frame_callback(TimerHandle_t x_timer);
-static void uart_reassemble_frame(uart_event_t event, uart_buffer_t *frame_buffer);
 static bool is_end_of_receive(uint8_t data[], uint16_t len);
 static void handle_wifi_command(uart_buffer_t *frame_buffer);
 static void handle_receive_temp_and_humid(uart_buffer_t *frame_buffer);
+static void handle_receive_traced_sample(uart_buffer_t *frame_buffer);
+static void publish_sample(float temperature, float humidity,
+                           uint32_t timestamp, const modbus_trace_t *trace);
+static void handle_receive_sample_batch(uart_buffer_t *frame_buffer);
+static void handle_time_request(void);
 
-static TimerHandle_t idle_timer;
-
+/**
+ * @brief 中断直接把FIFO中的字节写到这里 任务在原地解析 不再经过驱动的环形缓冲
+ * 比最长的帧多一字节 收满时说明帧太长 整帧丢弃
+ */
 struct uart_buffer_t {
-    uint8_t data[BUF_SIZE];
+    uint8_t data[PROTOCOL_MAX_FRAME_SIZE + 1];
     uint16_t len;
-    uint16_t pos;
-    bool full_frame_received;
-};
-uart_buffer_t frame_buffer = {
-    .data = {0}, .len = 0, .pos = 0, .full_frame_received = false
+    // 中断发现帧结束时的esp_timer_get_time() 用于追踪
+    int64_t received_us;
+    // 已交给任务解析 解析完之前中断不会写它
+    volatile bool is_parsing;
 };
+static uart_buffer_t frame_slots[FRAME_SLOT_COUNT];
+/* 中断正在填的那一块 */
+static uint8_t filling_slot = 0;
 
 static const char kTag[] = "APP_UART";
-static QueueHandle_t uart0_queue;
+/* 收完的帧 内容为frame_slots的下标 */
+static QueueHandle_t frame_queue;
+/* 启动后收到的样本数 含补发 通过mDNS发布 */
+static uint32_t received_samples = 0;
+/* Modbus和指标中最新值的采样时间 补发的样本不比它新时不覆盖 */
+static uint32_t latest_timestamp = 0;
 
+/**
+ * @brief 不安装UART驱动 省下收发两个1KB的环形缓冲
+ * 接收用自己的中断 发送只有几字节的应答 直接写TX FIFO
+ */
 void app_uart_init(void) {
     uart_config_t uart_config = {
-        .baud_rate = 115200,
+        .baud_rate = UART_BAUD_RATE,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
@@ -50,81 +88,103 @@ void app_uart_init(void) {
     };
     // Configure UART parameters
     ESP_ERROR_CHECK(uart_param_config(UART_NUM_0, &uart_config));
-    ESP_ERROR_CHECK(uart_driver_install(UART_NUM_0, BUF_SIZE, BUF_SIZE, 100,
-                                        &uart0_queue, 0));
-    idle_timer = xTimerCreate("idle_uart", pdMS_TO_TICKS(10), pdFALSE, NULL,
-                              timer_one_frame_callback);
-    if (idle_timer == NULL) {
-        ESP_LOGE(kTag, "Failed to create idle timer");
+    frame_queue = xQueueCreate(FRAME_SLOT_COUNT, sizeof(uint8_t));
+    if (frame_queue == NULL) {
+        ESP_LOGE(kTag, "Failed to create frame queue");
         return;
-    } else {
-        ESP_LOGI(kTag, "Idle timer created successfully");
     }
+    ESP_ERROR_CHECK(uart_isr_register(UART_NUM_0, app_uart_isr, NULL));
+    uart_intr_config_t uart_intr = {
+        .intr_enable_mask = UART_RXFIFO_FULL_INT_ENA_M | UART_RXFIFO_TOUT_INT_ENA_M,
+        .rxfifo_full_thresh = RX_FIFO_FULL_THRESHOLD,
+        .rx_timeout_thresh = RX_IDLE_TIMEOUT_SYMBOLS,
+    };
+    ESP_ERROR_CHECK(uart_intr_config(UART_NUM_0, &uart_intr));
     xTaskCreate(app_uart_receive_event_task, "app_uart_receive_event_task",
                 2048, NULL, 3, NULL);
 }
 
 /**
- * @brief 用于实现类似STM32的UART的IDLE超时功能
+ * @brief 等待中断交来的完整帧 逐帧处理
  * 
  * @param pvParameters 
  */
 static void app_uart_receive_event_task(void *pvParameters) {
-    uart_event_t event;
+    uint8_t slot = 0;
     while (1) {
-        if (event.type != UART_DATA) {
+        if (xQueueReceive(frame_queue, &slot, portMAX_DELAY) != pdTRUE) {
             continue;
         }
-        /* 若超过0.5秒没受到则视为接受完一帧  */
-        if (xQueueReceive(uart0_queue, (void *)&event, pdMS_TO_TICKS(500))) {
-            xTimerReset(idle_timer, 0);
-            uart_reassemble_frame(event, &frame_buffer);
-            ESP_LOGI(kTag, "[UART DATA]: %d", event.size);
+        receive_one_frame_operation(&frame_slots[slot]);
+    }
+}
+
+/**
+ * @brief 用UART的接收超时实现类似STM32的IDLE中断
+ * 另一块还没解析完时丢弃刚收完的帧 STM32收不到ACK会重发
+ */
+static void IRAM_ATTR app_uart_isr(void *arg) {
+    uint32_t status = uart_fifo_interrupt_status();
+    uart_buffer_t *buffer = &frame_slots[filling_slot];
+    while (uart_fifo_rx_count()) {
+        uint8_t byte = uart_fifo_read();
+        if (buffer->len < sizeof(buffer->data)) {
+            buffer->data[buffer->len++] = byte;
+        }
+    }
+
+    BaseType_t task_woken = pdFALSE;
+    if (uart_fifo_is_rx_timeout() && buffer->len > 0) {
+        uint8_t next_slot = (filling_slot + 1) % FRAME_SLOT_COUNT;
+        if (frame_slots[next_slot].is_parsing) {
+            buffer->len = 0;
         } else {
-            if (frame_buffer.len == 0) {
-                // ESP_LOGI(kTag, "No data received, waiting for next frame");
-                continue;
-            }
-            receive_one_frame_operation(&frame_buffer);
+            buffer->received_us = esp_timer_get_time();
+            buffer->is_parsing = true;
+            xQueueSendFromISR(frame_queue, &filling_slot, &task_woken);
+            filling_slot = next_slot;
         }
     }
+    uart_fifo_clear_interrupt(status);
+    if (task_woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
 }
 
-static inline void uart_reassemble_frame(uart_event_t event,
-                                         uart_buffer_t *frame_buffer) {
-    uint16_t received_len = event.size;
-    if (frame_buffer->len + event.size > BUF_SIZE) {
-        ESP_LOGE(kTag, "Buffer overflow: truncating received framed");
-        received_len = BUF_SIZE - frame_buffer->len;
-        frame_buffer->full_frame_received = true;
-        xTimerStop(idle_timer, 0);
-    }
-    uart_read_bytes(UART_NUM_0, &frame_buffer->data[frame_buffer->pos],
-                    received_len, portMAX_DELAY);
-    frame_buffer->len += received_len;
-    frame_buffer->pos += received_len;
-    for (int i = 0; i < received_len; i++) {
-        ESP_LOGI(kTag, "Received byte: 0x%02X", frame_buffer->data[i]);
+/**
+ * @brief 应答最多十几个字节 TX FIFO足够放下 不会真正等待
+ */
+static void app_uart_write(const uint8_t data[], uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        while (uart_fifo_tx_count() >= TX_FIFO_LIMIT) {
+        }
+        uart_fifo_write(data[i]);
     }
 }
 
 static void receive_one_frame_operation(uart_buffer_t *buffer) {
     ESP_LOGI(kTag, "Full frame received, processing...");
-    if (is_data_broken(buffer->data, buffer->len)) {
+    metrics_increment(METRIC_UART_FRAMES);
+    if (buffer->len > PROTOCOL_MAX_FRAME_SIZE ||
+        is_data_broken(buffer->data, buffer->len)) {
         ESP_LOGI(kTag, "Received frame is broken, ignoring");
-        reset_frame_buffer(buffer);
+        metrics_increment(METRIC_UART_CHECKSUM_FAILURES);
+        release_frame_slot(buffer);
         return;
     }
-    static char ack_msg[] = "ACK\r\n";
-    uart_write_bytes(UART_NUM_0, ack_msg, strlen(ack_msg));
+    static const char ack_msg[] = "ACK\r\n";
+    // STM32请求当前时间时 用时间应答代替ACK
+    if (buffer->data[0] != PROTOCOL_ESP_TIME_REQUEST_ID) {
+        app_uart_write((const uint8_t *)ack_msg, strlen(ack_msg));
+    }
     if (!is_end_of_receive(buffer->data, buffer->len)) {
         ESP_LOGI(kTag, "Received frame does not end with CRLF, ignoring");
-        reset_frame_buffer(buffer);
+        release_frame_slot(buffer);
         return;
     }
 
     distribution_command(buffer);
-    reset_frame_buffer(buffer);
+    release_frame_slot(buffer);
 }
 
 /**
@@ -137,60 +197,194 @@ static void distribution_command(uart_buffer_t *frame_buffer) {
              frame_buffer->data);
     uint8_t command = frame_buffer->data[0];
     switch (command) {
-        case 0x00:
+        case PROTOCOL_ESP_WIFI_CONFIG_ID:
             ESP_LOGI(kTag, "Processing command 0x00");
             handle_wifi_command(frame_buffer);
             break;
-        case 0x01:
+        case PROTOCOL_ESP_SAMPLE_ID:
             ESP_LOGI(kTag, "Processing command 0x01");
             handle_receive_temp_and_humid(frame_buffer);
             // Add your command processing logic here
             break;
+        case PROTOCOL_ESP_TRACED_SAMPLE_ID:
+            ESP_LOGI(kTag, "Processing command 0x04");
+            handle_receive_traced_sample(frame_buffer);
+            break;
+        case PROTOCOL_ESP_SAMPLE_BATCH_ID:
+            ESP_LOGI(kTag, "Processing command 0x02");
+            handle_receive_sample_batch(frame_buffer);
+            break;
+        case PROTOCOL_ESP_TIME_REQUEST_ID:
+            ESP_LOGI(kTag, "Processing command 0x03");
+            handle_time_request();
+            break;
         default:
             ESP_LOGW(kTag, "Unknown command: 0x%02X", command);
             break;
     }
 }
 
+/**
+ * @brief 格式见protocol.h中的ProtocolEspWifiConfig
+ * view已经检查过ssid和password的长度 不会写出缓冲
+ *
+ * @param frame_buffer
+ */
 static void handle_wifi_command(uart_buffer_t *frame_buffer) {
-    uint8_t ssid_len =  frame_buffer->data[2];
-    uint8_t password_len = frame_buffer->data[3];
-    char ssid[32] = {0};
-    char password[64] = {0};
-    uint8_t set_index = 4;
-    memcpy(ssid, &frame_buffer->data[set_index], ssid_len);
-    ssid[ssid_len] = '\0';
-    set_index += ssid_len;
-    memcpy(password, &frame_buffer->data[set_index], password_len);
-    password[password_len] = '\0';
+    const ProtocolEspWifiConfig *config =
+        protocol_esp_wifi_config_view(frame_buffer->data, frame_buffer->len);
+    if (config == NULL) {
+        ESP_LOGE(kTag, "Invalid frame length for wifi config: %d",
+                 frame_buffer->len);
+        return;
+    }
+    char ssid[PROTOCOL_SSID_MAX_LENGTH + 1] = {0};
+    char password[PROTOCOL_PASSWORD_MAX_LENGTH + 1] = {0};
+    memcpy(ssid, config->text, config->ssid_length);
+    memcpy(password, &config->text[config->ssid_length],
+           config->password_length);
     wifi_set_new_config(ssid, password);
 }
 
 /**
  * @brief 处理接收到的温湿度数据
- * 格式为：0x01 checksum temperature(4 bytes) humidity(4 bytes) \r\n
+ * 格式见protocol.h中的ProtocolEspSample
  *
  * @param frame_buffer
  */
 static void handle_receive_temp_and_humid(uart_buffer_t *frame_buffer) {
-    if (frame_buffer->len != 12) {
+    const ProtocolEspSample *sample =
+        protocol_esp_sample_view(frame_buffer->data, frame_buffer->len);
+    if (sample == NULL) {
         ESP_LOGE(kTag, "Invalid frame length for temperature and humidity data: %d",
                  frame_buffer->len);
         return;
     }
-    float temperature = 0.0f;
-    float humidity = 0.0f;
-    memcpy(&temperature, &frame_buffer->data[2], sizeof(float));
-    memcpy(&humidity, &frame_buffer->data[6], sizeof(float));
-    ESP_LOGI(kTag, "Received temperature: %.2f, humidity: %.2f", temperature,
-             humidity);
-    modbus_update_temp_and_humi(temperature, humidity);
+    ESP_LOGI(kTag, "Received temperature: %.2f, humidity: %.2f, time: %u",
+             sample->temperature, sample->humidity, sample->timestamp);
+    publish_sample(sample->temperature, sample->humidity, sample->timestamp,
+                   NULL);
+}
+
+/**
+ * @brief 和普通样本一样处理 再把各段时间写入追踪寄存器
+ * 格式见protocol.h中的ProtocolEspTracedSample
+ * STM32的age_us只算到开始发送 这里加上串口传输和接收超时的时间
+ *
+ * @param frame_buffer
+ */
+static void handle_receive_traced_sample(uart_buffer_t *frame_buffer) {
+    const ProtocolEspTracedSample *sample =
+        protocol_esp_traced_sample_view(frame_buffer->data, frame_buffer->len);
+    if (sample == NULL) {
+        ESP_LOGE(kTag, "Invalid frame length for traced sample: %d",
+                 frame_buffer->len);
+        return;
+    }
+    ESP_LOGI(kTag,
+             "Received temperature: %.2f, humidity: %.2f, time: %u, trace: %u",
+             sample->temperature, sample->humidity, sample->timestamp,
+             sample->trace_id);
+    modbus_trace_t trace = {
+        .id = sample->trace_id,
+        .conversion_us = sample->conversion_us,
+        .link_us = sample->age_us + (uint32_t)TRACED_SAMPLE_WIRE_US,
+        .received_us = frame_buffer->received_us,
+    };
+    publish_sample(sample->temperature, sample->humidity, sample->timestamp,
+                   &trace);
 }
 
-static void reset_frame_buffer(uart_buffer_t *frame_buffer) {
+/**
+ * @brief 把一个实时样本写入Modbus寄存器 统计并推送
+ */
+static void publish_sample(float temperature, float humidity,
+                           uint32_t timestamp, const modbus_trace_t *trace) {
+    modbus_update_temp_and_humi(temperature, humidity, timestamp, trace);
+    metrics_record_sample(temperature, humidity, timestamp, true);
+    latest_timestamp = timestamp;
+    // 实时样本没有序号 推送时记为0
+    ProtocolSampleRecord record = {
+        .sequence = 0,
+        .temperature_centi = protocol_temperature_centi(temperature),
+        .humidity_centi = protocol_humidity_centi(humidity),
+        .timestamp = timestamp,
+    };
+    publisher_push(&record, 1);
+    received_samples++;
+    mdns_service_update_sequence(received_samples);
+}
+
+/**
+ * @brief 处理STM32在链路断开期间缓存 之后补发的样本
+ * 格式见protocol.h中的ProtocolEspSampleBatch
+ * 样本按时间顺序排列 最后一条比当前的最新值还新时才更新最新值
+ * 链路恢复前已经收到过更新的实时样本时 补发的只计入统计和推送
+ *
+ * @param frame_buffer
+ */
+static void handle_receive_sample_batch(uart_buffer_t *frame_buffer) {
+    const ProtocolEspSampleBatch *batch =
+        protocol_esp_sample_batch_view(frame_buffer->data, frame_buffer->len);
+    if (batch == NULL || batch->count == 0) {
+        ESP_LOGE(kTag, "Invalid frame length for sample batch: %d",
+                 frame_buffer->len);
+        return;
+    }
+    const ProtocolSampleRecord *latest = &batch->records[batch->count - 1];
+    // 时间为0的样本是STM32同步时间前采的 无法比较 只在还没有最新值时使用
+    bool is_newer =
+        received_samples == 0 || latest->timestamp > latest_timestamp;
+    for (uint8_t i = 0; i < batch->count; i++) {
+        ESP_LOGI(kTag,
+                 "Replayed sample #%u: temperature: %.2f, humidity: %.2f, time: %u",
+                 batch->records[i].sequence,
+                 batch->records[i].temperature_centi / 100.0f,
+                 batch->records[i].humidity_centi / 100.0f,
+                 batch->records[i].timestamp);
+        metrics_record_sample(batch->records[i].temperature_centi / 100.0f,
+                              batch->records[i].humidity_centi / 100.0f,
+                              batch->records[i].timestamp,
+                              is_newer && i == batch->count - 1);
+    }
+    if (is_newer) {
+        modbus_update_temp_and_humi(latest->temperature_centi / 100.0f,
+                                    latest->humidity_centi / 100.0f,
+                                    latest->timestamp, NULL);
+        latest_timestamp = latest->timestamp;
+    }
+    publisher_push(batch->records, batch->count);
+    received_samples += batch->count;
+    mdns_service_update_sequence(received_samples);
+}
+
+/**
+ * @brief 回复当前时间 格式见protocol.h中的ProtocolEspTimeReply
+ * 中断在串口空闲约1ms后就交出请求 这里立即取时间并开始发送
+ * 所以STM32把参考时间对应到回复开始发送的时刻 见timebase.h
+ * 主站还没设置过时间时epoch_seconds为0 STM32不会用它同步
+ */
+static void handle_time_request(void) {
+    struct timeval now = { 0 };
+    gettimeofday(&now, NULL);
+    uint32_t epoch_seconds = 0;
+    uint16_t milliseconds = 0;
+    if (now.tv_sec >= MIN_VALID_EPOCH) {
+        epoch_seconds = (uint32_t)now.tv_sec;
+        milliseconds = (uint16_t)(now.tv_usec / 1000);
+    }
+    uint8_t reply[PROTOCOL_ESP_TIME_REPLY_SIZE];
+    uint16_t length =
+        protocol_esp_time_reply_pack(reply, epoch_seconds, milliseconds);
+    app_uart_write(reply, length);
+}
+
+/**
+ * @brief 帧中的字段已经发布到Modbus寄存器 缓冲还给中断
+ */
+static void release_frame_slot(uart_buffer_t *frame_buffer) {
     frame_buffer->len = 0;
-    frame_buffer->pos = 0;
-    frame_buffer->full_frame_received = false;
+    frame_buffer->is_parsing = false;
 }
 
 static bool is_data_broken(uint8_t data[], uint16_t len) {
@@ -208,11 +402,6 @@ static bool is_data_broken(uint8_t data[], uint16_t len) {
     }
 }
 
-static void timer_one_frame_callback(TimerHandle_t x_timer) {
-    frame_buffer.full_frame_received = true;
-    ESP_LOGI(kTag, "Idle timer callback triggered, marking frame as complete");
-}
-
 static bool is_end_of_receive(uint8_t data[], uint16_t len) {
     if (len < 3) {
         return false;
@@ -2,14 +2,37 @@
  * @file mdns_service.c
  * @brief mDNS service implementation for Modbus TCP slave
  */
+#include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
+#include "FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "app_main.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "mdns.h"
 #include "mdns_service.h"
+#include "modbus/common/modbus_params.h"
+#include "sdkconfig.h"
+
+/**
+ * @brief Features a collector can rely on, published in the "caps" TXT item
+ */
+#if CONFIG_PUBLISHER_TRANSPORT_MQTT
+#define MDNS_CAPABILITIES "modbus,time,metrics,trace,push-mqtt"
+#elif CONFIG_PUBLISHER_TRANSPORT_UDP
+#define MDNS_CAPABILITIES "modbus,time,metrics,trace,push-udp"
+#else
+#define MDNS_CAPABILITIES "modbus,time,metrics,trace"
+#endif
 
 static const char *TAG = "MDNS_SERVICE";
+/* Serializes start/stop with TXT updates from the UART task */
+static SemaphoreHandle_t mdns_mutex = NULL;
+static bool is_mdns_running = false;
+static uint32_t sample_sequence = 0;
+static TickType_t last_sequence_update = 0;
 
 /**
  * @brief Convert MAC from binary format to string
@@ -44,9 +67,10 @@ static inline char* gen_id_str(char* service_name, char* slave_id_str)
  * 
  * @return esp_err_t ESP_OK if successful
  */
-esp_err_t start_mdns_service(void)
+static esp_err_t start_mdns_service_locked(void)
 {
     char temp_str[32] = {0};
+    char hostname[32] = {0};
     uint8_t sta_mac[6] = {0};
     esp_err_t ret;
     
@@ -56,8 +80,9 @@ esp_err_t start_mdns_service(void)
         return ret;
     }
 
-    strncpy(temp_str, "humidistat-esp8266", sizeof(temp_str));
-    char* hostname = temp_str;
+    // Every unit gets its own hostname and service instance, so a single
+    // browse finds the whole fleet instead of one colliding name
+    gen_mac_str(sta_mac, MB_MDNS_HOSTNAME_PREFIX, hostname);
 
     // Initialize mDNS
     ret = mdns_init();
@@ -75,19 +100,29 @@ esp_err_t start_mdns_service(void)
     ESP_LOGI(TAG, "mDNS hostname set to: [%s]", hostname);
 
     // Set default mDNS instance name
-    ret = mdns_instance_name_set(MB_MDNS_INSTANCE("humidistat"));
+    ret = mdns_instance_name_set(hostname);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set mDNS instance name");
         return ret;
     }
 
     // Structure with TXT records
+    char sequence_str[12] = {0};
+    snprintf(sequence_str, sizeof(sequence_str), "%u", sample_sequence);
     mdns_txt_item_t serviceTxtData[] = {
-        {"board", "esp8266"}
+        {"board", "esp8266"},
+        {"fw", FIRMWARE_VERSION},
+        {"caps", MDNS_CAPABILITIES},
+        // Register encoding, see modbus_params.h
+        {"in", MB_INPUT_FORMAT_NAME "," MB_INPUT_WORD_ORDER_NAME},
+        {"hold", MB_HOLDING_WORD_ORDER_NAME},
+        {"trace", MB_TRACE_REGISTER_START_NAME},
+        {"seq", sequence_str}
     };
 
     // Initialize service
-    ret = mdns_service_add(hostname, "_modbus", "_tcp", MB_MDNS_PORT, serviceTxtData, 1);
+    ret = mdns_service_add(hostname, "_modbus", "_tcp", MB_MDNS_PORT, serviceTxtData,
+                           sizeof(serviceTxtData) / sizeof(serviceTxtData[0]));
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to add mDNS service");
         return ret;
@@ -111,12 +146,62 @@ esp_err_t start_mdns_service(void)
     return ESP_OK;
 }
 
+esp_err_t start_mdns_service(void)
+{
+    if (mdns_mutex == NULL) {
+        mdns_mutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(mdns_mutex, portMAX_DELAY);
+    esp_err_t ret = start_mdns_service_locked();
+    is_mdns_running = ret == ESP_OK;
+    xSemaphoreGive(mdns_mutex);
+    return ret;
+}
+
 /**
  * @brief Free mDNS resources
  * 
  */
 void stop_mdns_service(void)
 {
+    if (mdns_mutex == NULL) {
+        return;
+    }
+    xSemaphoreTake(mdns_mutex, portMAX_DELAY);
     mdns_free();
+    is_mdns_running = false;
+    xSemaphoreGive(mdns_mutex);
     ESP_LOGI(TAG, "mDNS service stopped");
 }
+
+/**
+ * @brief Restart the responder so it probes and announces again
+ * Called when DHCP hands out a different address, so collectors learn the
+ * new A record right away instead of waiting for the old one to expire
+ */
+esp_err_t reannounce_mdns_service(void)
+{
+    stop_mdns_service();
+    return start_mdns_service();
+}
+
+void mdns_service_update_sequence(uint32_t sequence)
+{
+    sample_sequence = sequence;
+    if (mdns_mutex == NULL) {
+        return;
+    }
+    // Every TXT change is multicast, so updates are rate limited
+    TickType_t now = xTaskGetTickCount();
+    if (now - last_sequence_update < pdMS_TO_TICKS(MB_MDNS_SEQUENCE_INTERVAL_MS)) {
+        return;
+    }
+    xSemaphoreTake(mdns_mutex, portMAX_DELAY);
+    if (is_mdns_running) {
+        char sequence_str[12] = {0};
+        snprintf(sequence_str, sizeof(sequence_str), "%u", sequence);
+        mdns_service_txt_item_set("_modbus", "_tcp", "seq", sequence_str);
+        last_sequence_update = now;
+    }
+    xSemaphoreGive(mdns_mutex);
+}
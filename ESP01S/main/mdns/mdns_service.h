@@ -34,9 +34,14 @@
 #define MB_SLAVE_ADDR (CONFIG_MB_SLAVE_ADDR)
 
 /**
- * @brief Instance name for mDNS service
+ * @brief Hostname and instance prefix, followed by the station MAC
  */
-#define MB_MDNS_INSTANCE(pref) pref"mb_slave_tcp"
+#define MB_MDNS_HOSTNAME_PREFIX "humidistat-"
+
+/**
+ * @brief Minimum interval between "seq" TXT updates
+ */
+#define MB_MDNS_SEQUENCE_INTERVAL_MS (30000)
 
 /**
  * @brief Initialize and start mDNS service for Modbus TCP
@@ -51,4 +56,19 @@ esp_err_t start_mdns_service(void);
  */
 void stop_mdns_service(void);
 
+/**
+ * @brief Re-probe and announce after the IP address changed
+ * 
+ * @return esp_err_t ESP_OK if successful
+ */
+esp_err_t reannounce_mdns_service(void);
+
+/**
+ * @brief Publish the number of samples received in the "seq" TXT item
+ * Safe to call before the service starts, the value is used on start
+ * 
+ * @param sequence Samples received since boot
+ */
+void mdns_service_update_sequence(uint32_t sequence);
+
 #endif /* MDNS_SERVICE_H */
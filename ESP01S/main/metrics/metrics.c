@@ -0,0 +1,250 @@
+#include "metrics/metrics.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_system.h"
+
+/* 全部指标渲染后最长约3KB */
+#define METRICS_BUFFER_SIZE 3584
+
+/**
+ * @brief 所有指标 修改时在临界区内 并标记需要重新渲染
+ */
+typedef struct {
+    uint32_t counters[METRIC_COUNTER_COUNT];
+    float temperature;
+    float humidity;
+    uint32_t timestamp;
+    uint32_t sample_count;
+    float temperature_min;
+    float temperature_max;
+    // float累加到几十万个样本后再加0.01就加不上了
+    double temperature_sum;
+    float humidity_min;
+    float humidity_max;
+    double humidity_sum;
+    uint64_t modbus_latency_sum_us;
+    uint32_t modbus_latency_count;
+    uint32_t modbus_latency_max_us;
+} metrics_t;
+
+static esp_err_t metrics_get_handler(httpd_req_t *req);
+static void render_metrics(void);
+static void append_volatile_gauges(void);
+static void append(const char *format, ...);
+
+static const char kTag[] = "METRICS";
+static metrics_t metrics = {0};
+/* 值变化后置位 下一次抓取时才重新渲染 */
+static volatile bool is_dirty = true;
+/* 只在HTTP服务任务中访问 前cached_length字节是缓存的渲染结果 */
+static char rendered[METRICS_BUFFER_SIZE];
+static size_t rendered_length = 0;
+static size_t cached_length = 0;
+static httpd_handle_t server = NULL;
+
+void metrics_increment(metric_counter_t counter) {
+    portENTER_CRITICAL();
+    metrics.counters[counter]++;
+    is_dirty = true;
+    portEXIT_CRITICAL();
+}
+
+void metrics_record_sample(float temperature, float humidity,
+                           uint32_t timestamp, bool is_latest) {
+    portENTER_CRITICAL();
+    if (metrics.sample_count == 0 || temperature < metrics.temperature_min) {
+        metrics.temperature_min = temperature;
+    }
+    if (metrics.sample_count == 0 || temperature > metrics.temperature_max) {
+        metrics.temperature_max = temperature;
+    }
+    if (metrics.sample_count == 0 || humidity < metrics.humidity_min) {
+        metrics.humidity_min = humidity;
+    }
+    if (metrics.sample_count == 0 || humidity > metrics.humidity_max) {
+        metrics.humidity_max = humidity;
+    }
+    metrics.temperature_sum += temperature;
+    metrics.humidity_sum += humidity;
+    metrics.sample_count++;
+    if (is_latest) {
+        metrics.temperature = temperature;
+        metrics.humidity = humidity;
+        metrics.timestamp = timestamp;
+    }
+    is_dirty = true;
+    portEXIT_CRITICAL();
+}
+
+void metrics_record_modbus_latency(uint32_t latency_us) {
+    portENTER_CRITICAL();
+    metrics.modbus_latency_sum_us += latency_us;
+    metrics.modbus_latency_count++;
+    if (latency_us > metrics.modbus_latency_max_us) {
+        metrics.modbus_latency_max_us = latency_us;
+    }
+    is_dirty = true;
+    portEXIT_CRITICAL();
+}
+
+void metrics_server_start(void) {
+    if (server != NULL) {
+        return;
+    }
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = METRICS_HTTP_PORT;
+    config.stack_size = 3072;
+    // 只有Prometheus来抓取 两个连接足够
+    config.max_open_sockets = 2;
+    config.lru_purge_enable = true;
+    if (httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGE(kTag, "Failed to start HTTP server");
+        server = NULL;
+        return;
+    }
+    static const httpd_uri_t metrics_uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_get_handler,
+    };
+    httpd_register_uri_handler(server, &metrics_uri);
+    ESP_LOGI(kTag, "Serving metrics on port %d", METRICS_HTTP_PORT);
+}
+
+void metrics_server_stop(void) {
+    if (server == NULL) {
+        return;
+    }
+    httpd_stop(server);
+    server = NULL;
+}
+
+/**
+ * @brief 值没变时沿用上次渲染的结果 每次只在后面重写易变的指标 一次写完
+ */
+static esp_err_t metrics_get_handler(httpd_req_t *req) {
+    if (is_dirty) {
+        render_metrics();
+    }
+    rendered_length = cached_length;
+    append_volatile_gauges();
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    return httpd_resp_send(req, rendered, rendered_length);
+}
+
+/**
+ * @brief 先在临界区内拷贝一份 格式化在临界区外进行
+ */
+static void render_metrics(void) {
+    portENTER_CRITICAL();
+    metrics_t snapshot = metrics;
+    is_dirty = false;
+    portEXIT_CRITICAL();
+    rendered_length = 0;
+
+    append("# HELP humidistat_temperature_celsius Latest temperature.\n"
+           "# TYPE humidistat_temperature_celsius gauge\n");
+    if (snapshot.sample_count > 0) {
+        append("humidistat_temperature_celsius %.2f\n", snapshot.temperature);
+    }
+    append("# HELP humidistat_humidity_percent Latest relative humidity.\n"
+           "# TYPE humidistat_humidity_percent gauge\n");
+    if (snapshot.sample_count > 0) {
+        append("humidistat_humidity_percent %.2f\n", snapshot.humidity);
+    }
+    append("# HELP humidistat_sample_timestamp_seconds Unix time the latest sample was taken, 0 if unsynced.\n"
+           "# TYPE humidistat_sample_timestamp_seconds gauge\n"
+           "humidistat_sample_timestamp_seconds %u\n",
+           snapshot.timestamp);
+    append("# HELP humidistat_samples_total Samples received from the STM32, including replayed ones.\n"
+           "# TYPE humidistat_samples_total counter\n"
+           "humidistat_samples_total %u\n",
+           snapshot.sample_count);
+    if (snapshot.sample_count > 0) {
+        append("# HELP humidistat_temperature_stats_celsius Temperature since boot.\n"
+               "# TYPE humidistat_temperature_stats_celsius gauge\n"
+               "humidistat_temperature_stats_celsius{stat=\"min\"} %.2f\n"
+               "humidistat_temperature_stats_celsius{stat=\"max\"} %.2f\n"
+               "humidistat_temperature_stats_celsius{stat=\"mean\"} %.2f\n",
+               snapshot.temperature_min, snapshot.temperature_max,
+               snapshot.temperature_sum / snapshot.sample_count);
+        append("# HELP humidistat_humidity_stats_percent Relative humidity since boot.\n"
+               "# TYPE humidistat_humidity_stats_percent gauge\n"
+               "humidistat_humidity_stats_percent{stat=\"min\"} %.2f\n"
+               "humidistat_humidity_stats_percent{stat=\"max\"} %.2f\n"
+               "humidistat_humidity_stats_percent{stat=\"mean\"} %.2f\n",
+               snapshot.humidity_min, snapshot.humidity_max,
+               snapshot.humidity_sum / snapshot.sample_count);
+    }
+    append("# HELP humidistat_uart_frames_total Frames received from the STM32.\n"
+           "# TYPE humidistat_uart_frames_total counter\n"
+           "humidistat_uart_frames_total %u\n",
+           snapshot.counters[METRIC_UART_FRAMES]);
+    append("# HELP humidistat_uart_checksum_failures_total Frames dropped for a bad checksum or length.\n"
+           "# TYPE humidistat_uart_checksum_failures_total counter\n"
+           "humidistat_uart_checksum_failures_total %u\n",
+           snapshot.counters[METRIC_UART_CHECKSUM_FAILURES]);
+    append("# HELP humidistat_wifi_reconnects_total Times an IP was assigned again after a disconnect.\n"
+           "# TYPE humidistat_wifi_reconnects_total counter\n"
+           "humidistat_wifi_reconnects_total %u\n",
+           snapshot.counters[METRIC_WIFI_RECONNECTS]);
+    append("# HELP humidistat_modbus_requests_total Modbus register accesses by type.\n"
+           "# TYPE humidistat_modbus_requests_total counter\n"
+           "humidistat_modbus_requests_total{type=\"input_read\"} %u\n"
+           "humidistat_modbus_requests_total{type=\"holding_write\"} %u\n",
+           snapshot.counters[METRIC_MODBUS_INPUT_READS],
+           snapshot.counters[METRIC_MODBUS_HOLDING_WRITES]);
+    append("# HELP humidistat_modbus_evicted_connections_total Idle connections closed to admit a new master.\n"
+           "# TYPE humidistat_modbus_evicted_connections_total counter\n"
+           "humidistat_modbus_evicted_connections_total %u\n",
+           snapshot.counters[METRIC_MODBUS_EVICTIONS]);
+    append("# HELP humidistat_publisher_dropped_samples_total Samples dropped before they could be pushed.\n"
+           "# TYPE humidistat_publisher_dropped_samples_total counter\n"
+           "humidistat_publisher_dropped_samples_total %u\n",
+           snapshot.counters[METRIC_PUBLISHER_DROPS]);
+    append("# HELP humidistat_modbus_latency_seconds Time from a Modbus request arriving to it being answered.\n"
+           "# TYPE humidistat_modbus_latency_seconds summary\n"
+           "humidistat_modbus_latency_seconds_sum %.6f\n"
+           "humidistat_modbus_latency_seconds_count %u\n",
+           snapshot.modbus_latency_sum_us / 1e6, snapshot.modbus_latency_count);
+    append("# HELP humidistat_modbus_latency_max_seconds Longest Modbus latency since boot.\n"
+           "# TYPE humidistat_modbus_latency_max_seconds gauge\n"
+           "humidistat_modbus_latency_max_seconds %.6f\n",
+           snapshot.modbus_latency_max_us / 1e6);
+    cached_length = rendered_length;
+}
+
+/**
+ * @brief 几乎每次抓取都会变的指标 放进缓存会让缓存每次都失效
+ */
+static void append_volatile_gauges(void) {
+    append("# HELP humidistat_free_heap_bytes Free heap.\n"
+           "# TYPE humidistat_free_heap_bytes gauge\n"
+           "humidistat_free_heap_bytes %u\n",
+           esp_get_free_heap_size());
+}
+
+static void append(const char *format, ...) {
+    if (rendered_length >= sizeof(rendered)) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(rendered + rendered_length,
+                            sizeof(rendered) - rendered_length, format, args);
+    va_end(args);
+    if (written < 0) {
+        return;
+    }
+    rendered_length += written;
+    if (rendered_length >= sizeof(rendered)) {
+        ESP_LOGW(kTag, "Metrics truncated, enlarge METRICS_BUFFER_SIZE");
+        rendered_length = sizeof(rendered) - 1;
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <stdbool.h>
+#include <stdint.h>
+
+/* HTTP端口 Prometheus从http://<ip>/metrics抓取 */
+#define METRICS_HTTP_PORT 80
+
+typedef enum {
+    METRIC_UART_FRAMES,
+    METRIC_UART_CHECKSUM_FAILURES,
+    METRIC_WIFI_RECONNECTS,
+    METRIC_MODBUS_INPUT_READS,
+    METRIC_MODBUS_HOLDING_WRITES,
+    METRIC_MODBUS_EVICTIONS,
+    // 推送队列满或长时间发不出去时丢掉的样本
+    METRIC_PUBLISHER_DROPS,
+    METRIC_COUNTER_COUNT,
+} metric_counter_t;
+
+/**
+ * @brief 计数器加1 可以在任意任务中调用 不能在中断中调用
+ */
+void metrics_increment(metric_counter_t counter);
+/**
+ * @brief 计入历史统计 补发的样本也逐条调用
+ *
+ * @param is_latest 为true时同时更新最新值 比当前最新值旧的补发样本传false
+ */
+void metrics_record_sample(float temperature, float humidity,
+                           uint32_t timestamp, bool is_latest);
+/**
+ * @brief 请求到达到处理完的延迟 esp-modbus控制器下为访问寄存器到事件任务处理完
+ */
+void metrics_record_modbus_latency(uint32_t latency_us);
+/**
+ * @brief 拿到IP后启动HTTP服务 只处理GET /metrics
+ */
+void metrics_server_start(void);
+void metrics_server_stop(void);
+
+#endif // METRICS_H
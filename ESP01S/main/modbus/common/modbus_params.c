@@ -8,3 +8,5 @@
 // Here are the user defined instances for device parameters packed by 1 byte
 // These are keep the values that can be accessed from Modbus master
 input_reg_params_t input_reg_params = { 0 };
+trace_reg_params_t trace_reg_params = { 0 };
+holding_reg_params_t holding_reg_params = { 0 };
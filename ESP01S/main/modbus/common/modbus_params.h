@@ -10,15 +10,67 @@
 // This file defines structure of modbus parameters which reflect correspond modbus address space
 // for each modbus register type (coils, discreet inputs, holding registers, input registers)
 #include <stdint.h>
+#include "sdkconfig.h"
 
-#pragma pack(push, 1)
+// 输入寄存器依次为湿度 温度 样本时间 编码方式在menuconfig中选择
+// 样本时间是STM32上测量完成时的Unix时间 秒 STM32还没同步时为0
+// 32位的值占两个寄存器 先后顺序由字序决定 每个寄存器在线上都是大端
+#if CONFIG_MODBUS_INPUT_FORMAT_INT16_X100
+// 湿度和温度为乘以100后的int16 各占一个寄存器
+#define MB_INPUT_REGISTER_COUNT 4
+#define MB_INPUT_FORMAT_NAME "int16x100"
+#elif CONFIG_MODBUS_INPUT_FORMAT_INT32_X100
+#define MB_INPUT_REGISTER_COUNT 6
+#define MB_INPUT_FORMAT_NAME "int32x100"
+#else
+#define MB_INPUT_REGISTER_COUNT 6
+#define MB_INPUT_FORMAT_NAME "float32"
+#endif
+// 保持寄存器0~1为主站写入的Unix时间 秒 ESP01S用它设置系统时间 再同步给STM32
+#define MB_HOLDING_REGISTER_COUNT 2
+
+// "hi"为高16位在前 "lo"为低16位在前 通过mDNS的TXT记录发布 主站据此解码
+#if CONFIG_MODBUS_INPUT_WORD_ORDER_LOW_FIRST
+#define MB_INPUT_WORD_ORDER_NAME "lo"
+#else
+#define MB_INPUT_WORD_ORDER_NAME "hi"
+#endif
+#if CONFIG_MODBUS_HOLDING_WORD_ORDER_LOW_FIRST
+#define MB_HOLDING_WORD_ORDER_NAME "lo"
+#else
+#define MB_HOLDING_WORD_ORDER_NAME "hi"
+#endif
+
+// 追踪寄存器 固定从输入寄存器0x0010开始 不随格式变化 地址通过TXT记录的trace项发布
+// 依次为trace_id conversion_us link_us queue_us age_us 都是高16位在前的uint32
+// conversion_us: STM32从发出测量命令到换算完成
+// link_us: 换算完成到ESP01S收完整帧 含STM32排队 重传和串口传输
+// queue_us: ESP01S收完整帧到写入寄存器
+// age_us: 写入寄存器到这次读 只有快速从站在读时填写 esp-modbus下为0
+// trace_id为0表示当前样本是补发的或没有追踪信息 其余值都无意义
+#define MB_TRACE_REGISTER_START 0x0010
+#define MB_TRACE_REGISTER_START_NAME "16"
+#define MB_TRACE_REGISTER_COUNT 10
+#define MB_TRACE_AGE_REGISTER 8
+
+// 寄存器的值 按本机字节序存放 发送时转成大端
 typedef struct
 {
-    float humidity;
-    float temperature;
+    uint16_t registers[MB_INPUT_REGISTER_COUNT];
 } input_reg_params_t;
-#pragma pack(pop)
+
+typedef struct
+{
+    uint16_t registers[MB_TRACE_REGISTER_COUNT];
+} trace_reg_params_t;
+
+typedef struct
+{
+    uint16_t registers[MB_HOLDING_REGISTER_COUNT];
+} holding_reg_params_t;
 
 extern input_reg_params_t input_reg_params;
+extern trace_reg_params_t trace_reg_params;
+extern holding_reg_params_t holding_reg_params;
 
 #endif // !defined(_DEVICE_PARAMS)
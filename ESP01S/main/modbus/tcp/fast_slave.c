@@ -0,0 +1,484 @@
+#include "modbus/tcp/fast_slave.h"
+#include <errno.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "metrics/metrics.h"
+#include "sdkconfig.h"
+
+/* MBAP头7字节 PDU最长253字节 */
+#define MB_TCP_HEADER_SIZE 7
+#define MB_TCP_FRAME_SIZE 260
+#define MB_REGISTER_MAX_READ 125
+#define MB_REGISTER_MAX_WRITE 123
+#define MB_EXCEPTION_ILLEGAL_FUNCTION 0x01
+#define MB_EXCEPTION_ILLEGAL_DATA_ADDRESS 0x02
+#define MB_EXCEPTION_ILLEGAL_DATA_VALUE 0x03
+/* 没有请求时select最多等这么久 然后检查空闲连接和停止请求 */
+#define FAST_SLAVE_POLL_MS 500
+
+typedef struct {
+    int fd;
+    uint8_t frame[MB_TCP_FRAME_SIZE];
+    uint16_t length;
+    // 收到最近一个字节的时刻 用于回收空闲连接和选择被挤掉的连接
+    TickType_t last_active;
+    // 缓冲中第一个请求开始到达的时刻 微秒
+    int64_t received_us;
+} fast_client_t;
+
+static void fast_slave_task(void *pvParameters);
+static void accept_client(void);
+static bool receive(fast_client_t *client);
+static bool has_complete_request(const fast_client_t *client);
+static void serve_one_request(fast_client_t *client);
+static bool send_response(fast_client_t *client, const uint8_t response[],
+                          uint16_t length);
+static uint16_t handle_pdu(const uint8_t request[], uint16_t length,
+                           uint8_t response[]);
+static uint8_t read_input(uint16_t address, uint16_t count, uint8_t data[]);
+static void encode_registers(const uint16_t registers[], int count,
+                             uint8_t image[]);
+static uint8_t read_holding(uint16_t address, uint16_t count, uint8_t data[]);
+static uint8_t write_holding(uint16_t address, uint16_t count,
+                             const uint8_t data[]);
+static void close_client(fast_client_t *client);
+static void close_idle_clients(void);
+
+static const char kTag[] = "MB_FAST";
+static fast_client_t clients[CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS];
+/* 输入寄存器按线上的大端序存放 读请求直接拷贝 */
+static uint8_t input_image[MB_INPUT_REGISTER_COUNT * 2];
+static uint8_t trace_image[MB_TRACE_REGISTER_COUNT * 2];
+/* trace_image写入时的esp_timer_get_time() */
+static int64_t trace_updated_us = 0;
+static int listen_fd = -1;
+static volatile bool is_stopping = false;
+static SemaphoreHandle_t stopped_semaphore = NULL;
+static fast_slave_write_callback_t write_callback = NULL;
+/* 每轮从这个连接开始处理 */
+static uint8_t next_client = 0;
+
+bool fast_slave_start(uint16_t port, fast_slave_write_callback_t on_write) {
+    if (listen_fd >= 0) {
+        return true;
+    }
+    if (stopped_semaphore == NULL) {
+        stopped_semaphore = xSemaphoreCreateBinary();
+    }
+    listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_fd < 0) {
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listen_fd, CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS) != 0) {
+        ESP_LOGE(kTag, "Failed to listen on port %u: %d", port, errno);
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    for (int i = 0; i < CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+    write_callback = on_write;
+    is_stopping = false;
+    xTaskCreate(fast_slave_task, "mb_fast_slave", 2560, NULL, 5, NULL);
+    ESP_LOGI(kTag, "Serving Modbus TCP on port %u", port);
+    return true;
+}
+
+void fast_slave_stop(void) {
+    if (listen_fd < 0) {
+        return;
+    }
+    is_stopping = true;
+    // 任务阻塞在select中时不能直接删除 等它自己退出
+    xSemaphoreTake(stopped_semaphore, portMAX_DELAY);
+}
+
+void fast_slave_update_input(const input_reg_params_t *params,
+                             const trace_reg_params_t *trace,
+                             int64_t updated_us) {
+    uint8_t image[sizeof(input_image)];
+    uint8_t traced[sizeof(trace_image)];
+    encode_registers(params->registers, MB_INPUT_REGISTER_COUNT, image);
+    encode_registers(trace->registers, MB_TRACE_REGISTER_COUNT, traced);
+    portENTER_CRITICAL();
+    memcpy(input_image, image, sizeof(input_image));
+    memcpy(trace_image, traced, sizeof(trace_image));
+    trace_updated_us = updated_us;
+    portEXIT_CRITICAL();
+}
+
+/**
+ * @brief 寄存器在线上按大端传输 与esp-modbus相同
+ */
+static void encode_registers(const uint16_t registers[], int count,
+                             uint8_t image[]) {
+    for (int i = 0; i < count; i++) {
+        image[i * 2] = registers[i] >> 8;
+        image[i * 2 + 1] = registers[i] & 0xFF;
+    }
+}
+
+/**
+ * @brief 一个任务服务所有连接 从上一轮之后的那个连接开始 每个连接最多处理一个请求
+ * 缓冲中还有完整请求时select不等待 马上进入下一轮
+ */
+static void fast_slave_task(void *pvParameters) {
+    while (!is_stopping) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listen_fd, &readable);
+        int max_fd = listen_fd;
+        bool has_buffered = false;
+        for (int i = 0; i < CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS; i++) {
+            if (clients[i].fd < 0) {
+                continue;
+            }
+            FD_SET(clients[i].fd, &readable);
+            if (clients[i].fd > max_fd) {
+                max_fd = clients[i].fd;
+            }
+            if (has_complete_request(&clients[i])) {
+                has_buffered = true;
+            }
+        }
+        struct timeval timeout = {
+            .tv_sec = 0,
+            .tv_usec = has_buffered ? 0 : FAST_SLAVE_POLL_MS * 1000,
+        };
+        if (select(max_fd + 1, &readable, NULL, NULL, &timeout) < 0) {
+            ESP_LOGE(kTag, "select failed: %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(FAST_SLAVE_POLL_MS));
+            continue;
+        }
+        if (FD_ISSET(listen_fd, &readable)) {
+            accept_client();
+        }
+        for (int n = 0; n < CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS; n++) {
+            fast_client_t *client =
+                &clients[(next_client + n) % CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS];
+            if (client->fd < 0) {
+                continue;
+            }
+            if (FD_ISSET(client->fd, &readable) && !receive(client)) {
+                continue;
+            }
+            serve_one_request(client);
+        }
+        next_client = (next_client + 1) % CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS;
+        close_idle_clients();
+    }
+
+    for (int i = 0; i < CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS; i++) {
+        close_client(&clients[i]);
+    }
+    close(listen_fd);
+    listen_fd = -1;
+    xSemaphoreGive(stopped_semaphore);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief 连接数满时关闭最久没有请求的那个 每次轮询都重新连接的主站不会把位置占满
+ */
+static void accept_client(void) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    fast_client_t *slot = NULL;
+    fast_client_t *oldest = NULL;
+    for (int i = 0; i < CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS; i++) {
+        if (clients[i].fd < 0) {
+            slot = &clients[i];
+            break;
+        }
+        if (oldest == NULL ||
+            (int32_t)(clients[i].last_active - oldest->last_active) < 0) {
+            oldest = &clients[i];
+        }
+    }
+    if (slot == NULL) {
+        ESP_LOGW(kTag, "All %d connections in use, closing the least recent",
+                 CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS);
+        close_client(oldest);
+        metrics_increment(METRIC_MODBUS_EVICTIONS);
+        slot = oldest;
+    }
+    // 响应只有几十字节 不等Nagle合并
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    slot->fd = fd;
+    slot->length = 0;
+    slot->last_active = xTaskGetTickCount();
+}
+
+/**
+ * @brief 不阻塞 刚被挤掉的连接的fd可能被新连接复用 此时可能没有数据
+ *
+ * @return 对端关闭或出错时关闭连接并返回false
+ */
+static bool receive(fast_client_t *client) {
+    if (client->length == sizeof(client->frame)) {
+        // 先处理缓冲中的请求
+        return true;
+    }
+    ssize_t received = recv(client->fd, client->frame + client->length,
+                            sizeof(client->frame) - client->length,
+                            MSG_DONTWAIT);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true;
+    }
+    if (received <= 0) {
+        close_client(client);
+        return false;
+    }
+    if (client->length == 0) {
+        client->received_us = esp_timer_get_time();
+    }
+    client->length += received;
+    client->last_active = xTaskGetTickCount();
+    return true;
+}
+
+static bool has_complete_request(const fast_client_t *client) {
+    if (client->length < MB_TCP_HEADER_SIZE) {
+        return false;
+    }
+    uint16_t adu_length =
+        MB_TCP_HEADER_SIZE - 1 + ((client->frame[4] << 8) | client->frame[5]);
+    return client->length >= adu_length;
+}
+
+/**
+ * @brief 缓冲中有完整的ADU时回复一个 剩下的留到下一轮
+ */
+static void serve_one_request(fast_client_t *client) {
+    if (client->length < MB_TCP_HEADER_SIZE) {
+        return;
+    }
+    uint8_t *frame = client->frame;
+    uint16_t pdu_length = ((frame[4] << 8) | frame[5]) - 1;
+    if (frame[2] != 0 || frame[3] != 0 || pdu_length == 0 ||
+        pdu_length > MB_TCP_FRAME_SIZE - MB_TCP_HEADER_SIZE) {
+        ESP_LOGW(kTag, "Bad MBAP header, closing connection");
+        close_client(client);
+        return;
+    }
+    uint16_t adu_length = MB_TCP_HEADER_SIZE + pdu_length;
+    if (client->length < adu_length) {
+        return;
+    }
+
+    uint8_t response[MB_TCP_FRAME_SIZE];
+    memcpy(response, frame, MB_TCP_HEADER_SIZE);
+    uint16_t response_pdu = handle_pdu(frame + MB_TCP_HEADER_SIZE, pdu_length,
+                                       response + MB_TCP_HEADER_SIZE);
+    response[4] = (response_pdu + 1) >> 8;
+    response[5] = (response_pdu + 1) & 0xFF;
+    if (!send_response(client, response, MB_TCP_HEADER_SIZE + response_pdu)) {
+        return;
+    }
+    metrics_record_modbus_latency(
+        (uint32_t)(esp_timer_get_time() - client->received_us));
+
+    client->length -= adu_length;
+    memmove(frame, frame + adu_length, client->length);
+    // 后面的请求已经在缓冲中 从现在开始计时
+    client->received_us = esp_timer_get_time();
+}
+
+/**
+ * @brief 支持04 03 06 16 其余功能码回复异常01
+ *
+ * @return 响应PDU的长度
+ */
+static uint16_t handle_pdu(const uint8_t request[], uint16_t length,
+                           uint8_t response[]) {
+    uint8_t function = request[0];
+    uint16_t address = length >= 3 ? (request[1] << 8) | request[2] : 0;
+    uint16_t count = length >= 5 ? (request[3] << 8) | request[4] : 0;
+    uint8_t exception = 0;
+    uint16_t response_length = 0;
+    response[0] = function;
+
+    switch (function) {
+    case 0x04:
+        if (length != 5 || count == 0 || count > MB_REGISTER_MAX_READ) {
+            exception = MB_EXCEPTION_ILLEGAL_DATA_VALUE;
+        } else {
+            exception = read_input(address, count, &response[2]);
+            response[1] = count * 2;
+            response_length = 2 + count * 2;
+        }
+        break;
+    case 0x03:
+        if (length != 5 || count == 0 || count > MB_REGISTER_MAX_READ) {
+            exception = MB_EXCEPTION_ILLEGAL_DATA_VALUE;
+        } else {
+            exception = read_holding(address, count, &response[2]);
+            response[1] = count * 2;
+            response_length = 2 + count * 2;
+        }
+        break;
+    case 0x06:
+        if (length != 5) {
+            exception = MB_EXCEPTION_ILLEGAL_DATA_VALUE;
+        } else {
+            exception = write_holding(address, 1, &request[3]);
+            memcpy(response, request, 5);
+            response_length = 5;
+        }
+        break;
+    case 0x10:
+        if (length < 6 || count == 0 || count > MB_REGISTER_MAX_WRITE ||
+            request[5] != count * 2 || length != 6 + count * 2) {
+            exception = MB_EXCEPTION_ILLEGAL_DATA_VALUE;
+        } else {
+            exception = write_holding(address, count, &request[6]);
+            memcpy(response, request, 5);
+            response_length = 5;
+        }
+        break;
+    default:
+        exception = MB_EXCEPTION_ILLEGAL_FUNCTION;
+        break;
+    }
+
+    if (exception != 0) {
+        response[0] = function | 0x80;
+        response[1] = exception;
+        return 2;
+    }
+    return response_length;
+}
+
+/**
+ * @brief 一次只能读样本或追踪寄存器中的一块 和esp-modbus的寄存器区一样
+ * 读到age_us时填写样本写入寄存器到现在的时间
+ */
+static uint8_t read_input(uint16_t address, uint16_t count, uint8_t data[]) {
+    if (address + count <= MB_INPUT_REGISTER_COUNT) {
+        portENTER_CRITICAL();
+        memcpy(data, &input_image[address * 2], count * 2);
+        portEXIT_CRITICAL();
+    } else if (address >= MB_TRACE_REGISTER_START &&
+               address + count <=
+                   MB_TRACE_REGISTER_START + MB_TRACE_REGISTER_COUNT) {
+        uint8_t image[sizeof(trace_image)];
+        portENTER_CRITICAL();
+        memcpy(image, trace_image, sizeof(image));
+        int64_t updated_us = trace_updated_us;
+        portEXIT_CRITICAL();
+        // trace_id为0时整块都是0
+        if (image[0] | image[1] | image[2] | image[3]) {
+            uint32_t age_us = (uint32_t)(esp_timer_get_time() - updated_us);
+            uint8_t *age = &image[MB_TRACE_AGE_REGISTER * 2];
+            age[0] = age_us >> 24;
+            age[1] = (age_us >> 16) & 0xFF;
+            age[2] = (age_us >> 8) & 0xFF;
+            age[3] = age_us & 0xFF;
+        }
+        memcpy(data, &image[(address - MB_TRACE_REGISTER_START) * 2],
+               count * 2);
+    } else {
+        return MB_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    }
+    metrics_increment(METRIC_MODBUS_INPUT_READS);
+    return 0;
+}
+
+static uint8_t read_holding(uint16_t address, uint16_t count, uint8_t data[]) {
+    if (address + count > MB_HOLDING_REGISTER_COUNT) {
+        return MB_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    }
+    portENTER_CRITICAL();
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t value = holding_reg_params.registers[address + i];
+        data[i * 2] = value >> 8;
+        data[i * 2 + 1] = value & 0xFF;
+    }
+    portEXIT_CRITICAL();
+    return 0;
+}
+
+static uint8_t write_holding(uint16_t address, uint16_t count,
+                             const uint8_t data[]) {
+    if (address + count > MB_HOLDING_REGISTER_COUNT) {
+        return MB_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    }
+    portENTER_CRITICAL();
+    for (uint16_t i = 0; i < count; i++) {
+        holding_reg_params.registers[address + i] =
+            (data[i * 2] << 8) | data[i * 2 + 1];
+    }
+    portEXIT_CRITICAL();
+    metrics_increment(METRIC_MODBUS_HOLDING_WRITES);
+    if (write_callback != NULL) {
+        write_callback();
+    }
+    return 0;
+}
+
+/**
+ * @brief 不阻塞 一个不读响应的主站不能卡住其他连接
+ * 发送缓冲放不下整个响应时关闭连接 半帧会让主站后面的响应全部错位
+ *
+ * @return 没有全部发出时关闭连接并返回false
+ */
+static bool send_response(fast_client_t *client, const uint8_t response[],
+                          uint16_t length) {
+    uint16_t sent_total = 0;
+    while (sent_total < length) {
+        ssize_t sent = send(client->fd, response + sent_total,
+                            length - sent_total, MSG_DONTWAIT);
+        if (sent > 0) {
+            sent_total += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            ESP_LOGW(kTag, "Send buffer full, closing connection");
+        }
+        close_client(client);
+        return false;
+    }
+    return true;
+}
+
+static void close_client(fast_client_t *client) {
+    if (client->fd < 0) {
+        return;
+    }
+    close(client->fd);
+    client->fd = -1;
+    client->length = 0;
+}
+
+static void close_idle_clients(void) {
+    TickType_t now = xTaskGetTickCount();
+    for (int i = 0; i < CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0 &&
+            now - clients[i].last_active >
+                pdMS_TO_TICKS(CONFIG_MODBUS_FAST_SLAVE_IDLE_TIMEOUT_S * 1000)) {
+            ESP_LOGI(kTag, "Closing idle connection");
+            close_client(&clients[i]);
+        }
+    }
+}
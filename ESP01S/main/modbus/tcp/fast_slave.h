@@ -0,0 +1,33 @@
+#ifndef MODBUS_FAST_SLAVE_H
+#define MODBUS_FAST_SLAVE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "modbus/common/modbus_params.h"
+
+/**
+ * @brief 主站写保持寄存器后在服务任务中调用
+ */
+typedef void (*fast_slave_write_callback_t)(void);
+
+/**
+ * @brief 在port上监听 连接数满时关闭最久没有请求的连接
+ * 每轮每个连接最多处理一个请求 一个主站连续发请求时不会饿死其他主站
+ *
+ * @return 监听失败时返回false
+ */
+bool fast_slave_start(uint16_t port, fast_slave_write_callback_t on_write);
+/**
+ * @brief 等服务任务退出后返回 所有连接都会关闭
+ */
+void fast_slave_stop(void);
+/**
+ * @brief 把输入寄存器编码成线上的字节序 读请求直接拷贝 不再逐个寄存器转换
+ * 读追踪寄存器时age_us按updated_us到读请求的时间填写
+ *
+ * @param updated_us 写入寄存器时的esp_timer_get_time()
+ */
+void fast_slave_update_input(const input_reg_params_t *params,
+                             const trace_reg_params_t *trace,
+                             int64_t updated_us);
+
+#endif // MODBUS_FAST_SLAVE_H
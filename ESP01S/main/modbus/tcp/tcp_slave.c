@@ -4,12 +4,19 @@
    software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
    CONDITIONS OF ANY KIND, either express or implied.
 */
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
 #include "esp_err.h"
 #include "esp_wifi.h"
 #include "mdns_service.h"
 #include "sdkconfig.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "metrics/metrics.h"
+#include "modbus/tcp/fast_slave.h"
+#include "modbus/tcp/tcp_slave.h"
 
 #include "esp_system.h"
 #include "esp_event.h"
@@ -23,6 +30,8 @@
 
 // Defines below are used to define register start address for each type of Modbus registers
 #define MB_REG_INPUT_START                  (0x0000)
+#define MB_REG_HOLDING_START                (0x0000)
+#define MB_REG_TRACE_START                  (MB_TRACE_REGISTER_START)
 
 #define MB_PAR_INFO_GET_TOUT                (50) // Timeout for get parameter info
 
@@ -35,8 +44,15 @@
 #define MB_READ_WRITE_MASK                  (MB_READ_MASK | MB_WRITE_MASK)
 
 static const char kTag[] = "MB_SLAVE";
+static void apply_time_from_master(void);
+static uint16_t *put_u32(uint16_t *registers, uint32_t value);
+static uint16_t *put_scaled(uint16_t *registers, float value);
+static uint16_t *put_trace_u32(uint16_t *registers, uint32_t value);
+#if !CONFIG_MODBUS_FAST_SLAVE
 static TaskHandle_t mb_event_task_handler = NULL;
+static void start_controller(void);
 static void modbus_event_task(void *pvParameters);
+#endif
 
 /**
  * @brief Initialize Modbus slave stack
@@ -45,17 +61,23 @@ static void modbus_event_task(void *pvParameters);
  */
 void modbus_init(void)
 {
-    esp_err_t result = nvs_flash_init();
-    if (result == ESP_ERR_NVS_NO_FREE_PAGES) {
-      ESP_ERROR_CHECK(nvs_flash_erase());
-      result = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(result);
-    esp_netif_init();
-
     ESP_ERROR_CHECK(start_mdns_service());
     ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
+#if CONFIG_MODBUS_FAST_SLAVE
+    if (!fast_slave_start(MB_TCP_PORT_NUMBER, apply_time_from_master)) {
+        ESP_LOGE(kTag, "Failed to start Modbus slave");
+    }
+#else
+    start_controller();
+#endif
+}
 
+#if !CONFIG_MODBUS_FAST_SLAVE
+/**
+ * @brief 通用的esp-modbus控制器 每次寄存器访问都经过事件任务
+ */
+static void start_controller(void)
+{
     void* mbc_slave_handler = NULL;
 
     // Initialization of Modbus controller
@@ -89,6 +111,20 @@ void modbus_init(void)
     reg_area.size = sizeof(input_reg_params); // Set the size of register storage instance
     ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
 
+    // 追踪寄存器 age_us一直为0 读请求经过事件任务时已经来不及填写
+    reg_area.type = MB_PARAM_INPUT;
+    reg_area.start_offset = MB_REG_TRACE_START;
+    reg_area.address = (void*)&trace_reg_params;
+    reg_area.size = sizeof(trace_reg_params);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+
+    // Initialization of Holding Registers area
+    reg_area.type = MB_PARAM_HOLDING;
+    reg_area.start_offset = MB_REG_HOLDING_START;
+    reg_area.address = (void*)&holding_reg_params;
+    reg_area.size = sizeof(holding_reg_params);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+
     // Starts of modbus controller and stack
     ESP_ERROR_CHECK(mbc_slave_start());
     xTaskCreate(modbus_event_task, "modbus_event_task", 1024, NULL, 4, &mb_event_task_handler);
@@ -104,37 +140,154 @@ static void modbus_event_task(void *pvParameters) {
             // Get parameter information from parameter queue
             ESP_ERROR_CHECK(
                 mbc_slave_get_param_info(&reg_info, MB_PAR_INFO_GET_TOUT));
-            ESP_LOGI(
+            ESP_LOGD(
                 kTag,
                 "INPUT %s (%u us), ADDR:%u, TYPE:%u, INST_ADDR:0x%.4x, SIZE:%u",
                 rw_str, (uint32_t)reg_info.time_stamp, (uint32_t)reg_info.mb_offset,
                 (uint32_t)reg_info.type, (uint32_t)reg_info.address,
                 (uint32_t)reg_info.size);
+            metrics_increment(METRIC_MODBUS_INPUT_READS);
+            metrics_record_modbus_latency((uint32_t)esp_timer_get_time() -
+                                          (uint32_t)reg_info.time_stamp);
         }
+        if (event & MB_EVENT_HOLDING_REG_WR) {
+            ESP_ERROR_CHECK(
+                mbc_slave_get_param_info(&reg_info, MB_PAR_INFO_GET_TOUT));
+            ESP_LOGD(kTag, "HOLDING %s, ADDR:%u, SIZE:%u", rw_str,
+                     (uint32_t)reg_info.mb_offset, (uint32_t)reg_info.size);
+            metrics_increment(METRIC_MODBUS_HOLDING_WRITES);
+            metrics_record_modbus_latency((uint32_t)esp_timer_get_time() -
+                                          (uint32_t)reg_info.time_stamp);
+            apply_time_from_master();
+        }
+    }
+}
+#endif
+
+/**
+ * @brief 主站一次写入两个寄存器 字序见CONFIG_MODBUS_HOLDING_WORD_ORDER
+ * STM32下一次同步时就会拿到这个时间
+ */
+static void apply_time_from_master(void) {
+    portENTER_CRITICAL();
+    uint16_t first = holding_reg_params.registers[0];
+    uint16_t second = holding_reg_params.registers[1];
+    portEXIT_CRITICAL();
+#if CONFIG_MODBUS_HOLDING_WORD_ORDER_LOW_FIRST
+    uint32_t epoch_seconds = ((uint32_t)second << 16) | first;
+#else
+    uint32_t epoch_seconds = ((uint32_t)first << 16) | second;
+#endif
+    if (epoch_seconds < MIN_VALID_EPOCH || epoch_seconds > MAX_VALID_EPOCH) {
+        // 写错的时间会被同步给STM32 打到之后所有样本上
+        ESP_LOGW(kTag, "Ignoring epoch %u from master", epoch_seconds);
+        return;
     }
+    struct timeval now = { .tv_sec = epoch_seconds, .tv_usec = 0 };
+    settimeofday(&now, NULL);
+    ESP_LOGI(kTag, "System time set to %u", epoch_seconds);
 }
 
 void modbus_deinit(void)
 {
     ESP_LOGI(kTag, "Deinitializing Modbus slave stack...");
+#if CONFIG_MODBUS_FAST_SLAVE
+    fast_slave_stop();
+#else
     if (mb_event_task_handler == NULL) {
         ESP_LOGI(kTag, "Modbus event task handler is NULL, cannot delete task.");
     } else {
         vTaskDelete(mb_event_task_handler);
+        mb_event_task_handler = NULL;
     }
     ESP_LOGI(kTag,"Modbus controller destroyed.");
     vTaskDelay(100);
     // Stop Modbus controller
-    // TODO 由于WIFI密码错误 前面EventBits一直堵塞导致没执行modbus_init
     ESP_ERROR_CHECK(mbc_slave_destroy());
+#endif
     stop_mdns_service();
     ESP_LOGI(kTag, "Modbus slave stack deinitialized.");
 }
 
-void modbus_update_temp_and_humi(float temperature, float humidity)
+void modbus_update_temp_and_humi(float temperature, float humidity,
+                                 uint32_t timestamp,
+                                 const modbus_trace_t *trace)
 {
+    input_reg_params_t params;
+    uint16_t *next = params.registers;
+    next = put_scaled(next, humidity);
+    next = put_scaled(next, temperature);
+    put_u32(next, timestamp);
+
+    trace_reg_params_t trace_params = { 0 };
+    int64_t updated_us = esp_timer_get_time();
+    if (trace != NULL && trace->id != 0) {
+        next = trace_params.registers;
+        next = put_trace_u32(next, trace->id);
+        next = put_trace_u32(next, trace->conversion_us);
+        next = put_trace_u32(next, trace->link_us);
+        put_trace_u32(next, (uint32_t)(updated_us - trace->received_us));
+    }
     portENTER_CRITICAL();
-    input_reg_params.temperature = temperature;
-    input_reg_params.humidity = humidity;
+    input_reg_params = params;
+    trace_reg_params = trace_params;
     portEXIT_CRITICAL();
-}
\ No newline at end of file
+#if CONFIG_MODBUS_FAST_SLAVE
+    // 每个样本编码一次 之后的读请求直接拷贝
+    fast_slave_update_input(&params, &trace_params, updated_us);
+#endif
+}
+
+/**
+ * @brief 按CONFIG_MODBUS_INPUT_WORD_ORDER写两个寄存器
+ *
+ * @return 下一个寄存器
+ */
+static uint16_t *put_u32(uint16_t *registers, uint32_t value)
+{
+#if CONFIG_MODBUS_INPUT_WORD_ORDER_LOW_FIRST
+    registers[0] = value & 0xFFFF;
+    registers[1] = value >> 16;
+#else
+    registers[0] = value >> 16;
+    registers[1] = value & 0xFFFF;
+#endif
+    return registers + 2;
+}
+
+/**
+ * @brief 追踪寄存器不随字序配置变化 总是高16位在前
+ *
+ * @return 下一个寄存器
+ */
+static uint16_t *put_trace_u32(uint16_t *registers, uint32_t value)
+{
+    registers[0] = value >> 16;
+    registers[1] = value & 0xFFFF;
+    return registers + 2;
+}
+
+/**
+ * @brief 按CONFIG_MODBUS_INPUT_FORMAT编码一个测量值 整数格式四舍五入到0.01
+ *
+ * @return 下一个寄存器
+ */
+static uint16_t *put_scaled(uint16_t *registers, float value)
+{
+#if CONFIG_MODBUS_INPUT_FORMAT_INT16_X100
+    float scaled = roundf(value * 100);
+    if (scaled > INT16_MAX) {
+        scaled = INT16_MAX;
+    } else if (scaled < INT16_MIN) {
+        scaled = INT16_MIN;
+    }
+    registers[0] = (uint16_t)(int16_t)scaled;
+    return registers + 1;
+#elif CONFIG_MODBUS_INPUT_FORMAT_INT32_X100
+    return put_u32(registers, (uint32_t)(int32_t)roundf(value * 100));
+#else
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return put_u32(registers, bits);
+#endif
+}
@@ -1,7 +1,32 @@
 #ifndef MODBUS_TCP_SLAVE_H
 #define MODBUS_TCP_SLAVE_H
+#include <stdint.h>
+
+/* 主站写入的时间只接受这个范围 早于2020-01-01说明主站还没设置过时间 */
+#define MIN_VALID_EPOCH 1577836800
+/* 2100-01-01 更大的值是字序配错或写坏的寄存器 */
+#define MAX_VALID_EPOCH 4102444800U
+
+/**
+ * @brief 实时样本的追踪信息 各段时间见modbus_params.h中的追踪寄存器
+ */
+typedef struct {
+    uint16_t id;
+    uint32_t conversion_us;
+    uint32_t link_us;
+    // 串口中断收完整帧时的esp_timer_get_time()
+    int64_t received_us;
+} modbus_trace_t;
+
 void modbus_deinit(void);
 void modbus_init(void);
-void modbus_update_temp_and_humi(float temperature, float humidity);
+/**
+ * @brief 样本和追踪寄存器一起更新 读到的追踪信息总是属于当前样本
+ *
+ * @param trace 补发的样本传NULL 追踪寄存器清零
+ */
+void modbus_update_temp_and_humi(float temperature, float humidity,
+                                 uint32_t timestamp,
+                                 const modbus_trace_t *trace);
 
 #endif // MODBUS_TCP_SLAVE_H
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef UART_FIFO_H
+#define UART_FIFO_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp8266/uart_struct.h"
+
+/**
+ * @brief app_uart直接读写UART0 FIFO的几个寄存器操作
+ * 在中断中调用 必须内联进IRAM中的函数
+ * 主机构建时换成ESP01S/host/port中基于pty的实现
+ */
+#define UART_FIFO_INLINE static inline __attribute__((always_inline))
+
+UART_FIFO_INLINE uint32_t uart_fifo_interrupt_status(void) {
+    return uart0.int_st.val;
+}
+
+UART_FIFO_INLINE bool uart_fifo_is_rx_timeout(void) {
+    return uart0.int_st.rxfifo_tout;
+}
+
+UART_FIFO_INLINE void uart_fifo_clear_interrupt(uint32_t status) {
+    uart0.int_clr.val = status;
+}
+
+UART_FIFO_INLINE uint32_t uart_fifo_rx_count(void) {
+    return uart0.status.rxfifo_cnt;
+}
+
+UART_FIFO_INLINE uint8_t uart_fifo_read(void) {
+    return uart0.fifo.rw_byte;
+}
+
+UART_FIFO_INLINE uint32_t uart_fifo_tx_count(void) {
+    return uart0.status.txfifo_cnt;
+}
+
+UART_FIFO_INLINE void uart_fifo_write(uint8_t byte) {
+    uart0.fifo.rw_byte = byte;
+}
+
+#endif // UART_FIFO_H
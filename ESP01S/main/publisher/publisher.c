@@ -0,0 +1,242 @@
+#include "publisher/publisher.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "metrics/metrics.h"
+#include "sdkconfig.h"
+#if CONFIG_PUBLISHER_TRANSPORT_MQTT
+#include "mqtt_client.h"
+#elif CONFIG_PUBLISHER_TRANSPORT_UDP
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+#endif
+
+#if CONFIG_PUBLISHER_TRANSPORT_NONE
+/* 只用Modbus轮询 */
+void publisher_init(void) {}
+void publisher_start(void) {}
+void publisher_stop(void) {}
+void publisher_push(const ProtocolSampleRecord records[], uint8_t count) {
+    (void)records;
+    (void)count;
+}
+#else
+/* 推送任务来不及处理时最多排队这么多条 */
+#define PUBLISHER_QUEUE_LENGTH 32
+/* 没连上时重试发送的最短间隔 */
+#define PUBLISHER_RETRY_MS 1000
+
+static void publisher_task(void *pvParameters);
+static bool flush_batch(void);
+static bool transport_open(void);
+static void transport_close(void);
+static bool transport_send(const uint8_t frame[], uint16_t length);
+
+static const char kTag[] = "PUBLISHER";
+static QueueHandle_t record_queue = NULL;
+/* start和stop在wifi_service_task中调用 与推送任务互斥 */
+static SemaphoreHandle_t transport_mutex = NULL;
+static bool is_transport_open = false;
+/* 只在推送任务中访问 发送失败时留着下次再发 */
+static ProtocolSampleRecord batch[PROTOCOL_PUSH_SAMPLES_MAX_COUNT];
+static uint8_t batch_count = 0;
+static uint16_t push_sequence = 0;
+
+void publisher_init(void) {
+    record_queue = xQueueCreate(PUBLISHER_QUEUE_LENGTH,
+                                sizeof(ProtocolSampleRecord));
+    transport_mutex = xSemaphoreCreateMutex();
+    xTaskCreate(publisher_task, "publisher_task", 2048, NULL, 3, NULL);
+}
+
+void publisher_start(void) {
+    xSemaphoreTake(transport_mutex, portMAX_DELAY);
+    if (!is_transport_open) {
+        is_transport_open = transport_open();
+    }
+    xSemaphoreGive(transport_mutex);
+    ESP_LOGI(kTag, "Publisher %s", is_transport_open ? "started" : "failed to start");
+}
+
+void publisher_stop(void) {
+    xSemaphoreTake(transport_mutex, portMAX_DELAY);
+    if (is_transport_open) {
+        transport_close();
+        is_transport_open = false;
+    }
+    xSemaphoreGive(transport_mutex);
+}
+
+void publisher_push(const ProtocolSampleRecord records[], uint8_t count) {
+    if (record_queue == NULL) {
+        return;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (xQueueSend(record_queue, &records[i], 0) != pdTRUE) {
+            ESP_LOGW(kTag, "Queue full, sample dropped");
+            metrics_increment(METRIC_PUBLISHER_DROPS);
+        }
+    }
+}
+
+/**
+ * @brief 攒够CONFIG_PUBLISHER_BATCH_SIZE条或第一条等满超时后发出一帧
+ * 批大小为1时每条样本到达就立即发送
+ */
+static void publisher_task(void *pvParameters) {
+    TickType_t deadline = 0;
+    /* 上次发送失败 攒满一批也要等到deadline再重试 */
+    bool is_retrying = false;
+    while (1) {
+        TickType_t wait = portMAX_DELAY;
+        if (batch_count > 0) {
+            TickType_t now = xTaskGetTickCount();
+            wait = (int32_t)(deadline - now) > 0 ? deadline - now : 0;
+        }
+        ProtocolSampleRecord record;
+        if (xQueueReceive(record_queue, &record, wait) == pdTRUE) {
+            if (batch_count == 0) {
+                deadline = xTaskGetTickCount() +
+                           pdMS_TO_TICKS(CONFIG_PUBLISHER_BATCH_TIMEOUT_MS);
+            }
+            if (batch_count == PROTOCOL_PUSH_SAMPLES_MAX_COUNT) {
+                // 长时间发不出去 丢掉最旧的一条
+                memmove(&batch[0], &batch[1],
+                        (PROTOCOL_PUSH_SAMPLES_MAX_COUNT - 1) * sizeof(batch[0]));
+                batch_count--;
+                ESP_LOGW(kTag, "Not connected, oldest sample dropped");
+                metrics_increment(METRIC_PUBLISHER_DROPS);
+            }
+            batch[batch_count++] = record;
+            if (batch_count < CONFIG_PUBLISHER_BATCH_SIZE || is_retrying) {
+                continue;
+            }
+        }
+        if (batch_count == 0) {
+            continue;
+        }
+        is_retrying = !flush_batch();
+        if (is_retrying) {
+            int retry_ms = CONFIG_PUBLISHER_BATCH_TIMEOUT_MS > PUBLISHER_RETRY_MS
+                               ? CONFIG_PUBLISHER_BATCH_TIMEOUT_MS
+                               : PUBLISHER_RETRY_MS;
+            deadline = xTaskGetTickCount() + pdMS_TO_TICKS(retry_ms);
+        }
+    }
+}
+
+/**
+ * @brief 格式见protocol.h中的ProtocolPushSamples 发出后清空batch
+ *
+ * @return 没连上或发送失败时返回false batch保持不变
+ */
+static bool flush_batch(void) {
+    uint8_t frame[PROTOCOL_PUSH_SAMPLES_MAX_SIZE];
+    ProtocolPushSamples *message = protocol_push_samples_init(frame);
+    message->sequence = push_sequence;
+    message->count = batch_count;
+    memcpy(message->records, batch, batch_count * sizeof(batch[0]));
+    uint16_t length = protocol_push_samples_seal(frame);
+
+    xSemaphoreTake(transport_mutex, portMAX_DELAY);
+    bool is_sent = is_transport_open && transport_send(frame, length);
+    xSemaphoreGive(transport_mutex);
+    if (!is_sent) {
+        return false;
+    }
+    push_sequence++;
+    batch_count = 0;
+    return true;
+}
+
+#if CONFIG_PUBLISHER_TRANSPORT_MQTT
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+/* <prefix>/<MAC>/samples */
+static char mqtt_topic[64];
+
+static bool transport_open(void) {
+    uint8_t mac[6] = {0};
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(mqtt_topic, sizeof(mqtt_topic), "%s/%02X%02X%02X%02X%02X%02X/samples",
+             CONFIG_PUBLISHER_MQTT_TOPIC_PREFIX,
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    esp_mqtt_client_config_t config = {
+        .uri = CONFIG_PUBLISHER_MQTT_URI,
+    };
+    mqtt_client = esp_mqtt_client_init(&config);
+    if (mqtt_client == NULL) {
+        return false;
+    }
+    // 连接在MQTT自己的任务中进行 断线后也由它重连
+    if (esp_mqtt_client_start(mqtt_client) != ESP_OK) {
+        esp_mqtt_client_destroy(mqtt_client);
+        mqtt_client = NULL;
+        return false;
+    }
+    ESP_LOGI(kTag, "Publishing to %s topic %s", CONFIG_PUBLISHER_MQTT_URI,
+             mqtt_topic);
+    return true;
+}
+
+static void transport_close(void) {
+    esp_mqtt_client_stop(mqtt_client);
+    esp_mqtt_client_destroy(mqtt_client);
+    mqtt_client = NULL;
+}
+
+/**
+ * @brief QoS 1时消息留在outbox中 直到broker回复PUBACK
+ * 还没连上broker时返回失败 由推送任务稍后重发
+ */
+static bool transport_send(const uint8_t frame[], uint16_t length) {
+    return esp_mqtt_client_publish(mqtt_client, mqtt_topic, (const char *)frame,
+                                   length, CONFIG_PUBLISHER_MQTT_QOS, 0) >= 0;
+}
+#elif CONFIG_PUBLISHER_TRANSPORT_UDP
+static int udp_socket = -1;
+static struct sockaddr_in collector;
+
+static bool transport_open(void) {
+    struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_DGRAM,
+    };
+    struct addrinfo *result = NULL;
+    if (getaddrinfo(CONFIG_PUBLISHER_UDP_HOST, NULL, &hints, &result) != 0 ||
+        result == NULL) {
+        ESP_LOGE(kTag, "Failed to resolve %s", CONFIG_PUBLISHER_UDP_HOST);
+        return false;
+    }
+    memcpy(&collector, result->ai_addr, sizeof(collector));
+    collector.sin_port = htons(CONFIG_PUBLISHER_UDP_PORT);
+    freeaddrinfo(result);
+    udp_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (udp_socket < 0) {
+        return false;
+    }
+    ESP_LOGI(kTag, "Publishing to %s:%d", CONFIG_PUBLISHER_UDP_HOST,
+             CONFIG_PUBLISHER_UDP_PORT);
+    return true;
+}
+
+static void transport_close(void) {
+    close(udp_socket);
+    udp_socket = -1;
+}
+
+/**
+ * @brief UDP没有确认 接收端用帧的sequence统计丢失
+ */
+static bool transport_send(const uint8_t frame[], uint16_t length) {
+    return sendto(udp_socket, frame, length, 0, (struct sockaddr *)&collector,
+                  sizeof(collector)) == length;
+}
+#endif
+#endif // CONFIG_PUBLISHER_TRANSPORT_NONE
@@ -0,0 +1,26 @@
+#ifndef PUBLISHER_H
+#define PUBLISHER_H
+#include <stdint.h>
+#include "protocol.h"
+
+/**
+ * @brief 创建推送任务 WIFI连接之前调用
+ * menuconfig中没有选择推送方式时什么也不做
+ */
+void publisher_init(void);
+/**
+ * @brief 拿到IP后连接MQTT broker或打开UDP socket
+ */
+void publisher_start(void);
+/**
+ * @brief 断开网络前关闭连接 未发出的样本留到下次start
+ */
+void publisher_stop(void);
+/**
+ * @brief 把样本交给推送任务 不阻塞 队列满时丢弃 计入METRIC_PUBLISHER_DROPS
+ *
+ * @param records 按时间顺序
+ */
+void publisher_push(const ProtocolSampleRecord records[], uint8_t count);
+
+#endif // PUBLISHER_H
@@ -0,0 +1,124 @@
+#include "wifi/fast_connect.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "nvs.h"
+#include "tcpip_adapter.h"
+
+#define NVS_NAMESPACE "wifi_fast"
+#define NVS_KEY "last_ap"
+
+/**
+ * @brief 保存在NVS中的上一次连接
+ * 只有ssid一致时才使用 换了配置的旧缓存自动作废
+ */
+typedef struct {
+    uint8_t ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+    tcpip_adapter_ip_info_t ip_info;
+    tcpip_adapter_dns_info_t dns_info;
+} fast_connect_cache_t;
+
+static bool read_cache(fast_connect_cache_t *cache);
+
+static const char kTag[] = "FAST_CONNECT";
+/* 当前用的是缓存的IP DHCP还没有重新启动 */
+static bool is_lease_cached = false;
+
+bool fast_connect_load(wifi_config_t *config) {
+    fast_connect_cache_t cache;
+    if (!read_cache(&cache) ||
+        memcmp(cache.ssid, config->sta.ssid, sizeof(cache.ssid)) != 0) {
+        return false;
+    }
+    // 跳过扫描 直接在缓存的信道上向这个AP发起关联
+    memcpy(config->sta.bssid, cache.bssid, sizeof(cache.bssid));
+    config->sta.bssid_set = 1;
+    config->sta.channel = cache.channel;
+    config->sta.scan_method = WIFI_FAST_SCAN;
+    // 关联后不等DHCP 用上一次的租约立刻提供服务
+    tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+    tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &cache.ip_info);
+    // DHCP停止后不会再下发DNS 不设置时域名解析全部失败
+    tcpip_adapter_set_dns_info(TCPIP_ADAPTER_IF_STA, TCPIP_ADAPTER_DNS_MAIN,
+                               &cache.dns_info);
+    is_lease_cached = true;
+    ESP_LOGI(kTag, "Fast connect to " MACSTR " on channel %u, ip " IPSTR,
+             MAC2STR(cache.bssid), cache.channel, IP2STR(&cache.ip_info.ip));
+    return true;
+}
+
+bool fast_connect_renew_lease(void) {
+    if (!is_lease_cached) {
+        return false;
+    }
+    is_lease_cached = false;
+    // AP一般会把同一个地址续给这个MAC 地址变了时GOT_IP带ip_changed
+    if (tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA) != ESP_OK) {
+        return false;
+    }
+    ESP_LOGI(kTag, "Associated with cached ip, renewing the lease over DHCP");
+    return true;
+}
+
+void fast_connect_save(const wifi_config_t *config,
+                       const ip_event_got_ip_t *event) {
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        return;
+    }
+    fast_connect_cache_t cache;
+    memset(&cache, 0, sizeof(cache));
+    memcpy(cache.ssid, config->sta.ssid, sizeof(cache.ssid));
+    memcpy(cache.bssid, ap_info.bssid, sizeof(cache.bssid));
+    cache.channel = ap_info.primary;
+    cache.ip_info = event->ip_info;
+    tcpip_adapter_get_dns_info(TCPIP_ADAPTER_IF_STA, TCPIP_ADAPTER_DNS_MAIN,
+                               &cache.dns_info);
+
+    // 每次重连都写flash会很快磨损 没变化就不写
+    fast_connect_cache_t current;
+    if (read_cache(&current) && memcmp(&current, &cache, sizeof(cache)) == 0) {
+        return;
+    }
+    nvs_handle handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(handle, NVS_KEY, &cache, sizeof(cache)) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+void fast_connect_abandon(wifi_config_t *config) {
+    config->sta.bssid_set = 0;
+    config->sta.channel = 0;
+    config->sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    // 已经在运行时返回错误 忽略即可
+    tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+    is_lease_cached = false;
+
+    nvs_handle handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    nvs_erase_key(handle, NVS_KEY);
+    nvs_commit(handle);
+    nvs_close(handle);
+    ESP_LOGI(kTag, "Fast connect abandoned, falling back to scan and DHCP");
+}
+
+static bool read_cache(fast_connect_cache_t *cache) {
+    nvs_handle handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t length = sizeof(*cache);
+    esp_err_t result = nvs_get_blob(handle, NVS_KEY, cache, &length);
+    nvs_close(handle);
+    return result == ESP_OK && length == sizeof(*cache);
+}
@@ -0,0 +1,34 @@
+#ifndef WIFI_FAST_CONNECT_H
+#define WIFI_FAST_CONNECT_H
+#include <stdbool.h>
+#include "esp_wifi_types.h"
+#include "tcpip_adapter.h"
+
+/* 定向连接连续失败这么多次后退回全信道扫描和DHCP */
+#define FAST_CONNECT_MAX_ATTEMPTS 2
+
+/**
+ * @brief 读取上一次成功连接的BSSID 信道 IP和DNS 与当前ssid一致时写入config
+ * 同时停止DHCP 直接使用上一次的IP和DNS
+ *
+ * @return 是否走快速连接
+ */
+bool fast_connect_load(wifi_config_t *config);
+/**
+ * @brief 用缓存的IP拿到连接后重新启动DHCP 续上租约
+ * 缓存的租约可能已经过期 不续约时地址可能被AP分给别的设备
+ *
+ * @return 是否重新启动了DHCP 之后还会再收到一次GOT_IP
+ */
+bool fast_connect_renew_lease(void);
+/**
+ * @brief 拿到IP后保存本次的AP IP和DNS 与缓存相同时不写flash
+ */
+void fast_connect_save(const wifi_config_t *config,
+                       const ip_event_got_ip_t *event);
+/**
+ * @brief 清除config中的BSSID和信道 恢复DHCP 删除缓存
+ * 调用者之后需要重新esp_wifi_set_config
+ */
+void fast_connect_abandon(wifi_config_t *config);
+#endif // WIFI_FAST_CONNECT_H
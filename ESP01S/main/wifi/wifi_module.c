@@ -1,4 +1,5 @@
 #include "wifi/wifi_module.h"
+#include <stdbool.h>
 #include <string.h>
 
 #include "esp_err.h"
@@ -9,26 +10,56 @@
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_wifi_types.h"
+#include "mdns/mdns_service.h"
+#include "metrics/metrics.h"
 #include "modbus/tcp/tcp_slave.h"
+#include "publisher/publisher.h"
+#include "wifi/fast_connect.h"
+#include "nvs_flash.h"
 
 #define MAX_WIFI_RETRY_CONNECT 3
-static void check_if_already_connected();
+/* 重连间隔从250ms开始翻倍 最长10s AP短暂掉线时能很快恢复 */
+#define WIFI_RETRY_INITIAL_MS 250
+#define WIFI_RETRY_MAX_MS 10000
 static void connection_handler(void *arg, esp_event_base_t event_base,
                              int32_t event_id, void *event_data);
 static void ip_assigned_handler(void *arg, esp_event_base_t event_base,
                          int32_t event_id, void *event_data);
-static void wifi_reload(const char ssid[], const char password[]);
 static void wifi_retry_timer_callback(TimerHandle_t xTimer);
 static void wifi_load(const char ssid[], const char password[]);
+static void wifi_service_task(void *pvParameters);
+static void apply_new_config(void);
+static void set_auth_threshold(wifi_config_t *config);
 
-EventGroupHandle_t wifi_event_group;
+EventGroupHandle_t wifi_event_group = NULL;
 static const char kTag[] = "WIFI_MODULE";
 static int wifi_retry_num = 0;
 static TimerHandle_t wifi_retry_timer = NULL;
 
 wifi_config_t wifi_cfg = {0};
+/* wifi_set_new_config收到的配置 在wifi_service_task中写入wifi_cfg */
+static wifi_config_t pending_cfg = {0};
+/* pending_cfg还没有应用 UART先于WIFI初始化 事件组创建前收到的配置靠它补上 */
+static bool is_reconfigure_requested = false;
+/* 正在换配置 旧网络主动断开的事件不触发重连 拿到IP后清除 */
+static bool is_reconfiguring = false;
+/* Modbus mDNS 推送和指标只在拿到IP之后运行 */
+static bool are_services_running = false;
+/* 当前是否在用缓存的BSSID 信道和IP连接 */
+static bool is_fast_connect = false;
+/* 第一次拿到IP之后再拿到IP才算重连 */
+static bool has_connected = false;
+/* 快速连接后重新启动了DHCP 下一次GOT_IP是续约而不是重连 */
+static bool is_renewing_lease = false;
 
 void wifi_init_main() {
+    // WIFI配置保存在NVS中 必须先于esp_wifi_init初始化
+    esp_err_t result = nvs_flash_init();
+    if (result == ESP_ERR_NVS_NO_FREE_PAGES) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        result = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(result);
     esp_netif_init();
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -37,61 +68,125 @@ void wifi_init_main() {
     ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
     ESP_ERROR_CHECK(esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_cfg));
     wifi_retry_timer = xTimerCreate("wifi_retry_timer",
-                                                pdMS_TO_TICKS(10000), pdFALSE,
+                                                pdMS_TO_TICKS(WIFI_RETRY_INITIAL_MS), pdFALSE,
                                                 NULL, wifi_retry_timer_callback);
     wifi_load((char *)wifi_cfg.sta.ssid, (char *)wifi_cfg.sta.password);
 }
 
 static void wifi_load(const char ssid[], const char password[]) {
-    wifi_event_group = xEventGroupCreate();
+    EventGroupHandle_t group = xEventGroupCreate();
+    portENTER_CRITICAL();
+    wifi_event_group = group;
+    bool is_requested = is_reconfigure_requested;
+    portEXIT_CRITICAL();
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
                                                &connection_handler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
                                                &ip_assigned_handler, NULL));
     memcpy(wifi_cfg.sta.ssid, ssid, strlen(ssid));
     memcpy(wifi_cfg.sta.password, password, strlen(password));
-
-    if (strlen((char *)wifi_cfg.sta.password)) {
-        wifi_cfg.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
-    }
+    set_auth_threshold(&wifi_cfg);
+    // 上一次连过同一个ssid时跳过全信道扫描和DHCP
+    is_fast_connect = fast_connect_load(&wifi_cfg);
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_cfg));
-    ESP_LOGI(kTag, "wifi:ssid:%s, password:%s",
-             wifi_cfg.sta.ssid, wifi_cfg.sta.password);
+    ESP_LOGI(kTag, "wifi:ssid:%.32s", wifi_cfg.sta.ssid);
+    // 密码错误时也不会卡在这里 之后仍能通过UART换配置
+    xTaskCreate(wifi_service_task, "wifi_service_task", 2048, NULL, 4, NULL);
     ESP_ERROR_CHECK(esp_wifi_start());
+    if (is_requested) {
+        xEventGroupSetBits(group, WIFI_RECONFIGURE_BIT);
+    }
 
     ESP_LOGI(kTag, "wifi_init finished.");
-    check_if_already_connected();
-    modbus_init();
 }
 
 void wifi_set_new_config(const char ssid[], const char password[]) {
-    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
-    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_cfg));
-    ESP_LOGI(kTag, "New wifi config set: ssid:%s, password:%s",
-             wifi_cfg.sta.ssid, wifi_cfg.sta.password);
-    ESP_LOGI(kTag, "Restarting ESP...");
-    esp_restart();
+    portENTER_CRITICAL();
+    memset(&pending_cfg, 0, sizeof(pending_cfg));
+    // 32字节的ssid和64字节的password不要求以0结尾
+    strncpy((char *)pending_cfg.sta.ssid, ssid, sizeof(pending_cfg.sta.ssid));
+    strncpy((char *)pending_cfg.sta.password, password,
+            sizeof(pending_cfg.sta.password));
+    is_reconfigure_requested = true;
+    EventGroupHandle_t group = wifi_event_group;
+    portEXIT_CRITICAL();
+    // 为NULL时wifi_load创建事件组后再置位
+    if (group != NULL) {
+        xEventGroupSetBits(group, WIFI_RECONFIGURE_BIT);
+    }
 }
 
 /**
- * @brief 检测WIFI是否完成连接，并且获取了IP地址
- * 
+ * @brief 拿到IP后启动Modbus和mDNS 换配置时先停掉再重新连接
+ * 在这里而不是事件回调中做 避免阻塞默认事件循环
  */
-static void check_if_already_connected() {
-    EventBits_t bits = xEventGroupWaitBits(wifi_event_group,
-                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                           pdFALSE, pdFALSE, portMAX_DELAY);
-    if (WIFI_CONNECTED_BIT & bits) {
-        ESP_LOGI(kTag, "Connected to AP SSID:%s", wifi_cfg.sta.ssid);
-    } else if (WIFI_FAIL_BIT & bits) {
-        ESP_LOGE(kTag, "Failed to connect to SSID:%s, password:%s",
-                 wifi_cfg.sta.ssid, wifi_cfg.sta.password);
-    } else {
-        ESP_LOGE(kTag, "Unexpected event for WIFI connection");
+static void wifi_service_task(void *pvParameters) {
+    while (1) {
+        EventBits_t bits = xEventGroupWaitBits(
+            wifi_event_group,
+            WIFI_CONNECTED_BIT | WIFI_RECONFIGURE_BIT | WIFI_IP_CHANGED_BIT,
+            pdTRUE, pdFALSE, portMAX_DELAY);
+        if (bits & WIFI_RECONFIGURE_BIT) {
+            apply_new_config();
+            // 旧网络上的连接事件已经作废
+            continue;
+        }
+        if ((bits & WIFI_IP_CHANGED_BIT) && are_services_running) {
+            // 不等旧记录过期 让主站马上知道新地址
+            reannounce_mdns_service();
+        }
+        if ((bits & WIFI_CONNECTED_BIT) && !are_services_running) {
+            ESP_LOGI(kTag, "Connected to AP SSID:%s", wifi_cfg.sta.ssid);
+            modbus_init();
+            publisher_start();
+            metrics_server_start();
+            are_services_running = true;
+        }
     }
-    xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+}
+
+/**
+ * @brief 断开 写入新配置 重新连接 不重启芯片
+ * 已连接的Modbus主站会断开 拿到新IP后在新地址上重新提供服务
+ */
+static void apply_new_config(void) {
+    if (are_services_running) {
+        metrics_server_stop();
+        publisher_stop();
+        modbus_deinit();
+        are_services_running = false;
+    }
+    // 断开事件到达时定时器已经停了 不会和下面的esp_wifi_connect抢着连接
+    is_reconfiguring = true;
+    xTimerStop(wifi_retry_timer, 0);
+    esp_wifi_disconnect();
+    xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
+
+    portENTER_CRITICAL();
+    memcpy(wifi_cfg.sta.ssid, pending_cfg.sta.ssid, sizeof(wifi_cfg.sta.ssid));
+    memcpy(wifi_cfg.sta.password, pending_cfg.sta.password,
+           sizeof(wifi_cfg.sta.password));
+    is_reconfigure_requested = false;
+    portEXIT_CRITICAL();
+    set_auth_threshold(&wifi_cfg);
+    // 缓存的AP和IP属于旧网络
+    fast_connect_abandon(&wifi_cfg);
+    is_fast_connect = false;
+    wifi_retry_num = 0;
+
+    // 只有用户设置的配置写入flash 平时的set_config只改RAM
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_cfg));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    ESP_LOGI(kTag, "New wifi config set: ssid:%.32s", wifi_cfg.sta.ssid);
+    esp_wifi_connect();
+}
+
+static void set_auth_threshold(wifi_config_t *config) {
+    config->sta.threshold.authmode =
+        config->sta.password[0] != '\0' ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
 }
 
 /**
@@ -108,8 +203,32 @@ static void connection_handler(void *arg, esp_event_base_t event_base,
     }
     /* 连接失败处理 */
     if (event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        xTimerReset(wifi_retry_timer, 0);
-        ESP_LOGI(kTag, "A retry will be attempted in 10 seconds");
+        wifi_event_sta_disconnected_t *event =
+            (wifi_event_sta_disconnected_t *)event_data;
+        is_renewing_lease = false;
+        // 换配置时主动离开旧网络 新配置自己的连接失败仍照常重试
+        if (is_reconfiguring && event->reason == WIFI_REASON_ASSOC_LEAVE) {
+            ESP_LOGI(kTag, "Left the old network for the new config");
+            return;
+        }
+        // wifi_retry_num在拿到IP时清零 也就是连续失败的次数
+        if (is_fast_connect && wifi_retry_num + 1 >= FAST_CONNECT_MAX_ATTEMPTS) {
+            // AP换了信道或被替换 缓存已失效 改用扫描和DHCP
+            fast_connect_abandon(&wifi_cfg);
+            esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_cfg);
+            is_fast_connect = false;
+        }
+        uint32_t delay_ms = WIFI_RETRY_INITIAL_MS;
+        for (int i = 0; i < wifi_retry_num && delay_ms < WIFI_RETRY_MAX_MS; i++) {
+            delay_ms *= 2;
+        }
+        if (delay_ms > WIFI_RETRY_MAX_MS) {
+            delay_ms = WIFI_RETRY_MAX_MS;
+        }
+        wifi_retry_num++;
+        // 修改周期同时会启动定时器
+        xTimerChangePeriod(wifi_retry_timer, pdMS_TO_TICKS(delay_ms), 0);
+        ESP_LOGI(kTag, "A retry will be attempted in %u ms", (unsigned)delay_ms);
     }
 }
 
@@ -126,8 +245,22 @@ static void ip_assigned_handler(void *arg, esp_event_base_t event_base,
                          int32_t event_id, void *event_data) {
     ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
     if (event_id == IP_EVENT_STA_GOT_IP) {
+        xTimerStop(wifi_retry_timer, 0);
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
         wifi_retry_num = 0;
+        is_reconfiguring = false;
+        fast_connect_save(&wifi_cfg, event);
+        if (has_connected) {
+            if (!is_renewing_lease) {
+                metrics_increment(METRIC_WIFI_RECONNECTS);
+            }
+            if (event->ip_changed) {
+                xEventGroupSetBits(wifi_event_group, WIFI_IP_CHANGED_BIT);
+            }
+        }
+        has_connected = true;
+        // 缓存的IP只用来尽快提供服务 租约仍由DHCP维护
+        is_renewing_lease = fast_connect_renew_lease();
 
         ESP_LOGI(kTag, "got ip:%d.%d.%d.%d", IP2STR(&event->ip_info.ip));
         return;
@@ -1,7 +1,10 @@
 #ifndef WIFI_HANDLER_H
 #define WIFI_HANDLER_H
 #define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
+/* 收到新的WIFI配置 等待wifi_service_task应用 */
+#define WIFI_RECONFIGURE_BIT BIT2
+/* 重连后拿到的IP与之前不同 需要重新通告mDNS */
+#define WIFI_IP_CHANGED_BIT BIT3
 #include <stdint.h>
 #include "FreeRTOS.h"
 #include "freertos/event_groups.h"
@@ -13,5 +16,9 @@ extern EventGroupHandle_t wifi_event_group;
  * 
  */
 void wifi_init_main(void);
+/**
+ * @brief 保存新的ssid和password 不重启 由后台任务断开 应用 重新连接
+ * 只做拷贝 可以在UART任务中直接调用 wifi_init_main之前收到的配置启动后应用
+ */
 void wifi_set_new_config(const char ssid[], const char password[]);
 #endif // WIFI_HANDLER_H
\ No newline at end of file
@@ -0,0 +1,484 @@
+"""
+根据protocol.json生成STM32 ESP01S和上位机使用的帧编解码代码
+
+    python Protocol/generate.py          重新生成
+    python Protocol/generate.py --check  只检查生成的文件是否最新
+
+C端为packed结构体和static inline函数 直接在接收缓冲上读字段 不拷贝
+Python端为numpy结构化dtype 一次解码整段缓冲中的所有记录
+"""
+import argparse
+import json
+import sys
+from pathlib import Path
+
+ROOT = Path(__file__).resolve().parent.parent
+SCHEMA = ROOT / "Protocol" / "protocol.json"
+C_OUTPUTS = [
+    ROOT / "STM32" / "Core" / "Inc" / "protocol.h",
+    ROOT / "ESP01S" / "main" / "protocol" / "protocol.h",
+]
+PYTHON_OUTPUT = ROOT / "Python" / "src" / "protocol.py"
+
+HEADER_SIZE = 2
+TRAILER_SIZE = 2
+
+# 类型: (C类型, numpy类型, 字节数)
+SCALARS = {
+    "u8": ("uint8_t", "u1", 1),
+    "i8": ("int8_t", "i1", 1),
+    "u16": ("uint16_t", "<u2", 2),
+    "i16": ("int16_t", "<i2", 2),
+    "u32": ("uint32_t", "<u4", 4),
+    "i32": ("int32_t", "<i4", 4),
+    "f32": ("float", "<f4", 4),
+}
+
+
+def camel(name: str) -> str:
+    return "".join(part.capitalize() for part in name.split("_"))
+
+
+class Schema:
+    def __init__(self, data: dict):
+        self.doc = data["doc"]
+        self.constants = data["constants"]
+        self.enums = data["enums"]
+        self.records = data["records"]
+        self.links = data["links"]
+        self.check()
+
+    def resolve(self, value) -> int:
+        if isinstance(value, str):
+            return self.constants[value]["value"]
+        return value
+
+    def type_size(self, type_name: str) -> int:
+        if type_name in SCALARS:
+            return SCALARS[type_name][2]
+        return sum(self.type_size(f["type"]) for f in self.records[type_name]["fields"])
+
+    def message_sizes(self, message: dict) -> tuple[int, int]:
+        """不含tail的最小帧长和tail最长时的帧长"""
+        fixed = HEADER_SIZE + sum(self.type_size(f["type"]) for f in message["fields"]) + TRAILER_SIZE
+        tail = message.get("tail")
+        if tail is None:
+            return fixed, fixed
+        fields = {f["name"]: f for f in message["fields"]}
+        max_count = sum(self.resolve(fields[name]["max"]) for name in tail["count"])
+        return fixed, fixed + max_count * self.type_size(tail["type"])
+
+    def check(self) -> None:
+        limit = self.resolve("MAX_FRAME_SIZE")
+        for link_name, link in self.links.items():
+            seen = set()
+            for message in link["messages"]:
+                if message["name"] in seen:
+                    sys.exit(f"{link_name}.{message['name']}: duplicate message name")
+                seen.add(message["name"])
+                fields = {f["name"]: f for f in message["fields"]}
+                tail = message.get("tail")
+                if tail is not None:
+                    for name in tail["count"]:
+                        if name not in fields or "max" not in fields[name]:
+                            sys.exit(f"{link_name}.{message['name']}: count field {name} needs a max")
+                _, largest = self.message_sizes(message)
+                if largest > limit:
+                    sys.exit(f"{link_name}.{message['name']}: {largest} bytes exceeds MAX_FRAME_SIZE")
+
+
+# ---------------------------------------------------------------- C
+
+def c_type(type_name: str) -> str:
+    if type_name in SCALARS:
+        return SCALARS[type_name][0]
+    return f"Protocol{camel(type_name)}"
+
+
+def c_comment(doc: str | None) -> str:
+    return f"  // {doc}" if doc else ""
+
+
+def c_struct(name: str, fields: list[dict], header: bool, tail: dict | None) -> list[str]:
+    lines = ["typedef struct __attribute__((packed)) {"]
+    if header:
+        lines += ["  uint8_t id;", "  uint8_t checksum;"]
+    for field in fields:
+        doc = field.get("doc")
+        if "enum" in field:
+            doc = f"Protocol{camel(field['enum'])}" + (f" {doc}" if doc else "")
+        lines.append(f"  {c_type(field['type'])} {field['name']};{c_comment(doc)}")
+    if tail is not None:
+        lines.append(f"  {c_type(tail['type'])} {tail['name']}[];{c_comment(tail.get('doc'))}")
+    lines.append(f"}} {name};")
+    return lines
+
+
+def generate_c(schema: Schema) -> str:
+    out = [
+        "/* 由Protocol/generate.py根据Protocol/protocol.json生成 不要手动修改 */",
+        "#ifndef __PROTOCOL_H",
+        "#define __PROTOCOL_H",
+        "#include <math.h>",
+        "#include <stddef.h>",
+        "#include <stdint.h>",
+        "",
+        "/*",
+        schema.doc,
+        "*/",
+        f"#define PROTOCOL_HEADER_SIZE {HEADER_SIZE}U",
+        f"#define PROTOCOL_TRAILER_SIZE {TRAILER_SIZE}U",
+    ]
+    for name, constant in schema.constants.items():
+        out += [f"/* {constant['doc']} */", f"#define PROTOCOL_{name} {constant['value']}U"]
+    out.append("")
+
+    for name, enum in schema.enums.items():
+        out += ["/**", f" * @brief {enum['doc']}", " */", "typedef enum {"]
+        for value_name, value in enum["values"].items():
+            out.append(f"  // {value['doc']}")
+            out.append(f"  PROTOCOL_{name.upper()}_{value_name.upper()} = {value['value']},")
+        out += [f"}} Protocol{camel(name)};", ""]
+
+    for name, record in schema.records.items():
+        type_name = c_type(name)
+        out += ["/**", f" * @brief {record['doc']}", " */"]
+        out += c_struct(type_name, record["fields"], False, None)
+        out.append(f"_Static_assert(sizeof({type_name}) == {schema.type_size(name)}, "
+                   f"\"{type_name} layout\");")
+        out.append("")
+
+    out += [
+        "/**",
+        " * @brief 帧中除checksum外所有字节之和取反 checksum字节本身按0计算",
+        " */",
+        "static inline uint8_t protocol_checksum(const uint8_t frame[], uint16_t length) {",
+        "  uint8_t sum = 0;",
+        "  for (uint16_t i = 0; i < length; i++) {",
+        "    sum += frame[i];",
+        "  }",
+        "  return (uint8_t)~(uint8_t)(sum - frame[1]);",
+        "}",
+        "",
+        "/**",
+        " * @brief 在body后追加\\r\\n并填写checksum",
+        " *",
+        " * @return 整帧长度",
+        " */",
+        "static inline uint16_t protocol_seal(uint8_t frame[], uint16_t body_length) {",
+        "  frame[body_length] = '\\r';",
+        "  frame[body_length + 1] = '\\n';",
+        "  uint16_t length = body_length + PROTOCOL_TRAILER_SIZE;",
+        "  frame[1] = protocol_checksum(frame, length);",
+        "  return length;",
+        "}",
+        "",
+        "/**",
+        " * @brief 以\\r\\n结尾 且所有字节之和为0xFF",
+        " */",
+        "static inline uint8_t protocol_is_valid(const uint8_t frame[], uint16_t length) {",
+        "  if (length < PROTOCOL_HEADER_SIZE + PROTOCOL_TRAILER_SIZE ||",
+        "      frame[length - 2] != '\\r' || frame[length - 1] != '\\n') {",
+        "    return 0;",
+        "  }",
+        "  uint8_t sum = 0;",
+        "  for (uint16_t i = 0; i < length; i++) {",
+        "    sum += frame[i];",
+        "  }",
+        "  return sum == 0xFF;",
+        "}",
+        "",
+        "/**",
+        " * @brief 摄氏度换算为temperature_centi 四舍五入 超出int16时取边界",
+        " * 实时帧 flash日志 推送和Modbus用同一种舍入 同一个样本在各处的值一致",
+        " */",
+        "static inline int16_t protocol_temperature_centi(float celsius) {",
+        "  float centi = celsius * 100.0f;",
+        "  if (!(centi > INT16_MIN)) {",
+        "    return INT16_MIN;",
+        "  }",
+        "  if (centi > INT16_MAX) {",
+        "    return INT16_MAX;",
+        "  }",
+        "  return (int16_t)lroundf(centi);",
+        "}",
+        "",
+        "/**",
+        " * @brief %RH换算为humidity_centi 四舍五入 限制在0到PROTOCOL_HUMIDITY_CENTI_MAX",
+        " */",
+        "static inline uint16_t protocol_humidity_centi(float percent) {",
+        "  float centi = percent * 100.0f;",
+        "  if (!(centi > 0.0f)) {",
+        "    return 0;",
+        "  }",
+        "  if (centi > PROTOCOL_HUMIDITY_CENTI_MAX) {",
+        "    return PROTOCOL_HUMIDITY_CENTI_MAX;",
+        "  }",
+        "  return (uint16_t)lroundf(centi);",
+        "}",
+        "",
+    ]
+
+    for link_name, link in schema.links.items():
+        out += [f"/* ---- {link_name}: {link['doc']} ---- */", ""]
+        for message in link["messages"]:
+            out += generate_c_message(schema, link_name, message)
+
+    out += ["#endif /* __PROTOCOL_H */", ""]
+    return "\n".join(out)
+
+
+def generate_c_message(schema: Schema, link_name: str, message: dict) -> list[str]:
+    base = f"{link_name}_{message['name']}"
+    macro = f"PROTOCOL_{base.upper()}"
+    func = f"protocol_{base}"
+    type_name = f"Protocol{camel(base)}"
+    tail = message.get("tail")
+    fields = message["fields"]
+    bounded = [f for f in fields if "max" in f]
+    minimum, largest = schema.message_sizes(message)
+    arrow = "->" if message["direction"] == "to_device" else "<-"
+
+    out = ["/**", f" * @brief {message['doc']} ({arrow})", " */"]
+    out.append(f"#define {macro}_ID 0x{message['id']:02X}U")
+    out += c_struct(type_name, fields, True, tail)
+    out.append(f"_Static_assert(sizeof({type_name}) == {minimum - TRAILER_SIZE}, \"{type_name} layout\");")
+    for field in bounded:
+        out.append(f"#define {macro}_MAX_{field['name'].upper()} {schema.resolve(field['max'])}U")
+
+    if tail is None:
+        out.append(f"#define {macro}_SIZE {minimum}U")
+    else:
+        out.append(f"#define {macro}_SIZE(count) \\")
+        out.append(f"  (sizeof({type_name}) + (count) * sizeof({c_type(tail['type'])}) + "
+                   "PROTOCOL_TRAILER_SIZE)")
+        out.append(f"#define {macro}_MAX_SIZE {largest}U")
+        count_expr = " + ".join(f"message->{name}" for name in tail["count"])
+
+    # 解码: 检查id 长度和各字段的上限 返回指向原缓冲的指针
+    out += [
+        "",
+        "/**",
+        " * @brief 在接收缓冲上直接解析 不检查checksum",
+        " *",
+        " * @return 格式不对时返回NULL",
+        " */",
+        f"static inline const {type_name} *",
+        f"{func}_view(const uint8_t frame[], uint16_t length) {{",
+    ]
+    if tail is None:
+        out += [
+            f"  if (length != {macro}_SIZE ||",
+            f"      frame[0] != {macro}_ID) {{",
+            "    return NULL;",
+            "  }",
+            f"  return (const {type_name} *)frame;",
+        ]
+    else:
+        out += [
+            f"  if (length < {macro}_SIZE(0) ||",
+            f"      frame[0] != {macro}_ID) {{",
+            "    return NULL;",
+            "  }",
+            f"  const {type_name} *message = (const {type_name} *)frame;",
+        ]
+        checks = [f"message->{f['name']} > {macro}_MAX_{f['name'].upper()}" for f in bounded]
+        checks.append(f"length != {macro}_SIZE({count_expr})")
+        out.append("  if (" + " ||\n      ".join(checks) + ") {")
+        out += ["    return NULL;", "  }", "  return message;"]
+    out += ["}", ""]
+
+    if tail is None:
+        params = "".join(f", {c_type(f['type'])} {f['name']}" for f in fields)
+        out += [
+            "/**",
+            " * @brief 编码整帧",
+            " *",
+            " * @return 整帧长度",
+            " */",
+            f"static inline uint16_t {func}_pack(uint8_t frame[]{params}) {{",
+            f"  {type_name} *message = ({type_name} *)frame;",
+            f"  message->id = {macro}_ID;",
+        ]
+        if len(out[-3]) > 80:
+            out[-3] = f"static inline uint16_t {func}_pack(\n    uint8_t frame[]{params}) {{"
+        out += [f"  message->{f['name']} = {f['name']};" for f in fields]
+        out += ["  return protocol_seal(frame, sizeof(*message));", "}", ""]
+    else:
+        out += [
+            "/**",
+            " * @brief 写好帧头 之后直接在缓冲中填写字段和tail 最后调用seal",
+            " */",
+            f"static inline {type_name} *{func}_init(uint8_t frame[]) {{",
+            f"  {type_name} *message = ({type_name} *)frame;",
+            f"  message->id = {macro}_ID;",
+            "  return message;",
+            "}",
+            "",
+            "/**",
+            " * @brief 按计数字段确定长度 追加\\r\\n和checksum",
+            " *",
+            " * @return 整帧长度",
+            " */",
+            f"static inline uint16_t {func}_seal(uint8_t frame[]) {{",
+            f"  const {type_name} *message = (const {type_name} *)frame;",
+            f"  uint16_t length = {macro}_SIZE({count_expr});",
+            "  return protocol_seal(frame, length - PROTOCOL_TRAILER_SIZE);",
+            "}",
+            "",
+        ]
+    return out
+
+
+# ---------------------------------------------------------------- Python
+
+def np_type(schema: Schema, type_name: str) -> str:
+    if type_name in SCALARS:
+        return repr(SCALARS[type_name][1])
+    return type_name.upper()
+
+
+def np_fields(schema: Schema, fields: list[dict]) -> str:
+    return ", ".join(f"(\"{f['name']}\", {np_type(schema, f['type'])})" for f in fields)
+
+
+def generate_python(schema: Schema) -> str:
+    out = [
+        "# 由Protocol/generate.py根据Protocol/protocol.json生成 不要手动修改",
+        f"\"\"\"{schema.doc}\"\"\"",
+        "from enum import IntEnum",
+        "",
+        "import numpy as np",
+        "",
+        f"HEADER_SIZE = {HEADER_SIZE}",
+        "TRAILER = b\"\\r\\n\"",
+    ]
+    for name, constant in schema.constants.items():
+        out.append(f"{name} = {constant['value']}  # {constant['doc']}")
+    out.append("")
+
+    for name, enum in schema.enums.items():
+        out += ["", f"class {camel(name)}(IntEnum):", f"    \"\"\"{enum['doc']}\"\"\""]
+        for value_name, value in enum["values"].items():
+            out.append(f"    {value_name.upper()} = {value['value']}  # {value['doc']}")
+        out.append("")
+
+    for name, record in schema.records.items():
+        out += ["", f"# {record['doc']}",
+                f"{name.upper()} = np.dtype([{np_fields(schema, record['fields'])}])"]
+
+    out += [
+        "",
+        "",
+        "def checksum(frame: bytes) -> int:",
+        "    \"\"\"除checksum外所有字节之和取反 checksum字节本身按0计算\"\"\"",
+        "    data = np.frombuffer(frame, dtype=np.uint8)",
+        "    return ~(int(data.sum(dtype=np.uint64)) - int(data[1])) & 0xFF",
+        "",
+        "",
+        "def seal(body: bytes) -> bytes:",
+        "    \"\"\"在body后追加\\r\\n并填写checksum\"\"\"",
+        "    frame = bytearray(body) + TRAILER",
+        "    frame[1] = checksum(frame)",
+        "    return bytes(frame)",
+        "",
+        "",
+        "def is_valid(frame: bytes) -> bool:",
+        "    \"\"\"以\\r\\n结尾 且所有字节之和为0xFF\"\"\"",
+        "    if len(frame) < HEADER_SIZE + len(TRAILER) or not frame.endswith(TRAILER):",
+        "        return False",
+        "    return int(np.frombuffer(frame, dtype=np.uint8).sum(dtype=np.uint8)) == 0xFF",
+        "",
+        "",
+        "class Message:",
+        "    \"\"\"生成的各个帧类型的公共部分\"\"\"",
+        "    ID: int",
+        "    HEADER: np.dtype",
+        "    TAIL: np.dtype | None = None",
+        "    COUNT: tuple[str, ...] = ()",
+        "",
+        "    @classmethod",
+        "    def encode(cls, tail=None, **fields) -> bytes:",
+        "        \"\"\"只有一个计数字段时可以省略 按tail的长度填写\"\"\"",
+        "        header = np.zeros(1, dtype=cls.HEADER)",
+        "        header[\"id\"] = cls.ID",
+        "        if cls.TAIL is not None:",
+        "            if isinstance(tail, (bytes, bytearray)):",
+        "                tail = np.frombuffer(tail, dtype=cls.TAIL)",
+        "            tail = np.asarray(tail if tail is not None else [], dtype=cls.TAIL)",
+        "            if len(cls.COUNT) == 1 and cls.COUNT[0] not in fields:",
+        "                fields[cls.COUNT[0]] = len(tail)",
+        "        for name, value in fields.items():",
+        "            header[name] = value",
+        "        body = header.tobytes()",
+        "        if cls.TAIL is not None:",
+        "            body += tail.tobytes()",
+        "        return seal(body)",
+        "",
+        "    @classmethod",
+        "    def decode(cls, frame: bytes) -> tuple[np.void, np.ndarray | None]:",
+        "        \"\"\"返回帧头字段和tail 两者都是frame上的视图 格式不对时抛出ValueError\"\"\"",
+        "        if not is_valid(frame) or frame[0] != cls.ID or len(frame) < cls.HEADER.itemsize + len(TRAILER):",
+        "            raise ValueError(f\"not a valid {cls.__name__} frame\")",
+        "        header = np.frombuffer(frame, dtype=cls.HEADER, count=1)[0]",
+        "        if cls.TAIL is None:",
+        "            if len(frame) != cls.HEADER.itemsize + len(TRAILER):",
+        "                raise ValueError(f\"bad {cls.__name__} length {len(frame)}\")",
+        "            return header, None",
+        "        count = sum(int(header[name]) for name in cls.COUNT)",
+        "        if len(frame) != cls.HEADER.itemsize + count * cls.TAIL.itemsize + len(TRAILER):",
+        "            raise ValueError(f\"bad {cls.__name__} length {len(frame)}\")",
+        "        return header, np.frombuffer(frame, dtype=cls.TAIL, count=count, offset=cls.HEADER.itemsize)",
+        "",
+        "    @classmethod",
+        "    def decode_many(cls, buffer: bytes) -> np.ndarray:",
+        "        \"\"\"解码首尾相接的多个定长帧 丢弃checksum不对的帧\"\"\"",
+        "        if cls.TAIL is not None:",
+        "            raise TypeError(f\"{cls.__name__} frames are variable length\")",
+        "        size = cls.HEADER.itemsize + len(TRAILER)",
+        "        data = np.frombuffer(buffer, dtype=np.uint8)[: len(buffer) // size * size].reshape(-1, size)",
+        "        valid = (data.sum(axis=1, dtype=np.uint8) == 0xFF) & (data[:, 0] == cls.ID)",
+        "        return data[valid, : cls.HEADER.itemsize].copy().view(cls.HEADER).reshape(-1)",
+    ]
+
+    for link_name, link in schema.links.items():
+        out += ["", "", f"# ---- {link_name}: {link['doc']} ----"]
+        for message in link["messages"]:
+            class_name = camel(f"{link_name}_{message['name']}")
+            header_fields = [{"name": "id", "type": "u8"}, {"name": "checksum", "type": "u8"}] + message["fields"]
+            tail = message.get("tail")
+            out += ["", "", f"class {class_name}(Message):", f"    \"\"\"{message['doc']}\"\"\"",
+                    f"    ID = 0x{message['id']:02X}",
+                    f"    HEADER = np.dtype([{np_fields(schema, header_fields)}])"]
+            if tail is not None:
+                out.append(f"    TAIL = np.dtype({np_type(schema, tail['type'])})")
+                out.append(f"    COUNT = ({', '.join(repr(n) for n in tail['count'])},)")
+    out.append("")
+    return "\n".join(out)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--check", action="store_true", help="生成的文件不是最新时返回1")
+    args = parser.parse_args()
+
+    schema = Schema(json.loads(SCHEMA.read_text(encoding="utf-8")))
+    outputs = {path: generate_c(schema) for path in C_OUTPUTS}
+    outputs[PYTHON_OUTPUT] = generate_python(schema)
+
+    stale = []
+    for path, content in outputs.items():
+        current = path.read_text(encoding="utf-8") if path.exists() else None
+        if current == content:
+            continue
+        stale.append(path)
+        if not args.check:
+            path.parent.mkdir(parents=True, exist_ok=True)
+            path.write_text(content, encoding="utf-8", newline="\n")
+    for path in stale:
+        print(f"{'stale' if args.check else 'wrote'}: {path.relative_to(ROOT)}")
+    return 1 if args.check and stale else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
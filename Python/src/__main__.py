@@ -1,13 +1,14 @@
 import asyncio
 import logging
 import re
-import numpy as np
 from asyncio import CancelledError
 from bleak import BleakClient
 from bleak import BleakScanner
 from bleak import BleakGATTCharacteristic
 from bleak.exc import BleakDeviceNotFoundError
 
+import protocol
+
 
 logger = logging.getLogger(__name__)
 address = "48:87:2D:73:E1:46" # BT24 MAC
@@ -18,15 +19,6 @@ MODEL_NBR_UUID = "2A24"
 
 last_sent_msg = bytearray(0)
 
-def get_checksum(data: bytearray, need_line_end: bool = True) -> np.uint8:
-    checksum = np.uint8(0)
-    for byte in data:
-        checksum += byte
-    if need_line_end:
-        checksum += ord("\r")  # 添加回车符的校验
-        checksum += ord("\n")  # 添加换行符的
-    return ~checksum
-
 def encode_msg(expr: str) -> bytearray:
     """
     解析形如 0x00 0x06 0x01 "HyFran1" 的字符串：
@@ -74,7 +66,15 @@ async def main():
     async with BleakClient(device, disconnected_callback) as client:
         async def handle_notification(sender: BleakGATTCharacteristic, data: bytearray):
             logger.info(f"Notification from {sender}: {data}")
-            msg = data.decode()
+            if data[0] == protocol.PhoneStreamSample.ID:
+                # 订阅模式下的二进制样本 一次通知里可能有多帧
+                for sample in protocol.PhoneStreamSample.decode_many(bytes(data)):
+                    print(f"Sample #{sample['sequence']}: "
+                          f"{sample['temperature_centi'] / 100:.2f}°C "
+                          f"{sample['humidity_centi'] / 100:.2f}%RH "
+                          f"time={sample['timestamp']} coalesced={sample['coalesced']}")
+                return
+            msg = data.decode(errors="replace")
             print(f"Received message: {msg}")
             if msg == "NAK\r\n":
                 await client.write_gatt_char(WRITE_UUID, last_sent_msg)
@@ -89,17 +89,9 @@ async def main():
         while True:
             try:
                 user_input = str(await loop.run_in_executor(None, input, "Enter command: \r\n"))
+                # 输入中不含checksum 第一个字节是命令字 checksum紧跟其后
                 encoded = encode_msg(user_input)
-                checksum_value = get_checksum(encoded)
-                
-                # 0xNN 0xNN 0xNN "string"
-                # 012345
-                tail = (" " + user_input[5:]) if len(user_input) > 6 else None
-                user_input = user_input[:4] + " " + hex(checksum_value)
-                if tail != None:
-                    user_input += tail
-                encoded = encode_msg(user_input)
-                last_sent_msg = encoded + b"\r\n"
+                last_sent_msg = protocol.seal(encoded[:1] + b"\x00" + encoded[1:])
                 await client.write_gatt_char(WRITE_UUID, last_sent_msg)
             except (asyncio.CancelledError, KeyboardInterrupt):
                 logger.info("Disconnecting...")
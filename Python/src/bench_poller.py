@@ -0,0 +1,109 @@
+"""
+逐步增加模拟节点数 测fleet_poller实际达到的轮询速率和延迟分位数
+
+    python bench_poller.py [--counts 100,500,1000,2000] [--duration 20] [--interval 1]
+                           [-- node_farm参数 如 --slow 0.01:300 --blips 0.2:5]
+
+节点由node_farm在子进程中模拟 每个子进程最多--per-farm台 不和轮询器抢同一个核
+"""
+import argparse
+import asyncio
+import sys
+import time
+from pathlib import Path
+
+from fleet_poller import FleetPoller, PollStats, percentile, raise_file_limit
+
+FARM = Path(__file__).with_name("node_farm.py")
+FARM_LAYOUT = ("float32", "hi", "hi")
+
+
+async def start_farms(count: int, per_farm: int, port: int,
+                      farm_args: list[str]) -> list[asyncio.subprocess.Process]:
+    farms = []
+    for first in range(0, count, per_farm):
+        farm = await asyncio.create_subprocess_exec(
+            sys.executable, str(FARM), "--count", str(min(per_farm, count - first)),
+            "--first", str(first), "--port", str(port), "--layout", ",".join(FARM_LAYOUT),
+            *farm_args, stdout=asyncio.subprocess.PIPE)
+        farms.append(farm)
+    for farm in farms:
+        # 所有节点开始监听后子进程打印ready
+        line = await farm.stdout.readline()
+        if not line.startswith(b"ready"):
+            raise RuntimeError("node farm failed to start")
+    return farms
+
+
+async def measure(count: int, args: argparse.Namespace) -> dict:
+    farms = await start_farms(count, args.per_farm, args.port, args.farm_args)
+    poller = FleetPoller(args.interval, lambda *sample: None)
+    try:
+        for index in range(count):
+            poller.add(f"node-{index}", "127.0.0.1", args.port + index, FARM_LAYOUT)
+        # 等连接建立 且每个节点都至少轮询过一轮
+        await asyncio.sleep(args.warmup + args.interval)
+        poller.stats = PollStats()
+        started, cpu_started = time.monotonic(), time.process_time()
+        await asyncio.sleep(args.duration)
+        elapsed = time.monotonic() - started
+        cpu = time.process_time() - cpu_started
+        stats = poller.stats
+        latencies = sorted(stats.latencies)
+        return {
+            "nodes": count,
+            "connected": sum(device.connected for device in poller.devices.values()),
+            "target": count / args.interval,
+            "achieved": stats.polls / elapsed,
+            "p50": percentile(latencies, 0.5) * 1000,
+            "p90": percentile(latencies, 0.9) * 1000,
+            "p99": percentile(latencies, 0.99) * 1000,
+            "max": (latencies[-1] if latencies else 0.0) * 1000,
+            "errors": stats.errors,
+            "overruns": stats.overruns,
+            "cpu": cpu / elapsed * 100,
+        }
+    finally:
+        for name in list(poller.devices):
+            poller.remove(name)
+        for farm in farms:
+            farm.terminate()
+            await farm.wait()
+
+
+async def run(args: argparse.Namespace) -> None:
+    print(f"{'nodes':>6} {'conn':>6} {'target/s':>9} {'achieved/s':>11} "
+          f"{'p50 ms':>7} {'p90 ms':>7} {'p99 ms':>7} {'max ms':>8} "
+          f"{'errors':>7} {'overruns':>9} {'cpu %':>6}")
+    for count in args.counts:
+        row = await measure(count, args)
+        print(f"{row['nodes']:>6} {row['connected']:>6} {row['target']:>9.1f} "
+              f"{row['achieved']:>11.1f} {row['p50']:>7.2f} {row['p90']:>7.2f} "
+              f"{row['p99']:>7.2f} {row['max']:>8.2f} {row['errors']:>7} "
+              f"{row['overruns']:>9} {row['cpu']:>6.1f}", flush=True)
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--counts", default="100,500,1000,2000",
+                        type=lambda text: [int(count) for count in text.split(",")])
+    parser.add_argument("--duration", type=float, default=20.0, help="seconds measured per step")
+    parser.add_argument("--warmup", type=float, default=3.0)
+    parser.add_argument("--interval", type=float, default=1.0, help="seconds between polls")
+    parser.add_argument("--per-farm", type=int, default=1000, help="nodes per farm process")
+    # 节点端口连续分配 放在临时端口范围之下
+    parser.add_argument("--port", type=int, default=20000, help="port of node 0")
+    parser.add_argument("farm_args", nargs=argparse.REMAINDER,
+                        help="passed to node_farm.py after --")
+    args = parser.parse_args()
+    if args.farm_args[:1] == ["--"]:
+        args.farm_args = args.farm_args[1:]
+    return args
+
+
+if __name__ == "__main__":
+    raise_file_limit()
+    try:
+        asyncio.run(run(parse_args()))
+    except KeyboardInterrupt:
+        pass
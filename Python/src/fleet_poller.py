@@ -0,0 +1,370 @@
+"""
+并发轮询所有humidistat节点 每个节点一条长连接和一个协程 一个进程可以1Hz轮询上千个节点
+
+    python fleet_poller.py [--interval 1] [--verbose] [--store DIR] [--trace FILE]
+                           [host[:port] ...]
+
+不给地址时用mDNS发现节点 寄存器格式取自TXT记录
+给了地址时只轮询这些地址 格式用--layout指定
+给了--store时样本写入sample_store 装了uvloop时自动使用
+给了--trace时每轮再读一次追踪寄存器 记录交给trace_report分析
+"""
+import argparse
+import asyncio
+import random
+import resource
+import struct
+import time
+from dataclasses import dataclass, field
+from typing import Callable, Optional
+
+import register_map
+from sample_store import SampleStore
+from trace_report import TraceLog
+
+SERVICE_TYPE = "_modbus._tcp.local."
+SERVICE_PREFIX = "humidistat-"
+MODBUS_PORT = 502
+UNIT_ID = 1
+CONNECT_TIMEOUT_S = 3.0
+REQUEST_TIMEOUT_S = 2.0
+# 每轮间隔在±10%内随机 避免所有节点的请求对齐成一个个尖峰
+INTERVAL_JITTER = 0.1
+BACKOFF_MIN_S = 1.0
+BACKOFF_MAX_S = 60.0
+# 同时进行的TCP握手数 重启后上千个节点同时重连时不会挤爆accept队列
+MAX_CONNECTING = 64
+# 连接后写一次时间 之后每小时写一次 设备报告时间为0时马上重写
+EPOCH_REFRESH_S = 3600.0
+REPORT_INTERVAL_S = 10.0
+# 硬限制为无限时把软限制提到这么多
+FILE_LIMIT_TARGET = 65536
+
+# (name, humidity, temperature, timestamp)
+SampleCallback = Callable[[str, float, float, int], None]
+# (name, 收到时的Unix时间, 读追踪寄存器的往返时间 秒, TRACE_FIELDS对应的值)
+TraceCallback = Callable[[str, float, float, tuple[int, ...]], None]
+
+
+class ModbusError(Exception):
+    pass
+
+
+class ModbusConnection:
+    """
+    只实现04和16 一次一个请求 不用pymodbus 每个请求只有一次write和两次readexactly
+    """
+
+    def __init__(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter):
+        self.reader = reader
+        self.writer = writer
+        self.transaction = 0
+
+    async def request(self, pdu: bytes) -> bytes:
+        self.transaction = (self.transaction + 1) & 0xFFFF
+        self.writer.write(struct.pack(">HHHB", self.transaction, 0, len(pdu) + 1, UNIT_ID) + pdu)
+        header = await self.reader.readexactly(7)
+        transaction, _, length, _ = struct.unpack(">HHHB", header)
+        if length < 2:
+            raise ModbusError(f"bad MBAP length {length}")
+        response = await self.reader.readexactly(length - 1)
+        if transaction != self.transaction:
+            raise ModbusError(f"transaction {transaction} != {self.transaction}")
+        if response[0] & 0x80:
+            raise ModbusError(f"function {response[0] & 0x7F:#04x} exception {response[1]}")
+        return response
+
+    async def read_input_registers(self, address: int, count: int) -> tuple[int, ...]:
+        response = await self.request(struct.pack(">BHH", 0x04, address, count))
+        if response[1] != count * 2:
+            raise ModbusError(f"expected {count} registers, got {response[1] // 2}")
+        return struct.unpack(f">{count}H", response[2:])
+
+    async def write_registers(self, address: int, values: list[int]) -> None:
+        await self.request(struct.pack(f">BHHB{len(values)}H", 0x10, address, len(values),
+                                       len(values) * 2, *values))
+
+    def close(self) -> None:
+        self.writer.close()
+
+
+@dataclass
+class Device:
+    name: str
+    host: str
+    port: int
+    layout: tuple[str, str, str] = register_map.LEGACY_LAYOUT
+    # 追踪寄存器的地址 固件不支持时为None
+    trace_address: Optional[int] = None
+    # 上次交出的样本 设备没换样本时不再重复交出
+    last_sample: Optional[tuple] = None
+    connected: bool = False
+    backoff: float = BACKOFF_MIN_S
+    task: Optional[asyncio.Task] = None
+
+
+@dataclass
+class PollStats:
+    polls: int = 0
+    errors: int = 0
+    reconnects: int = 0
+    # 一轮请求比间隔还长 排期只能往后推
+    overruns: int = 0
+    latencies: list[float] = field(default_factory=list)
+
+
+def percentile(sorted_values: list[float], fraction: float) -> float:
+    if not sorted_values:
+        return 0.0
+    return sorted_values[min(len(sorted_values) - 1, int(len(sorted_values) * fraction))]
+
+
+class FleetPoller:
+
+    def __init__(self, interval: float, on_sample: SampleCallback,
+                 on_trace: Optional[TraceCallback] = None):
+        self.interval = interval
+        self.on_sample = on_sample
+        self.on_trace = on_trace
+        self.devices: dict[str, Device] = {}
+        self.stats = PollStats()
+        self.connecting = asyncio.Semaphore(MAX_CONNECTING)
+
+    def add(self, name: str, host: str, port: int, layout: tuple[str, str, str],
+            trace_address: Optional[int] = None) -> None:
+        """新节点开始轮询 地址变化时重连 只有格式变化时下一轮生效"""
+        device = self.devices.get(name)
+        if device is not None and (device.host, device.port) == (host, port):
+            device.layout = layout
+            device.trace_address = trace_address
+            return
+        self.remove(name)
+        device = Device(name, host, port, layout, trace_address)
+        device.task = asyncio.create_task(self.run_device(device))
+        self.devices[name] = device
+
+    def remove(self, name: str) -> None:
+        device = self.devices.pop(name, None)
+        if device is not None and device.task is not None:
+            device.task.cancel()
+
+    async def run_device(self, device: Device) -> None:
+        # 第一次轮询在一个间隔内均匀错开
+        await asyncio.sleep(random.uniform(0, self.interval))
+        while True:
+            try:
+                async with self.connecting:
+                    reader, writer = await asyncio.wait_for(
+                        asyncio.open_connection(device.host, device.port), CONNECT_TIMEOUT_S)
+            except (OSError, asyncio.TimeoutError):
+                self.stats.errors += 1
+                await self.back_off(device)
+                continue
+            connection = ModbusConnection(reader, writer)
+            device.connected = True
+            try:
+                await self.poll_loop(device, connection)
+            except (OSError, asyncio.IncompleteReadError, asyncio.TimeoutError, ModbusError) as e:
+                self.stats.errors += 1
+                self.stats.reconnects += 1
+                print(f"{device.name}: {e!r}, reconnecting")
+            finally:
+                device.connected = False
+                connection.close()
+            await self.back_off(device)
+
+    async def back_off(self, device: Device) -> None:
+        """指数退避 在[0, backoff]内随机 掉电后恢复的一批节点不会同时重连"""
+        await asyncio.sleep(random.uniform(0, device.backoff))
+        device.backoff = min(device.backoff * 2, BACKOFF_MAX_S)
+
+    async def poll_loop(self, device: Device, connection: ModbusConnection) -> None:
+        loop = asyncio.get_running_loop()
+        epoch_due = 0.0
+        next_poll = loop.time()
+        while True:
+            fmt, input_order, holding_order = device.layout
+            started = loop.time()
+            if started >= epoch_due:
+                await asyncio.wait_for(connection.write_registers(
+                    register_map.HOLDING_EPOCH_ADDRESS,
+                    register_map.u32_to_words(int(time.time()), holding_order)),
+                    REQUEST_TIMEOUT_S)
+                epoch_due = started + EPOCH_REFRESH_S
+                started = loop.time()
+            registers = await asyncio.wait_for(connection.read_input_registers(
+                0, register_map.INPUT_REGISTER_COUNTS[fmt]), REQUEST_TIMEOUT_S)
+            self.stats.latencies.append(loop.time() - started)
+            self.stats.polls += 1
+            device.backoff = BACKOFF_MIN_S
+            humidity, temperature, timestamp = register_map.decode_inputs(
+                list(registers), fmt, input_order)
+            if timestamp == 0:
+                # 设备重启后没有时间
+                epoch_due = 0.0
+            # 有时间戳时按时间戳区分样本 没有时只能按寄存器原值
+            sample = (timestamp,) if timestamp else tuple(registers)
+            if sample != device.last_sample:
+                device.last_sample = sample
+                self.on_sample(device.name, humidity, temperature, timestamp)
+            if self.on_trace is not None and device.trace_address is not None:
+                await self.read_trace(device, connection)
+
+            # 按绝对时间排期 请求耗时不会累积成漂移
+            next_poll += self.interval * (1 + random.uniform(-INTERVAL_JITTER, INTERVAL_JITTER))
+            delay = next_poll - loop.time()
+            if delay < 0:
+                self.stats.overruns += 1
+                next_poll = loop.time()
+                delay = 0
+            await asyncio.sleep(delay)
+
+    async def read_trace(self, device: Device, connection: ModbusConnection) -> None:
+        """
+        和样本分开读 两次读之间可能换了样本 对统计影响很小
+        age_us在设备上填到读请求时刻 回程的时间按往返时间的一半估计
+        """
+        loop = asyncio.get_running_loop()
+        started = loop.time()
+        try:
+            registers = await asyncio.wait_for(connection.read_input_registers(
+                device.trace_address, register_map.TRACE_REGISTER_COUNT), REQUEST_TIMEOUT_S)
+        except ModbusError as e:
+            # 命令行给出的节点可能是不支持追踪的旧固件
+            print(f"{device.name}: {e}, tracing disabled")
+            device.trace_address = None
+            return
+        round_trip = loop.time() - started
+        trace = register_map.decode_trace(list(registers))
+        if trace[0] != 0:
+            self.on_trace(device.name, time.time(), round_trip, trace)
+
+    async def report(self, period: float = REPORT_INTERVAL_S) -> None:
+        while True:
+            await asyncio.sleep(period)
+            stats, self.stats = self.stats, PollStats()
+            latencies = sorted(stats.latencies)
+            connected = sum(device.connected for device in self.devices.values())
+            print(f"{connected}/{len(self.devices)} connected, "
+                  f"{stats.polls / period:.1f} polls/s, "
+                  f"latency p50 {percentile(latencies, 0.5) * 1000:.1f} ms "
+                  f"p99 {percentile(latencies, 0.99) * 1000:.1f} ms, "
+                  f"{stats.errors} errors, {stats.reconnects} reconnects, "
+                  f"{stats.overruns} overruns")
+
+
+async def discover(poller: FleetPoller) -> None:
+    from zeroconf import IPVersion, ServiceStateChange
+    from zeroconf.asyncio import AsyncServiceBrowser, AsyncServiceInfo, AsyncZeroconf
+
+    resolving: set[asyncio.Task] = set()
+
+    async def resolve(zc, type_: str, name: str) -> None:
+        info = AsyncServiceInfo(type_, name)
+        if not await info.async_request(zc, 3000):
+            return
+        addresses = info.parsed_addresses(IPVersion.V4Only)
+        if not addresses:
+            return
+        txt = {key.decode(): (value or b"").decode()
+               for key, value in info.properties.items()}
+        poller.add(name, addresses[0], info.port or MODBUS_PORT, register_map.parse_layout(txt),
+                   register_map.parse_trace_address(txt))
+
+    def on_change(zeroconf, service_type: str, name: str,
+                  state_change: ServiceStateChange) -> None:
+        if not name.startswith(SERVICE_PREFIX):
+            return
+        if state_change is ServiceStateChange.Removed:
+            poller.remove(name)
+            return
+        # IP变化后设备会重新通告
+        task = asyncio.ensure_future(resolve(zeroconf, service_type, name))
+        resolving.add(task)
+        task.add_done_callback(resolving.discard)
+
+    aiozc = AsyncZeroconf(ip_version=IPVersion.V4Only)
+    browser = AsyncServiceBrowser(aiozc.zeroconf, SERVICE_TYPE, handlers=[on_change])
+    try:
+        await asyncio.Event().wait()
+    finally:
+        await browser.async_cancel()
+        await aiozc.async_close()
+
+
+def print_sample(name: str, humidity: float, temperature: float, timestamp: int) -> None:
+    sampled_at = time.strftime("%Y-%m-%d %H:%M:%S",
+                               time.localtime(timestamp)) if timestamp else "unsynced"
+    print(f"{name}: Temperature: {temperature:.2f}, Humidity: {humidity:.2f}, "
+          f"Sampled at: {sampled_at}")
+
+
+def raise_file_limit() -> None:
+    """每个节点占一个文件描述符 默认的1024不够"""
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    # 硬限制为无限时不能直接用作软限制 内核还有自己的上限 设置失败就保持原样
+    target = FILE_LIMIT_TARGET if hard == resource.RLIM_INFINITY else hard
+    if soft != resource.RLIM_INFINITY and soft < target:
+        try:
+            resource.setrlimit(resource.RLIMIT_NOFILE, (target, hard))
+        except (ValueError, OSError):
+            pass
+
+
+async def run(args: argparse.Namespace) -> None:
+    store = SampleStore(args.store) if args.store else None
+    trace_log = TraceLog(args.trace) if args.trace else None
+
+    def on_sample(name: str, humidity: float, temperature: float, timestamp: int) -> None:
+        if args.verbose:
+            print_sample(name, humidity, temperature, timestamp)
+        if store is not None:
+            # 设备没有时间时按收到的时间存
+            store.append(name, timestamp or int(time.time()), temperature, humidity)
+
+    poller = FleetPoller(args.interval, on_sample,
+                         trace_log.write if trace_log is not None else None)
+    for target in args.hosts:
+        host, _, port = target.partition(":")
+        poller.add(target, host, int(port or MODBUS_PORT), args.layout,
+                   register_map.DEFAULT_TRACE_ADDRESS)
+    try:
+        await asyncio.gather(poller.report(),
+                             *([] if args.hosts else [discover(poller)]))
+    finally:
+        if store is not None:
+            store.close()
+        if trace_log is not None:
+            trace_log.close()
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("hosts", nargs="*", help="host[:port], mDNS discovery if omitted")
+    parser.add_argument("--interval", type=float, default=1.0, help="seconds between polls")
+    parser.add_argument("--layout", default=",".join(register_map.DEFAULT_LAYOUT),
+                        help="format,input order,holding order for hosts given "
+                             "on the command line, float32,lo,lo for firmware "
+                             "1.1.0 and older")
+    parser.add_argument("--verbose", action="store_true", help="print every sample")
+    parser.add_argument("--store", metavar="DIR", help="append samples to a sample store")
+    parser.add_argument("--trace", metavar="FILE",
+                        help="append trace records to a CSV file for trace_report.py")
+    args = parser.parse_args()
+    args.layout = tuple(args.layout.split(","))
+    if len(args.layout) != 3 or args.layout[0] not in register_map.INPUT_REGISTER_COUNTS:
+        parser.error(f"bad layout {','.join(args.layout)}")
+    return args
+
+
+if __name__ == "__main__":
+    raise_file_limit()
+    try:
+        import uvloop
+        runner = uvloop.run
+    except ImportError:
+        runner = asyncio.run
+    try:
+        runner(run(parse_args()))
+    except KeyboardInterrupt:
+        pass
@@ -2,7 +2,19 @@ from zeroconf import ServiceBrowser, ServiceListener, Zeroconf, IPVersion
 from pymodbus.pdu import ModbusPDU
 from pymodbus.client import ModbusTcpClient
 import time
-esp01s_address = None
+
+from register_map import (HOLDING_EPOCH_ADDRESS, INPUT_REGISTER_COUNTS, LEGACY_LAYOUT,
+                          decode_inputs, parse_layout, u32_to_words)
+
+# 每台设备的服务名为 humidistat-<MAC>._modbus._tcp.local.
+SERVICE_PREFIX = "humidistat-"
+# 服务名 -> IPv4地址 mDNS重新通告新地址时覆盖
+esp01s_addresses: dict[str, str] = {}
+# 服务名 -> (地址, 连接) 轮询之间保持打开 不必每次重新握手 也不占满设备的连接数
+modbus_clients: dict[str, tuple[str, ModbusTcpClient]] = {}
+
+# 服务名 -> (输入格式, 输入字序, 保持字序)
+device_layouts: dict[str, tuple[str, str, str]] = {}
 
 def read_input_registers(client: ModbusTcpClient, address: int, count: int) -> list[int]:
     try:
@@ -17,34 +29,78 @@ def read_input_registers(client: ModbusTcpClient, address: int, count: int) -> l
         print(f"Exception occurred: {e}")
         return [None, None]
 
+def write_epoch(client: ModbusTcpClient, order: str) -> None:
+    epoch = int(time.time())
+    try:
+        response = client.write_registers(HOLDING_EPOCH_ADDRESS,
+                                          u32_to_words(epoch, order))
+        if response.isError():
+            print(f"Error writing epoch: {response}")
+    except Exception as e:
+        print(f"Exception occurred: {e}")
+
 def main() -> None:
     while True:
-        client = ModbusTcpClient(esp01s_address)
-        client.connect()
-        temperature = float()
-        humidity = float()
-        temperature, humidity = read_input_registers(client, 0, 2)
-        print(f"Temperature: {temperature}, Humidity: {humidity}")
-        client.close()
+        for name, address in list(esp01s_addresses.items()):
+            poll_device(name, address)
         time.sleep(2)
-    
+
+def get_client(name: str, address: str) -> ModbusTcpClient:
+    cached = modbus_clients.get(name)
+    if cached is not None and cached[0] != address:
+        cached[1].close()
+        cached = None
+    if cached is None:
+        cached = (address, ModbusTcpClient(address))
+        modbus_clients[name] = cached
+    client = cached[1]
+    # 设备重启或因空闲关闭了连接时重新连接
+    if not client.connected:
+        client.connect()
+    return client
+
+def poll_device(name: str, address: str) -> None:
+    client = get_client(name, address)
+    fmt, input_order, holding_order = device_layouts.get(name, LEGACY_LAYOUT)
+    write_epoch(client, holding_order)
+    count = INPUT_REGISTER_COUNTS[fmt]
+    registers = read_input_registers(client, 0, count)
+    if None not in registers and len(registers) == count:
+        humidity, temperature, timestamp = decode_inputs(registers, fmt, input_order)
+        sampled_at = time.strftime("%Y-%m-%d %H:%M:%S",
+                                   time.localtime(timestamp)) if timestamp else "unsynced"
+        print(f"{name}: Temperature: {temperature:.2f}, Humidity: {humidity:.2f}, "
+              f"Sampled at: {sampled_at}")
+
 
 class MyListener(ServiceListener):
 
     def update_service(self, zc: Zeroconf, type_: str, name: str) -> None:
-        #print(f"Service {name} updated")
-        return
+        # IP变化后设备会重新通告
+        self.add_service(zc, type_, name)
 
     def remove_service(self, zc: Zeroconf, type_: str, name: str) -> None:
-        #print(f"Service {name} removed")
-        return
+        esp01s_addresses.pop(name, None)
+        device_layouts.pop(name, None)
+        cached = modbus_clients.pop(name, None)
+        if cached is not None:
+            cached[1].close()
 
     def add_service(self, zc: Zeroconf, type_: str, name: str) -> None:
+        if not name.startswith(SERVICE_PREFIX):
+            return
         info = zc.get_service_info(type_, name)
-        # 获取esp8266的类型和名称
-        if name == "humidistat-esp8266._modbus._tcp.local.":
-            global esp01s_address
-            esp01s_address = info.parsed_addresses(IPVersion.V4Only)[0]
+        if info is None:
+            return
+        addresses = info.parsed_addresses(IPVersion.V4Only)
+        if not addresses:
+            return
+        esp01s_addresses[name] = addresses[0]
+        txt = {key.decode(): (value or b"").decode()
+               for key, value in info.properties.items()}
+        device_layouts[name] = parse_layout(txt)
+        print(f"Found {name} at {addresses[0]}: firmware {txt.get('fw')}, "
+              f"capabilities {txt.get('caps')}, {txt.get('seq')} samples")
 
 
 
@@ -52,7 +108,7 @@ zeroconf = Zeroconf()
 listener = MyListener()
 browser = ServiceBrowser(zeroconf, "_modbus._tcp.local.", listener)
 try:
-    while esp01s_address is None:
+    while not esp01s_addresses:
         time.sleep(1)
     main()
 finally:
@@ -0,0 +1,353 @@
+"""
+在本机模拟N台humidistat节点 没有硬件时用来压测fleet_poller
+
+    python node_farm.py --count 1000 [--port 1502] [--mdns] [--trajectory sine]
+                        [--slow 0.01:300] [--disconnects 0.5] [--blips 0.2:5]
+
+第i台节点监听127.0.0.1上的port+i 与ESP01S的快速从站相同 支持03 04 06 16
+追踪寄存器中STM32和ESP01S上的各段时间是按典型值随机生成的 age_us在读时计算
+最多4个连接 满了关闭最久没有请求的连接 10秒没有请求的连接被关闭
+--mdns时像start_mdns_service()一样为每台节点通告 humidistat-<MAC>._modbus._tcp.local.
+
+故障:
+    --slow P:MS        每个请求以概率P晚MS毫秒回复
+    --disconnects R    每台节点平均每分钟R次断开所有连接
+    --blips R:S        每台节点平均每分钟R次AP闪断 S秒内不回复 之后处理积压的请求
+"""
+import argparse
+import asyncio
+import math
+import random
+import socket
+import struct
+import time
+from collections import OrderedDict
+from dataclasses import dataclass
+from typing import Optional
+
+import register_map
+from fleet_poller import raise_file_limit
+
+# 与sdkconfig中的CONFIG_MODBUS_FAST_SLAVE_MAX_CLIENTS和IDLE_TIMEOUT_S相同
+MAX_CLIENTS = 4
+IDLE_TIMEOUT_S = 10.0
+HOLDING_REGISTER_COUNT = 2
+MB_REGISTER_MAX_READ = 125
+MB_REGISTER_MAX_WRITE = 123
+MB_EXCEPTION_ILLEGAL_FUNCTION = 0x01
+MB_EXCEPTION_ILLEGAL_DATA_ADDRESS = 0x02
+MB_EXCEPTION_ILLEGAL_DATA_VALUE = 0x03
+SERVICE_TYPE = "_modbus._tcp.local."
+FIRMWARE_VERSION = "1.3.0"
+# AHT20转换约80ms 带追踪的样本帧26字节加10个字节时间的接收超时 115200下约3.1ms
+CONVERSION_US = (80000, 82000)
+WIRE_US = 3125
+# STM32主循环调度和ESP01S串口任务被唤醒的时间
+STM32_QUEUE_US = (0, 1000)
+ESP_QUEUE_US = (50, 500)
+
+
+@dataclass
+class Faults:
+    slow_probability: float = 0.0
+    slow_s: float = 0.0
+    # 每台节点每秒发生的概率
+    disconnect_rate: float = 0.0
+    blip_rate: float = 0.0
+    blip_s: float = 0.0
+
+
+class Trajectory:
+    """每台节点的基准值和相位随机 walk按每个样本最多0.05变化"""
+
+    def __init__(self, kind: str, period: float):
+        self.kind = kind
+        self.period = period
+        self.temperature = random.uniform(18, 26)
+        self.humidity = random.uniform(40, 60)
+        self.phase = random.uniform(0, 2 * math.pi)
+
+    def sample(self, now: float) -> tuple[float, float]:
+        """返回 (temperature, humidity)"""
+        if self.kind == "sine":
+            wave = math.sin(2 * math.pi * now / self.period + self.phase)
+            return self.temperature + 2 * wave, self.humidity - 5 * wave
+        if self.kind == "walk":
+            self.temperature = min(max(self.temperature + random.randint(-5, 5) / 100, -40), 85)
+            self.humidity = min(max(self.humidity + random.randint(-5, 5) / 100, 0), 100)
+        return self.temperature, self.humidity
+
+
+class ModbusSession(asyncio.Protocol):
+
+    def __init__(self, node: "VirtualNode"):
+        self.node = node
+        self.transport: Optional[asyncio.Transport] = None
+        self.buffer = bytearray()
+        self.last_request = time.monotonic()
+        # 慢回复按顺序发出 后面的请求不会抢在前面
+        self.ready_at = 0.0
+
+    def connection_made(self, transport: asyncio.Transport) -> None:
+        self.transport = transport
+        self.node.accept(self)
+
+    def connection_lost(self, exc: Optional[Exception]) -> None:
+        self.node.sessions.pop(self, None)
+
+    def data_received(self, data: bytes) -> None:
+        self.buffer += data
+        if self.node.online:
+            self.process()
+
+    def process(self) -> None:
+        while len(self.buffer) >= 7 and not self.transport.is_closing():
+            transaction, protocol, length, unit = struct.unpack_from(">HHHB", self.buffer)
+            if length < 2 or length > 254:
+                self.transport.close()
+                return
+            if len(self.buffer) < 6 + length:
+                return
+            pdu = bytes(self.buffer[7:6 + length])
+            del self.buffer[:6 + length]
+            self.last_request = time.monotonic()
+            self.node.sessions.move_to_end(self)
+            response = self.node.handle_pdu(pdu)
+            self.send(struct.pack(">HHHB", transaction, protocol, len(response) + 1, unit) + response)
+
+    def send(self, adu: bytes) -> None:
+        faults = self.node.faults
+        now = time.monotonic()
+        delay = faults.slow_s if random.random() < faults.slow_probability else 0.0
+        self.ready_at = max(self.ready_at, now + delay)
+        if self.ready_at <= now:
+            self.transport.write(adu)
+        else:
+            asyncio.get_running_loop().call_at(
+                asyncio.get_running_loop().time() + self.ready_at - now, self.write_later, adu)
+
+    def write_later(self, adu: bytes) -> None:
+        if not self.transport.is_closing():
+            self.transport.write(adu)
+
+
+class VirtualNode:
+
+    def __init__(self, index: int, port: int, layout: tuple[str, str, str],
+                 trajectory: Trajectory, faults: Faults):
+        self.index = index
+        self.port = port
+        self.layout = layout
+        self.trajectory = trajectory
+        self.faults = faults
+        # 本地管理的MAC 02:48:54:xx:xx:xx
+        self.mac = bytes([0x02, 0x48, 0x54]) + index.to_bytes(3, "big")
+        self.hostname = "humidistat-" + self.mac.hex().upper()
+        self.input_registers = [0] * register_map.INPUT_REGISTER_COUNTS[layout[0]]
+        self.holding_registers = [0] * HOLDING_REGISTER_COUNT
+        # TRACE_FIELDS中除age_us外的值 和写入时的monotonic时间
+        self.trace = (0, 0, 0, 0)
+        self.trace_updated = time.monotonic()
+        self.is_synced = False
+        self.online = True
+        self.sequence = 0
+        # 按最近一次请求排序 最前面的最久没有请求
+        self.sessions: OrderedDict[ModbusSession, None] = OrderedDict()
+        self.server: Optional[asyncio.Server] = None
+
+    async def start(self) -> None:
+        loop = asyncio.get_running_loop()
+        self.server = await loop.create_server(lambda: ModbusSession(self), "127.0.0.1",
+                                               self.port, backlog=MAX_CLIENTS)
+
+    def accept(self, session: ModbusSession) -> None:
+        if len(self.sessions) >= MAX_CLIENTS:
+            oldest = next(iter(self.sessions))
+            oldest.transport.close()
+            self.sessions.pop(oldest)
+        self.sessions[session] = None
+
+    def sample(self, now: float) -> None:
+        temperature, humidity = self.trajectory.sample(now)
+        # STM32拿到主站写入的时间之前样本时间为0
+        timestamp = int(now) if self.is_synced else 0
+        fmt, input_order, _ = self.layout
+        self.input_registers = register_map.encode_inputs(humidity, temperature, timestamp,
+                                                          fmt, input_order)
+        self.sequence += 1
+        # 和STM32一样跳过0
+        self.trace = (self.sequence % 0xFFFF + 1, random.randint(*CONVERSION_US),
+                      random.randint(*STM32_QUEUE_US) + WIRE_US, random.randint(*ESP_QUEUE_US))
+        self.trace_updated = time.monotonic()
+
+    def trace_registers(self) -> list[int]:
+        age_us = round((time.monotonic() - self.trace_updated) * 1e6)
+        return register_map.encode_trace(self.trace + (age_us,))
+
+    def disconnect(self) -> None:
+        for session in list(self.sessions):
+            session.transport.close()
+        self.sessions.clear()
+
+    def close_idle(self, now: float) -> None:
+        for session in list(self.sessions):
+            if now - session.last_request < IDLE_TIMEOUT_S:
+                break
+            session.transport.close()
+            self.sessions.pop(session)
+
+    async def blip(self, seconds: float) -> None:
+        """Wi-Fi断开又连上且IP不变 连接还在 TCP层缓存着请求 恢复后一起处理"""
+        self.online = False
+        await asyncio.sleep(seconds)
+        self.online = True
+        for session in list(self.sessions):
+            session.process()
+
+    def handle_pdu(self, pdu: bytes) -> bytes:
+        function = pdu[0]
+        address, count = struct.unpack_from(">HH", pdu, 1) if len(pdu) >= 5 else (0, 0)
+        exception = 0
+        if function in (0x03, 0x04):
+            registers = self.holding_registers if function == 0x03 else self.input_registers
+            if function == 0x04 and address >= register_map.DEFAULT_TRACE_ADDRESS:
+                registers = self.trace_registers()
+                address -= register_map.DEFAULT_TRACE_ADDRESS
+            if len(pdu) != 5 or count == 0 or count > MB_REGISTER_MAX_READ:
+                exception = MB_EXCEPTION_ILLEGAL_DATA_VALUE
+            elif address + count > len(registers):
+                exception = MB_EXCEPTION_ILLEGAL_DATA_ADDRESS
+            else:
+                return struct.pack(f">BB{count}H", function, count * 2,
+                                   *registers[address:address + count])
+        elif function in (0x06, 0x10):
+            if function == 0x06:
+                count = 1
+                valid = len(pdu) == 5
+                values = [struct.unpack_from(">H", pdu, 3)[0]] if valid else []
+            else:
+                valid = (len(pdu) >= 6 and 0 < count <= MB_REGISTER_MAX_WRITE and
+                         pdu[5] == count * 2 and len(pdu) == 6 + count * 2)
+                values = list(struct.unpack_from(f">{count}H", pdu, 6)) if valid else []
+            if not valid:
+                exception = MB_EXCEPTION_ILLEGAL_DATA_VALUE
+            elif address + count > HOLDING_REGISTER_COUNT:
+                exception = MB_EXCEPTION_ILLEGAL_DATA_ADDRESS
+            else:
+                self.holding_registers[address:address + count] = values
+                self.apply_time_from_master()
+                return pdu[:5]
+        else:
+            exception = MB_EXCEPTION_ILLEGAL_FUNCTION
+        return bytes([function | 0x80, exception])
+
+    def apply_time_from_master(self) -> None:
+        epoch = register_map.words_to_u32(self.holding_registers, self.layout[2])
+        if epoch != 0:
+            self.is_synced = True
+
+    def service_info(self):
+        from zeroconf import ServiceInfo
+        return ServiceInfo(
+            SERVICE_TYPE, f"{self.hostname}.{SERVICE_TYPE}",
+            addresses=[socket.inet_aton("127.0.0.1")], port=self.port,
+            server=f"{self.hostname}.local.",
+            properties={
+                "board": "simulator",
+                "fw": FIRMWARE_VERSION,
+                "caps": "modbus,time,trace",
+                "in": f"{self.layout[0]},{self.layout[1]}",
+                "hold": self.layout[2],
+                "trace": str(register_map.DEFAULT_TRACE_ADDRESS),
+                "seq": str(self.sequence),
+                "mac": self.mac.hex().upper(),
+                "mb_id": f"{self.index & 0xFF:02X}",
+            })
+
+
+async def run_faults(nodes: list[VirtualNode], faults: Faults) -> None:
+    """每秒对每台节点掷一次骰子 同时关闭空闲连接"""
+    blips: set[asyncio.Task] = set()
+    while True:
+        await asyncio.sleep(1)
+        now = time.monotonic()
+        for node in nodes:
+            node.close_idle(now)
+            if not node.online:
+                continue
+            if random.random() < faults.disconnect_rate:
+                node.disconnect()
+            if random.random() < faults.blip_rate:
+                task = asyncio.create_task(node.blip(faults.blip_s))
+                blips.add(task)
+                task.add_done_callback(blips.discard)
+
+
+async def run_samples(nodes: list[VirtualNode], period: float) -> None:
+    while True:
+        now = time.time()
+        for node in nodes:
+            node.sample(now)
+        await asyncio.sleep(period - time.time() % period)
+
+
+async def run(args: argparse.Namespace) -> None:
+    nodes = [VirtualNode(args.first + i, args.port + args.first + i, args.layout,
+                         Trajectory(args.trajectory, args.period), args.faults)
+             for i in range(args.count)]
+    for node in nodes:
+        node.sample(time.time())
+        await node.start()
+
+    zeroconf = None
+    if args.mdns:
+        from zeroconf.asyncio import AsyncZeroconf
+        zeroconf = AsyncZeroconf()
+        await asyncio.gather(*(zeroconf.async_register_service(node.service_info())
+                               for node in nodes))
+    print(f"ready: {args.count} nodes on ports {nodes[0].port}-{nodes[-1].port}", flush=True)
+    try:
+        await asyncio.gather(run_samples(nodes, args.sample_period),
+                             run_faults(nodes, args.faults))
+    finally:
+        if zeroconf is not None:
+            await zeroconf.async_unregister_all_services()
+            await zeroconf.async_close()
+
+
+def parse_pair(text: str) -> tuple[float, float]:
+    first, _, second = text.partition(":")
+    return float(first), float(second)
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--count", type=int, default=100)
+    parser.add_argument("--first", type=int, default=0,
+                        help="index of the first node, to split a farm across processes")
+    parser.add_argument("--port", type=int, default=1502, help="port of node 0")
+    parser.add_argument("--layout", default="float32,hi,hi",
+                        help="format,input order,holding order")
+    parser.add_argument("--trajectory", choices=("constant", "sine", "walk"), default="sine")
+    parser.add_argument("--period", type=float, default=600.0, help="sine period in seconds")
+    parser.add_argument("--sample-period", type=float, default=1.0)
+    parser.add_argument("--mdns", action="store_true", help="advertise every node over mDNS")
+    parser.add_argument("--slow", type=parse_pair, default=(0.0, 0.0), metavar="P:MS")
+    parser.add_argument("--disconnects", type=float, default=0.0, metavar="PER_MINUTE")
+    parser.add_argument("--blips", type=parse_pair, default=(0.0, 0.0), metavar="PER_MINUTE:S")
+    args = parser.parse_args()
+    args.layout = tuple(args.layout.split(","))
+    if len(args.layout) != 3 or args.layout[0] not in register_map.INPUT_REGISTER_COUNTS:
+        parser.error(f"bad layout {','.join(args.layout)}")
+    args.faults = Faults(slow_probability=args.slow[0], slow_s=args.slow[1] / 1000,
+                         disconnect_rate=args.disconnects / 60,
+                         blip_rate=args.blips[0] / 60, blip_s=args.blips[1])
+    return args
+
+
+if __name__ == "__main__":
+    raise_file_limit()
+    try:
+        asyncio.run(run(parse_args()))
+    except KeyboardInterrupt:
+        pass
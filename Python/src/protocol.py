@@ -0,0 +1,210 @@
+# 由Protocol/generate.py根据Protocol/protocol.json生成 不要手动修改
+"""手机(蓝牙) STM32 ESP01S之间的帧格式 所有帧为 id checksum 字段... \r\n 多字节字段为小端"""
+from enum import IntEnum
+
+import numpy as np
+
+HEADER_SIZE = 2
+TRAILER = b"\r\n"
+MAX_FRAME_SIZE = 101  # STM32的MsgBuffer按它分配 最长的WIFI配置帧正好装下
+SSID_MAX_LENGTH = 32  # 802.11规定SSID最长32字节
+PASSWORD_MAX_LENGTH = 63  # WPA2口令最长63字节
+HUMIDITY_CENTI_MAX = 10000  # humidity_centi的上限 flash日志也用它判断记录是否写完
+
+
+class CalibrationOp(IntEnum):
+    """修正表命令的操作"""
+    BEGIN = 0  # 清空暂存表
+    WRITE = 1  # 写入暂存表中的一段点
+    COMMIT = 2  # 写入flash并生效
+    CLEAR = 3  # 擦除修正表
+
+
+class CalibrationTable(IntEnum):
+    """修正表中的子表"""
+    TEMPERATURE = 0  # 只随温度变化的温度修正量
+    HUMIDITY = 1  # 随温度和湿度变化的湿度修正量
+
+
+# flash中缓存的一条样本
+SAMPLE_RECORD = np.dtype([("sequence", '<u2'), ("temperature_centi", '<i2'), ("humidity_centi", '<u2'), ("timestamp", '<u4')])
+
+
+def checksum(frame: bytes) -> int:
+    """除checksum外所有字节之和取反 checksum字节本身按0计算"""
+    data = np.frombuffer(frame, dtype=np.uint8)
+    return ~(int(data.sum(dtype=np.uint64)) - int(data[1])) & 0xFF
+
+
+def seal(body: bytes) -> bytes:
+    """在body后追加\r\n并填写checksum"""
+    frame = bytearray(body) + TRAILER
+    frame[1] = checksum(frame)
+    return bytes(frame)
+
+
+def is_valid(frame: bytes) -> bool:
+    """以\r\n结尾 且所有字节之和为0xFF"""
+    if len(frame) < HEADER_SIZE + len(TRAILER) or not frame.endswith(TRAILER):
+        return False
+    return int(np.frombuffer(frame, dtype=np.uint8).sum(dtype=np.uint8)) == 0xFF
+
+
+class Message:
+    """生成的各个帧类型的公共部分"""
+    ID: int
+    HEADER: np.dtype
+    TAIL: np.dtype | None = None
+    COUNT: tuple[str, ...] = ()
+
+    @classmethod
+    def encode(cls, tail=None, **fields) -> bytes:
+        """只有一个计数字段时可以省略 按tail的长度填写"""
+        header = np.zeros(1, dtype=cls.HEADER)
+        header["id"] = cls.ID
+        if cls.TAIL is not None:
+            if isinstance(tail, (bytes, bytearray)):
+                tail = np.frombuffer(tail, dtype=cls.TAIL)
+            tail = np.asarray(tail if tail is not None else [], dtype=cls.TAIL)
+            if len(cls.COUNT) == 1 and cls.COUNT[0] not in fields:
+                fields[cls.COUNT[0]] = len(tail)
+        for name, value in fields.items():
+            header[name] = value
+        body = header.tobytes()
+        if cls.TAIL is not None:
+            body += tail.tobytes()
+        return seal(body)
+
+    @classmethod
+    def decode(cls, frame: bytes) -> tuple[np.void, np.ndarray | None]:
+        """返回帧头字段和tail 两者都是frame上的视图 格式不对时抛出ValueError"""
+        if not is_valid(frame) or frame[0] != cls.ID or len(frame) < cls.HEADER.itemsize + len(TRAILER):
+            raise ValueError(f"not a valid {cls.__name__} frame")
+        header = np.frombuffer(frame, dtype=cls.HEADER, count=1)[0]
+        if cls.TAIL is None:
+            if len(frame) != cls.HEADER.itemsize + len(TRAILER):
+                raise ValueError(f"bad {cls.__name__} length {len(frame)}")
+            return header, None
+        count = sum(int(header[name]) for name in cls.COUNT)
+        if len(frame) != cls.HEADER.itemsize + count * cls.TAIL.itemsize + len(TRAILER):
+            raise ValueError(f"bad {cls.__name__} length {len(frame)}")
+        return header, np.frombuffer(frame, dtype=cls.TAIL, count=count, offset=cls.HEADER.itemsize)
+
+    @classmethod
+    def decode_many(cls, buffer: bytes) -> np.ndarray:
+        """解码首尾相接的多个定长帧 丢弃checksum不对的帧"""
+        if cls.TAIL is not None:
+            raise TypeError(f"{cls.__name__} frames are variable length")
+        size = cls.HEADER.itemsize + len(TRAILER)
+        data = np.frombuffer(buffer, dtype=np.uint8)[: len(buffer) // size * size].reshape(-1, size)
+        valid = (data.sum(axis=1, dtype=np.uint8) == 0xFF) & (data[:, 0] == cls.ID)
+        return data[valid, : cls.HEADER.itemsize].copy().view(cls.HEADER).reshape(-1)
+
+
+# ---- phone: 手机通过蓝牙串口(USART3)与STM32通信 ----
+
+
+class PhoneMeasure(Message):
+    """触发AHT20测量"""
+    ID = 0x00
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1')])
+
+
+class PhoneSetWifi(Message):
+    """设置ESP01S的WIFI连接信息"""
+    ID = 0x01
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("ssid_length", 'u1'), ("password_length", 'u1')])
+    TAIL = np.dtype('u1')
+    COUNT = ('ssid_length', 'password_length',)
+
+
+class PhoneProfileDump(Message):
+    """输出各阶段耗时统计"""
+    ID = 0x02
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("reset", 'u1')])
+
+
+class PhoneSubscribe(Message):
+    """订阅二进制样本推送"""
+    ID = 0x03
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("interval_ms", '<u2')])
+
+
+class PhoneSetBaud(Message):
+    """修改USART3波特率 先用旧波特率回复ACK再切换"""
+    ID = 0x04
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("baud_rate", '<u4')])
+
+
+class PhoneCalibrationControl(Message):
+    """修正表的begin commit clear操作"""
+    ID = 0x05
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("op", 'u1')])
+
+
+class PhoneCalibrationWrite(Message):
+    """修正表的write操作 一帧最多22个点 湿度网格要分两次写"""
+    ID = 0x05
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("op", 'u1'), ("table", 'u1'), ("start", 'u1'), ("count", 'u1')])
+    TAIL = np.dtype('<i4')
+    COUNT = ('count',)
+
+
+class PhoneStreamSample(Message):
+    """订阅模式下推送的样本 帧头与命令字不重叠"""
+    ID = 0x10
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("sequence", '<u2'), ("temperature_centi", '<i2'), ("humidity_centi", '<u2'), ("timestamp", '<u4'), ("coalesced", 'u1')])
+
+
+# ---- esp: STM32通过USART2与ESP01S通信 ESP01S对每帧回复ACK\r\n ----
+
+
+class EspWifiConfig(Message):
+    """转发手机设置的WIFI连接信息"""
+    ID = 0x00
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("ssid_length", 'u1'), ("password_length", 'u1')])
+    TAIL = np.dtype('u1')
+    COUNT = ('ssid_length', 'password_length',)
+
+
+class EspSample(Message):
+    """一个实时样本"""
+    ID = 0x01
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("temperature", '<f4'), ("humidity", '<f4'), ("timestamp", '<u4')])
+
+
+class EspTracedSample(Message):
+    """带追踪信息的实时样本 每次重传前更新age_us并重新计算checksum"""
+    ID = 0x04
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("temperature", '<f4'), ("humidity", '<f4'), ("timestamp", '<u4'), ("trace_id", '<u2'), ("conversion_us", '<u4'), ("age_us", '<u4')])
+
+
+class EspSampleBatch(Message):
+    """补发链路断开期间缓存在flash中的样本 按时间顺序"""
+    ID = 0x02
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("count", 'u1')])
+    TAIL = np.dtype(SAMPLE_RECORD)
+    COUNT = ('count',)
+
+
+class EspTimeRequest(Message):
+    """请求ESP01S的当前时间 ESP01S用time_reply代替ACK"""
+    ID = 0x03
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1')])
+
+
+class EspTimeReply(Message):
+    """ESP01S的当前时间"""
+    ID = 0x03
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("epoch_seconds", '<u4'), ("milliseconds", '<u2')])
+
+
+# ---- push: ESP01S通过MQTT或UDP主动推送样本 一帧就是一条MQTT消息或一个UDP数据报 ----
+
+
+class PushSamples(Message):
+    """一批样本 按时间顺序 实时样本的sequence为0"""
+    ID = 0x20
+    HEADER = np.dtype([("id", 'u1'), ("checksum", 'u1'), ("sequence", '<u2'), ("count", 'u1')])
+    TAIL = np.dtype(SAMPLE_RECORD)
+    COUNT = ('count',)
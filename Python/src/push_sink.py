@@ -0,0 +1,78 @@
+"""
+接收ESP01S主动推送的样本 打印出来 用于在本地验证推送
+
+    python push_sink.py udp [port]
+    python push_sink.py mqtt <broker> [topic]   需要paho-mqtt
+"""
+import socket
+import sys
+import time
+from typing import Optional
+
+import numpy as np
+
+import protocol
+
+UDP_PORT = 5020
+MQTT_TOPIC = "humidistat/+/samples"
+
+# 每个设备上一帧的sequence 用于统计丢失
+last_sequence: dict[str, int] = {}
+# 每个设备累计丢失的帧数
+lost_frames: dict[str, int] = {}
+
+
+def handle_frame(source: str, frame: bytes) -> Optional[np.ndarray]:
+    """打印并返回帧中的样本 帧不完整时返回None"""
+    if not protocol.is_valid(frame):
+        print(f"{source}: broken frame {frame.hex()}")
+        return None
+    header, records = protocol.PushSamples.decode(frame)
+    sequence = int(header["sequence"])
+    previous = last_sequence.get(source)
+    if previous is not None and sequence != (previous + 1) & 0xFFFF:
+        lost = (sequence - previous - 1) & 0xFFFF
+        lost_frames[source] = lost_frames.get(source, 0) + lost
+        print(f"{source}: {lost} frames lost")
+    last_sequence[source] = sequence
+    for record in records:
+        timestamp = int(record["timestamp"])
+        sampled_at = time.strftime("%Y-%m-%d %H:%M:%S",
+                                   time.localtime(timestamp)) if timestamp else "unsynced"
+        print(f"{source} #{record['sequence']}: "
+              f"{record['temperature_centi'] / 100:.2f}°C "
+              f"{record['humidity_centi'] / 100:.2f}%RH "
+              f"sampled at {sampled_at}")
+    return records
+
+
+def run_udp(port: int) -> None:
+    sink = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sink.bind(("", port))
+    print(f"Listening on UDP port {port}")
+    while True:
+        frame, (host, _) = sink.recvfrom(protocol.MAX_FRAME_SIZE)
+        handle_frame(host, frame)
+
+
+def run_mqtt(broker: str, topic: str) -> None:
+    import paho.mqtt.client as mqtt
+
+    def on_message(client, userdata, message) -> None:
+        handle_frame(message.topic, message.payload)
+
+    client = mqtt.Client()
+    client.on_message = on_message
+    client.connect(broker)
+    client.subscribe(topic, qos=1)
+    print(f"Subscribed to {topic} on {broker}")
+    client.loop_forever()
+
+
+if __name__ == "__main__":
+    if len(sys.argv) >= 3 and sys.argv[1] == "mqtt":
+        run_mqtt(sys.argv[2], sys.argv[3] if len(sys.argv) > 3 else MQTT_TOPIC)
+    elif len(sys.argv) >= 2 and sys.argv[1] == "udp":
+        run_udp(int(sys.argv[2]) if len(sys.argv) > 2 else UDP_PORT)
+    else:
+        print(__doc__)
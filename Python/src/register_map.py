@@ -0,0 +1,102 @@
+"""
+ESP01S的Modbus寄存器映射 与tcp_slave.c和modbus_params.h一致
+
+输入寄存器: humidity temperature timestamp(uint32) 格式和字序见TXT记录的in项
+如 "float32,hi" 字序hi为高16位在前
+保持寄存器: 0~1为Unix时间 字序见TXT记录的hold项 写入后ESP01S再同步给STM32
+追踪寄存器: 从TXT记录的trace项开始 5个高16位在前的uint32 见TRACE_FIELDS
+"""
+import math
+import struct
+from typing import Optional
+
+INPUT_REGISTER_COUNTS = {"float32": 6, "int32x100": 6, "int16x100": 4}
+HOLDING_EPOCH_ADDRESS = 0
+# 1.1.0及以前的固件没有in和hold项 都是低16位在前
+LEGACY_LAYOUT = ("float32", "lo", "lo")
+# 现在固件Kconfig的默认格式
+DEFAULT_LAYOUT = ("float32", "hi", "hi")
+# trace_id为0时样本是补发的 没有追踪信息
+TRACE_FIELDS = ("trace_id", "conversion_us", "link_us", "queue_us", "age_us")
+TRACE_REGISTER_COUNT = 2 * len(TRACE_FIELDS)
+# 与modbus_params.h中的MB_TRACE_REGISTER_START相同 命令行给出的地址用它
+DEFAULT_TRACE_ADDRESS = 0x0010
+
+
+def parse_layout(txt: dict[str, str]) -> tuple[str, str, str]:
+    """从TXT记录得到 (输入格式, 输入字序, 保持字序)"""
+    if "in" in txt and "hold" in txt:
+        fmt, _, input_order = txt["in"].partition(",")
+        if fmt in INPUT_REGISTER_COUNTS:
+            return fmt, input_order, txt["hold"]
+    return LEGACY_LAYOUT
+
+
+def parse_trace_address(txt: dict[str, str]) -> Optional[int]:
+    """1.3.0之前的固件没有trace项 返回None"""
+    try:
+        return int(txt["trace"])
+    except (KeyError, ValueError):
+        return None
+
+
+def words_to_u32(words: list[int], order: str) -> int:
+    high, low = words if order == "hi" else words[::-1]
+    return (high << 16) | low
+
+
+def u32_to_words(value: int, order: str) -> list[int]:
+    words = [value >> 16, value & 0xFFFF]
+    return words if order == "hi" else words[::-1]
+
+
+def decode_inputs(registers: list[int], fmt: str, order: str) -> tuple[float, float, int]:
+    """返回 (humidity, temperature, timestamp)"""
+    if fmt == "int16x100":
+        humidity, temperature = struct.unpack(">2h", struct.pack(">2H", *registers[:2]))
+        return humidity / 100, temperature / 100, words_to_u32(registers[2:4], order)
+    values = [words_to_u32(registers[i:i + 2], order) for i in (0, 2)]
+    if fmt == "int32x100":
+        humidity, temperature = (value / 100 for value in
+                                 struct.unpack(">2i", struct.pack(">2I", *values)))
+    else:
+        humidity, temperature = struct.unpack(">2f", struct.pack(">2I", *values))
+    return humidity, temperature, words_to_u32(registers[4:6], order)
+
+
+def to_float32(value: float) -> float:
+    return struct.unpack("<f", struct.pack("<f", value))[0]
+
+
+def scale_x100(value: float) -> int:
+    """与tcp_slave.c中put_scaled的roundf(value * 100)相同
+
+    乘法按float32计算 0.5向远离0的方向进位 Python的round()是进到偶数
+    """
+    scaled = to_float32(to_float32(value) * 100)
+    return int(math.copysign(math.floor(abs(scaled) + 0.5), scaled))
+
+
+def encode_inputs(humidity: float, temperature: float, timestamp: int,
+                  fmt: str, order: str) -> list[int]:
+    """与tcp_slave.c中modbus_update_temp_and_humi的编码相同"""
+    if fmt == "int16x100":
+        scaled = [min(max(scale_x100(value), -32768), 32767) & 0xFFFF
+                  for value in (humidity, temperature)]
+        return scaled + u32_to_words(timestamp, order)
+    if fmt == "int32x100":
+        values = [scale_x100(value) & 0xFFFFFFFF for value in (humidity, temperature)]
+    else:
+        values = struct.unpack(">2I", struct.pack(">2f", humidity, temperature))
+    return [word for value in values for word in u32_to_words(value, order)] + \
+        u32_to_words(timestamp, order)
+
+
+def decode_trace(registers: list[int]) -> tuple[int, ...]:
+    """返回与TRACE_FIELDS对应的各值"""
+    return tuple(words_to_u32(registers[i:i + 2], "hi")
+                 for i in range(0, TRACE_REGISTER_COUNT, 2))
+
+
+def encode_trace(values: tuple[int, ...]) -> list[int]:
+    return [word for value in values for word in u32_to_words(value & 0xFFFFFFFF, "hi")]
@@ -0,0 +1,311 @@
+"""
+按设备分列存储轮询到的样本 每台设备每月一个文件 文件由首尾相接的块组成
+
+    python sample_store.py <root> devices
+    python sample_store.py <root> query <device> <start> <end>
+    python sample_store.py <root> rollup <device> <start> <end> [--step 3600]
+
+时间可以是Unix时间或ISO格式的本地时间 如 2026-10-01T08:00
+"""
+import argparse
+import os
+import time
+from dataclasses import dataclass, field
+from datetime import datetime, timezone
+
+import numpy as np
+
+# 一个块覆盖15分钟 1Hz时约900个样本 进程崩溃最多丢这么长的数据
+CHUNK_SECONDS = 900
+CHUNK_MAGIC = 0x314B4348  # "HCK1"
+FILE_SUFFIX = ".hcol"
+VALUE_COLUMNS = ("temperature", "humidity")
+
+# 块头 之后依次是时间 温度 湿度三列的位打包数据
+# 时间存二阶差分 温度和湿度以0.01为单位存一阶差分 都经zigzag后按本块最大位宽打包
+# 块头带每列的min max sum 整块落在一个汇总区间内时不用解码
+CHUNK_HEADER = np.dtype([
+    ("magic", '<u4'), ("count", '<u4'), ("payload_size", '<u4'),
+    ("first_time", '<i8'), ("last_time", '<i8'), ("time_delta", '<i8'), ("time_width", 'u1'),
+    ("temperature_first", '<i4'), ("temperature_width", 'u1'),
+    ("temperature_min", '<i4'), ("temperature_max", '<i4'), ("temperature_sum", '<i8'),
+    ("humidity_first", '<i4'), ("humidity_width", 'u1'),
+    ("humidity_min", '<i4'), ("humidity_max", '<i4'), ("humidity_sum", '<i8'),
+])
+
+SAMPLE = np.dtype([("time", '<i8'), ("temperature", '<f8'), ("humidity", '<f8')])
+# datetime能表示的最后一秒
+MAX_TIME = 253402300799
+
+ROLLUP = np.dtype([("time", '<i8'), ("count", '<i8'),
+                   ("temperature_min", '<f8'), ("temperature_max", '<f8'), ("temperature_mean", '<f8'),
+                   ("humidity_min", '<f8'), ("humidity_max", '<f8'), ("humidity_mean", '<f8')])
+
+
+def month_of(timestamp: int) -> str:
+    timestamp = min(max(timestamp, 0), MAX_TIME)
+    return datetime.fromtimestamp(timestamp, timezone.utc).strftime("%Y-%m")
+
+
+def zigzag(values: np.ndarray) -> np.ndarray:
+    return ((values << 1) ^ (values >> 63)).astype(np.uint64)
+
+
+def unzigzag(values: np.ndarray) -> np.ndarray:
+    return (values >> np.uint64(1)).astype(np.int64) ^ -(values & np.uint64(1)).astype(np.int64)
+
+
+def pack_bits(values: np.ndarray) -> tuple[int, bytes]:
+    """返回 (位宽, 数据) 所有值按同一位宽 小端位序"""
+    if len(values) == 0 or not values.any():
+        return 0, b""
+    width = int(values.max()).bit_length()
+    bits = (values[:, None] >> np.arange(width, dtype=np.uint64)) & np.uint64(1)
+    return width, np.packbits(bits.astype(np.uint8).ravel(), bitorder="little").tobytes()
+
+
+def packed_size(count: int, width: int) -> int:
+    return (count * width + 7) // 8
+
+
+def unpack_bits(data: np.ndarray, count: int, width: int) -> np.ndarray:
+    if width == 0:
+        return np.zeros(count, dtype=np.uint64)
+    bits = np.unpackbits(data, count=count * width, bitorder="little")
+    return bits.reshape(count, width).astype(np.uint64) @ (np.uint64(1) << np.arange(width, dtype=np.uint64))
+
+
+def encode_chunk(times: np.ndarray, columns: dict[str, np.ndarray]) -> bytes:
+    """times单调递增 columns中为以0.01为单位的整数"""
+    header = np.zeros(1, dtype=CHUNK_HEADER)
+    header["magic"] = CHUNK_MAGIC
+    header["count"] = len(times)
+    header["first_time"] = times[0]
+    header["last_time"] = times[-1]
+    deltas = np.diff(times)
+    if len(deltas):
+        header["time_delta"] = deltas[0]
+    header["time_width"], payload = pack_bits(zigzag(np.diff(deltas)))
+    for name in VALUE_COLUMNS:
+        values = columns[name]
+        header[f"{name}_first"] = values[0]
+        header[f"{name}_min"] = values.min()
+        header[f"{name}_max"] = values.max()
+        header[f"{name}_sum"] = values.sum()
+        header[f"{name}_width"], packed = pack_bits(zigzag(np.diff(values)))
+        payload += packed
+    header["payload_size"] = len(payload)
+    return header.tobytes() + payload
+
+
+def decode_chunk(header: np.void, payload: np.ndarray) -> np.ndarray:
+    count = int(header["count"])
+    samples = np.empty(count, dtype=SAMPLE)
+    time_count = max(count - 2, 0)
+    offset = packed_size(time_count, int(header["time_width"]))
+    deltas = np.full(max(count - 1, 0), header["time_delta"], dtype=np.int64)
+    deltas[1:] += np.cumsum(unzigzag(unpack_bits(payload[:offset], time_count, int(header["time_width"]))))
+    samples["time"] = np.concatenate(([header["first_time"]], header["first_time"] + np.cumsum(deltas)))
+    for name in VALUE_COLUMNS:
+        width = int(header[f"{name}_width"])
+        size = packed_size(count - 1, width)
+        deltas = unzigzag(unpack_bits(payload[offset:offset + size], count - 1, width))
+        samples[name] = np.concatenate(([header[f"{name}_first"]],
+                                        header[f"{name}_first"] + np.cumsum(deltas))) / 100
+        offset += size
+    return samples
+
+
+@dataclass
+class ChunkIndex:
+    """一个文件中各块的位置和块头 文件变长后只读新增的部分"""
+    size: int = 0
+    offsets: list[int] = field(default_factory=list)
+    headers: list[np.void] = field(default_factory=list)
+
+
+class SampleStore:
+
+    def __init__(self, root: str):
+        self.root = root
+        # 设备 -> (块编号, 时间, 温度, 湿度)
+        self.buffers: dict[str, tuple[int, list[int], list[int], list[int]]] = {}
+        # 设备 -> 最后接受的样本时间 块写入文件后也保留
+        self.last_times: dict[str, int] = {}
+        self.indexes: dict[str, ChunkIndex] = {}
+
+    @staticmethod
+    def device_dir_name(device: str) -> str:
+        # humidistat-<MAC>._modbus._tcp.local. -> humidistat-<MAC>
+        return device.split("._", 1)[0].replace("/", "_")
+
+    def file_path(self, device: str, chunk_time: int) -> str:
+        return os.path.join(self.root, self.device_dir_name(device), month_of(chunk_time) + FILE_SUFFIX)
+
+    def append(self, device: str, timestamp: int, temperature: float, humidity: float) -> None:
+        """不晚于上一个样本的丢弃 块按时间首尾相接不重叠 进入下一个块的时间范围时把缓冲写入文件"""
+        last_time = self.last_times.get(device)
+        if last_time is not None and timestamp <= last_time:
+            return
+        self.last_times[device] = timestamp
+        chunk = timestamp // CHUNK_SECONDS
+        buffer = self.buffers.get(device)
+        if buffer is None or buffer[0] != chunk:
+            self.flush(device)
+            buffer = (chunk, [], [], [])
+            self.buffers[device] = buffer
+        buffer[1].append(timestamp)
+        buffer[2].append(round(temperature * 100))
+        buffer[3].append(round(humidity * 100))
+
+    def flush(self, device: str) -> None:
+        buffer = self.buffers.pop(device, None)
+        if buffer is None or not buffer[1]:
+            return
+        times = np.array(buffer[1], dtype=np.int64)
+        path = self.file_path(device, int(times[0]))
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "ab") as file:
+            file.write(encode_chunk(times, {"temperature": np.array(buffer[2], dtype=np.int64),
+                                            "humidity": np.array(buffer[3], dtype=np.int64)}))
+
+    def close(self) -> None:
+        for device in list(self.buffers):
+            self.flush(device)
+
+    def devices(self) -> list[str]:
+        if not os.path.isdir(self.root):
+            return []
+        return sorted(name for name in os.listdir(self.root)
+                      if os.path.isdir(os.path.join(self.root, name)))
+
+    def chunks(self, device: str, start: int, end: int):
+        """依次给出与[start, end)重叠的块的 (块头, 数据) 数据是文件映射上的视图 只读到需要的块"""
+        directory = os.path.join(self.root, self.device_dir_name(device))
+        if not os.path.isdir(directory):
+            return
+        first_month = month_of(start)
+        last_month = month_of(max(end - 1, start))
+        for name in sorted(os.listdir(directory)):
+            month = name.removesuffix(FILE_SUFFIX)
+            if not name.endswith(FILE_SUFFIX) or not first_month <= month <= last_month:
+                continue
+            path = os.path.join(directory, name)
+            if os.path.getsize(path) == 0:
+                continue
+            # 映射随最后一个引用它的数组释放
+            mapped = np.memmap(path, dtype=np.uint8, mode="r")
+            index = self.update_index(path, mapped)
+            for offset, header in zip(index.offsets, index.headers):
+                if header["last_time"] < start or header["first_time"] >= end:
+                    continue
+                payload_offset = offset + CHUNK_HEADER.itemsize
+                yield header, mapped[payload_offset:payload_offset + header["payload_size"]]
+
+    def update_index(self, path: str, mapped: np.ndarray) -> ChunkIndex:
+        index = self.indexes.setdefault(path, ChunkIndex())
+        offset = index.size
+        while offset + CHUNK_HEADER.itemsize <= len(mapped):
+            header = mapped[offset:offset + CHUNK_HEADER.itemsize].view(CHUNK_HEADER)[0].copy()
+            end = offset + CHUNK_HEADER.itemsize + int(header["payload_size"])
+            if header["magic"] != CHUNK_MAGIC or end > len(mapped):
+                # 写到一半的块 下次再读
+                break
+            index.offsets.append(offset)
+            index.headers.append(header)
+            offset = end
+        index.size = offset
+        return index
+
+    def query(self, device: str, start: int, end: int) -> np.ndarray:
+        """[start, end)内的样本 按时间排序"""
+        parts = [decode_chunk(header, payload) for header, payload in self.chunks(device, start, end)]
+        if not parts:
+            return np.empty(0, dtype=SAMPLE)
+        samples = np.concatenate(parts)
+        samples = samples[(samples["time"] >= start) & (samples["time"] < end)]
+        # 进程重启后设备时间回退时 新块会排在更晚的块后面
+        if np.any(np.diff(samples["time"]) < 0):
+            samples = np.sort(samples, order="time", kind="stable")
+        return samples
+
+    def rollup(self, device: str, start: int, end: int, step: int) -> np.ndarray:
+        """按step秒汇总 没有样本的区间不输出"""
+        buckets = (end - start + step - 1) // step
+        count = np.zeros(buckets, dtype=np.int64)
+        sums = {name: np.zeros(buckets) for name in VALUE_COLUMNS}
+        minimums = {name: np.full(buckets, np.inf) for name in VALUE_COLUMNS}
+        maximums = {name: np.full(buckets, -np.inf) for name in VALUE_COLUMNS}
+        for header, payload in self.chunks(device, start, end):
+            first = (int(header["first_time"]) - start) // step
+            if first == (int(header["last_time"]) - start) // step and \
+                    header["first_time"] >= start and header["last_time"] < end:
+                count[first] += header["count"]
+                for name in VALUE_COLUMNS:
+                    sums[name][first] += header[f"{name}_sum"] / 100
+                    minimums[name][first] = min(minimums[name][first], header[f"{name}_min"] / 100)
+                    maximums[name][first] = max(maximums[name][first], header[f"{name}_max"] / 100)
+                continue
+            samples = decode_chunk(header, payload)
+            samples = samples[(samples["time"] >= start) & (samples["time"] < end)]
+            bucket = (samples["time"] - start) // step
+            count += np.bincount(bucket, minlength=buckets)
+            for name in VALUE_COLUMNS:
+                sums[name] += np.bincount(bucket, samples[name], minlength=buckets)
+                np.minimum.at(minimums[name], bucket, samples[name])
+                np.maximum.at(maximums[name], bucket, samples[name])
+
+        present = count > 0
+        rollup = np.empty(int(present.sum()), dtype=ROLLUP)
+        rollup["time"] = start + np.flatnonzero(present) * step
+        rollup["count"] = count[present]
+        for name in VALUE_COLUMNS:
+            rollup[f"{name}_min"] = minimums[name][present]
+            rollup[f"{name}_max"] = maximums[name][present]
+            rollup[f"{name}_mean"] = sums[name][present] / count[present]
+        return rollup
+
+
+def parse_time(text: str) -> int:
+    if text.isdigit():
+        return int(text)
+    return int(datetime.fromisoformat(text).timestamp())
+
+
+def format_time(timestamp: int) -> str:
+    return time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(timestamp))
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("root")
+    commands = parser.add_subparsers(dest="command", required=True)
+    commands.add_parser("devices")
+    for command in ("query", "rollup"):
+        sub = commands.add_parser(command)
+        sub.add_argument("device")
+        sub.add_argument("start", type=parse_time)
+        sub.add_argument("end", type=parse_time)
+        if command == "rollup":
+            sub.add_argument("--step", type=int, default=3600, help="seconds per bucket")
+    args = parser.parse_args()
+
+    store = SampleStore(args.root)
+    if args.command == "devices":
+        for device in store.devices():
+            print(device)
+    elif args.command == "query":
+        for sample in store.query(args.device, args.start, args.end):
+            print(f"{format_time(int(sample['time']))} "
+                  f"{sample['temperature']:.2f}°C {sample['humidity']:.2f}%RH")
+    else:
+        for row in store.rollup(args.device, args.start, args.end, args.step):
+            print(f"{format_time(int(row['time']))} n={row['count']} "
+                  f"T {row['temperature_min']:.2f}/{row['temperature_mean']:.2f}/"
+                  f"{row['temperature_max']:.2f}°C "
+                  f"RH {row['humidity_min']:.2f}/{row['humidity_mean']:.2f}/"
+                  f"{row['humidity_max']:.2f}%")
+
+
+if __name__ == "__main__":
+    main()
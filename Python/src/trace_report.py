@@ -0,0 +1,128 @@
+"""
+分析fleet_poller --trace记录的追踪数据 按阶段给出延迟分位数
+
+    python trace_report.py <traces.csv> [--device NAME]
+
+每个阶段都在一台设备内部计时 不需要STM32 ESP01S和主站之间对时
+    conversion  STM32发出测量命令到换算完成 含AHT20约80ms的转换
+    link        换算完成到ESP01S收完整帧 含STM32排队 ARQ重传和串口传输
+    esp queue   ESP01S收完整帧到写入Modbus寄存器
+    poll wait   写入寄存器到主站的读请求到达 (esp-modbus从站为0 不可测)
+    network     读追踪寄存器往返时间的一半
+同一trace_id第一次被读到时的各段之和是样本的端到端延迟
+每次读到时换算完成以来的时间是样本的陈旧度 轮询间隔越长越大
+"""
+import argparse
+import csv
+import os
+from typing import Optional
+
+import numpy as np
+
+import register_map
+
+COLUMNS = ("received_at", "device") + register_map.TRACE_FIELDS + ("round_trip_us",)
+STAGES = (("conversion", "conversion_us"), ("link", "link_us"), ("esp queue", "queue_us"),
+          ("poll wait", "age_us"), ("network", "network_us"))
+# trace_id在1..65535之间循环 跳过0 65535之后的下一个是1
+TRACE_ID_MODULO = 0xFFFF
+
+
+class TraceLog:
+    """每次读到追踪寄存器写一行CSV 文件已存在时追加"""
+
+    def __init__(self, path: str):
+        is_new = not os.path.exists(path) or os.path.getsize(path) == 0
+        self.file = open(path, "a", newline="")
+        self.writer = csv.writer(self.file)
+        if is_new:
+            self.writer.writerow(COLUMNS)
+
+    def write(self, name: str, received_at: float, round_trip: float,
+              trace: tuple[int, ...]) -> None:
+        self.writer.writerow((f"{received_at:.6f}", name, *trace, round(round_trip * 1e6)))
+
+    def close(self) -> None:
+        self.file.close()
+
+
+def load(path: str, device: Optional[str]) -> dict[str, np.ndarray]:
+    """按设备和收到的时间排序 返回每列一个数组"""
+    with open(path, newline="") as file:
+        rows = [row for row in csv.DictReader(file)
+                if device is None or row["device"] == device]
+    rows.sort(key=lambda row: (row["device"], float(row["received_at"])))
+    columns = {"device": np.array([row["device"] for row in rows])}
+    columns["received_at"] = np.array([float(row["received_at"]) for row in rows])
+    for name in register_map.TRACE_FIELDS + ("round_trip_us",):
+        columns[name] = np.array([int(row[name]) for row in rows], dtype=np.int64)
+    columns["network_us"] = columns["round_trip_us"] // 2
+    return columns
+
+
+def first_reads(columns: dict[str, np.ndarray]) -> np.ndarray:
+    """同一设备上trace_id和上一次读到的不同 就是这个样本第一次被读到 trace_id回绕也成立"""
+    is_first = np.ones(len(columns["device"]), dtype=bool)
+    is_first[1:] = ((columns["device"][1:] != columns["device"][:-1]) |
+                    (columns["trace_id"][1:] != columns["trace_id"][:-1]))
+    return is_first
+
+
+def missed_traces(columns: dict[str, np.ndarray], is_first: np.ndarray) -> int:
+    """两次读之间换了不止一个样本 中间的样本没有被任何一次读到"""
+    devices = columns["device"][is_first]
+    ids = columns["trace_id"][is_first]
+    same_device = devices[1:] == devices[:-1]
+    gaps = (ids[1:] - ids[:-1]) % TRACE_ID_MODULO - 1
+    return int(gaps[same_device & (gaps > 0)].sum())
+
+
+def print_distribution(label: str, values_us: np.ndarray, total_mean: float) -> None:
+    p50, p90, p99 = np.percentile(values_us, (50, 90, 99)) / 1000
+    share = values_us.mean() / total_mean * 100 if total_mean else 0.0
+    print(f"{label:<12} {p50:>9.2f} {p90:>9.2f} {p99:>9.2f} "
+          f"{values_us.max() / 1000:>9.2f} {share:>6.1f}")
+
+
+def report(columns: dict[str, np.ndarray]) -> None:
+    is_first = first_reads(columns)
+    first = {name: values[is_first] for name, values in columns.items()}
+    total = sum(first[column] for _, column in STAGES)
+    staleness = sum(columns[column] for _, column in STAGES[1:])
+
+    devices = len(np.unique(columns["device"]))
+    print(f"{len(columns['device'])} reads of {int(is_first.sum())} samples "
+          f"from {devices} devices, {missed_traces(columns, is_first)} samples never read")
+    print()
+    print("first read of each sample (ms)")
+    print(f"{'stage':<12} {'p50':>9} {'p90':>9} {'p99':>9} {'max':>9} {'mean %':>6}")
+    total_mean = total.mean()
+    for label, column in STAGES:
+        print_distribution(label, first[column], total_mean)
+    print_distribution("total", total, total_mean)
+    print()
+    print("staleness at every read, since conversion done (ms)")
+    print(f"{'':<12} {'p50':>9} {'p90':>9} {'p99':>9} {'max':>9}")
+    p50, p90, p99 = np.percentile(staleness, (50, 90, 99)) / 1000
+    print(f"{'all reads':<12} {p50:>9.2f} {p90:>9.2f} {p99:>9.2f} "
+          f"{staleness.max() / 1000:>9.2f}")
+    if not columns["age_us"].any():
+        print()
+        print("age_us is always 0: the nodes run the esp-modbus slave, "
+              "poll wait is not measured")
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("path", help="CSV written by fleet_poller.py --trace")
+    parser.add_argument("--device", help="only this device")
+    args = parser.parse_args()
+    columns = load(args.path, args.device)
+    if len(columns["device"]) == 0:
+        print("no trace records")
+        return
+    report(columns)
+
+
+if __name__ == "__main__":
+    main()
@@ -7,15 +7,34 @@
 
 void AHT20MeasureTrigger(void);
 
+typedef enum {
+    // 等待上电40ms
+    AHT20_BOOT_POWER_UP = 0,
+    // 正在读状态字
+    AHT20_BOOT_STATUS,
+    // 正在发送校准命令
+    AHT20_BOOT_CALIBRATE,
+    // 等待校准完成
+    AHT20_BOOT_CALIBRATE_WAIT,
+    AHT20_BOOT_READY,
+} AHT20BootStage;
+
 typedef struct {
     uint8_t rx_tx_buffer[6];
     uint32_t origin_humidity;
     uint32_t origin_temperature;
     uint8_t is_busy;
+    AHT20BootStage boot_stage;
+    // 从上电到第一个样本完成的时间 为0表示还没有样本
+    uint32_t boot_to_first_sample_ms;
 } AHT20;
 
 extern AHT20 aht20;
 
+/**
+ * @brief 只注册事件和启动上电定时器 不阻塞
+ * 上电等待 校准和第一次测量都在主循环中异步完成
+ */
 void AHT20_Init(void);
 void AHT20_SendMeasurement(void);
 void AHT20_DMATxCpltOrWait1MoreTime(void);
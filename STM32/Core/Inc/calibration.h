@@ -0,0 +1,69 @@
+#ifndef __CALIBRATION_H
+#define __CALIBRATION_H
+#include "main.h"
+#include "arm_math.h"
+#include <stdint.h>
+
+/* 与链接脚本中的CALIBRATION区域一致 */
+#define CALIBRATION_ADDRESS 0x0800DC00U
+#define CALIBRATION_MAGIC 0x424C4143U /* "CALB" */
+/* 温度修正表 覆盖AHT20的整个换算范围-50~150°C 每25°C一个点 */
+#define CALIBRATION_TEMPERATURE_POINTS 9U
+/* 湿度修正网格 温度每50°C 湿度每25%RH一个点 */
+#define CALIBRATION_GRID_SIZE 5U
+#define CALIBRATION_HUMIDITY_POINTS                                            \
+  (CALIBRATION_GRID_SIZE * CALIBRATION_GRID_SIZE)
+/* 表中q31的满量程 即修正量范围为±16°C或±16%RH */
+#define CALIBRATION_OFFSET_FULL_SCALE 16.0f
+
+typedef enum {
+  // 只随温度变化的温度修正量 一维线性插值
+  CALIBRATION_TABLE_TEMPERATURE = 0,
+  // 随温度和湿度变化的湿度修正量 二维双线性插值
+  CALIBRATION_TABLE_HUMIDITY = 1,
+} CalibrationTableId;
+
+/**
+ * @brief 存放在独立flash页中的修正表
+ * humidity_offset按行存放 每行是同一温度下的各湿度点
+ */
+typedef struct {
+  uint32_t magic;
+  q31_t temperature_offset[CALIBRATION_TEMPERATURE_POINTS];
+  q31_t humidity_offset[CALIBRATION_HUMIDITY_POINTS];
+  // 前面所有字的和取反
+  uint32_t checksum;
+} CalibrationTable;
+
+/**
+ * @brief 读取flash中的修正表 无效时不做修正
+ */
+void calibration_init(void);
+uint8_t calibration_is_active(void);
+/**
+ * @brief 用原始的20位读数查表 修正换算后的温湿度
+ */
+void calibration_apply(uint32_t raw_temperature, uint32_t raw_humidity,
+                       float *temperature, float *humidity);
+/**
+ * @brief 开始上传 暂存表清零
+ */
+void calibration_upload_begin(void);
+/**
+ * @brief 写入暂存表中从start开始的count个点
+ *
+ * @return 越界时返回HAL_ERROR
+ */
+HAL_StatusTypeDef calibration_upload_write(CalibrationTableId table,
+                                           uint8_t start, uint8_t count,
+                                           const uint8_t values[]);
+/**
+ * @brief 把暂存表写入flash并立即生效
+ */
+HAL_StatusTypeDef calibration_upload_commit(void);
+/**
+ * @brief 擦除修正表 恢复数据手册公式
+ */
+HAL_StatusTypeDef calibration_clear(void);
+
+#endif /* __CALIBRATION_H */
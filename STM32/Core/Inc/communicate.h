@@ -1,19 +1,41 @@
 #ifndef __COMMUNICATE_H
 #define __COMMUNICATE_H
+#include "protocol.h"
+#include "trace.h"
 #include "stm32f1xx.h"
 #include <stdint.h>
 
 
 uint8_t is_command_end(const uint8_t data[], uint16_t length);
-uint8_t get_checksum(const uint8_t data[], uint16_t length);
-void wait_for_command(void);
+/**
+ * @brief 注册命令和链路的事件处理 开始接收蓝牙命令
+ */
+void communicate_init(void);
+/**
+ * @brief USART3空闲中断回调 标记一条命令接收完毕
+ *
+ * @param rx_length 接收到的字节数
+ */
+void command_rx_event_callback(uint16_t rx_length);
+/**
+ * @brief USART2空闲中断回调 ESP01S的应答接收完毕
+ */
+void link_rx_event_callback(uint16_t rx_length);
+/**
+ * @brief 通过USART3的DMA发送一条文本回复 不等待发送完成
+ */
+void reply_to_phone(const char *text);
 /**
  * @brief 把ssid和password发送到ESP01S
- * 发送格式如下
- * 0x00|ssid_length|password_length|password
- * 
- * @param communication_msg 
+ * 帧格式见protocol.h中的ProtocolEspWifiConfig
+ *
+ * @param config 已经检查过长度的手机命令
+ */
+void SetWIFIConfiguration(const ProtocolPhoneSetWifi *config);
+void transmit_temp_and_humi_to_esp(float temperature, float humidity,
+                                   uint32_t timestamp, const TraceStamp *trace);
+/**
+ * @brief 链路空闲时向ESP01S请求一次参考时间 结果交给timebase
  */
-void SetWIFIConfiguration(char communication_msg[]);
-void transmit_temp_and_humi_to_esp(float temperature, float humidity);
+void request_time_sync(void);
 #endif /* __COMMUNICATE_H */
\ No newline at end of file
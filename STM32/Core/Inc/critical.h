@@ -0,0 +1,22 @@
+#ifndef __CRITICAL_H
+#define __CRITICAL_H
+#include "main.h"
+#include <stdint.h>
+
+/**
+ * @brief 关中断并返回之前的PRIMASK 可以嵌套 也可以在中断中调用
+ * @return uint32_t 交给exit_critical恢复
+ */
+static inline uint32_t enter_critical(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+/**
+ * @brief 恢复enter_critical之前的中断状态 外层已经关中断时保持关闭
+ * @param primask enter_critical的返回值
+ */
+static inline void exit_critical(uint32_t primask) { __set_PRIMASK(primask); }
+
+#endif /* __CRITICAL_H */
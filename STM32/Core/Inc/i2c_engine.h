@@ -0,0 +1,77 @@
+#ifndef __I2C_ENGINE_H
+#define __I2C_ENGINE_H
+#include "main.h"
+#include <stdint.h>
+
+/* Fast Mode */
+#define I2C_ENGINE_CLOCK_SPEED 400000U
+#define I2C_ENGINE_QUEUE_SIZE 8U
+/* 一次传输超过这个时间没完成 认为总线被卡住 */
+#define I2C_ENGINE_TIMEOUT_MS 10U
+
+typedef enum {
+  I2C_ENGINE_OK = 0,
+  // 从机没有应答
+  I2C_ENGINE_NACK,
+  // 总线错误 仲裁丢失 DMA错误
+  I2C_ENGINE_BUS_ERROR,
+  // 超时 已经做过总线恢复
+  I2C_ENGINE_TIMEOUT,
+} I2CEngineStatus;
+
+/**
+ * @brief 传输完成回调 在中断中调用
+ */
+typedef void (*I2CEngineCallback)(I2CEngineStatus status);
+
+/**
+ * @brief 一次读或写的描述符
+ * 入队时按值拷贝 buffer需要保持有效直到回调
+ */
+typedef struct {
+  // 8位写地址 与HAL的DevAddress一致
+  uint8_t address;
+  uint8_t is_read;
+  uint8_t length;
+  uint8_t *buffer;
+  // 可为NULL
+  I2CEngineCallback callback;
+} I2CTransaction;
+
+/**
+ * @brief 在MX_I2C1_Init()之后调用 用LL重新配置I2C1和DMA1通道6/7
+ */
+void i2c_engine_init(void);
+/**
+ * @brief 系统时钟改变后按新的PCLK1重新计算SCL时序
+ */
+void i2c_engine_retime(void);
+/**
+ * @brief 把一次传输放进队列 空闲时立即开始
+ * 队列中的传输在中断中一个接一个执行
+ *
+ * @return 队列满时返回HAL_BUSY
+ */
+HAL_StatusTypeDef i2c_engine_submit(const I2CTransaction *transaction);
+uint8_t i2c_engine_is_busy(void);
+/**
+ * @brief 等待队列清空 只能在线程模式下调用
+ */
+HAL_StatusTypeDef i2c_engine_wait_idle(uint32_t timeout_ms);
+/**
+ * @brief 从机卡住SDA时 手动输出最多9个SCL脉冲和一个STOP 然后复位I2C1
+ */
+void i2c_engine_recover_bus(void);
+/**
+ * @brief 在SysTick中每1ms调用一次 检查当前传输是否超时
+ */
+void i2c_engine_tick(void);
+
+/* 在stm32f1xx_it.c对应中断的USER CODE 0段中调用后直接返回
+ * CubeMX重新生成的HAL处理函数不会再执行 */
+void i2c_engine_ev_irq_handler(void);
+void i2c_engine_er_irq_handler(void);
+void i2c_engine_dma_tx_irq_handler(void);
+void i2c_engine_dma_rx_irq_handler(void);
+
+#endif /* __I2C_ENGINE_H */
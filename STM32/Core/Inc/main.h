@@ -41,12 +41,7 @@ extern "C" {
 
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
-/* Global cmd buffer for UART communication */
-/* 
-最长的缓存是WIFI的SSID和PASSWORD
-WIFI下需要 1字节命令标识 + 1字节表示SSID字节长度 + 1字节表示SSID密码长度 + SSID最长32字节 + 密码最长63字节 + 1空字符
-*/
-extern char communication_msg[99];
+
 /* USER CODE END EC */
 
 /* Exported macro ------------------------------------------------------------*/
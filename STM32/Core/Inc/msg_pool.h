@@ -0,0 +1,60 @@
+#ifndef __MSG_POOL_H
+#define __MSG_POOL_H
+#include "main.h"
+#include "protocol.h"
+#include <stdint.h>
+
+/*
+最长的报文是WIFI的SSID和PASSWORD
+1字节命令标识 + 1字节checksum + 1字节SSID长度 + 1字节密码长度 +
+SSID最长32字节 + 密码最长63字节 + \r\n = 101字节
+*/
+#define MSG_POOL_BLOCK_SIZE PROTOCOL_MAX_FRAME_SIZE
+/* 命令接收 发给手机 发给ESP01S 各占一块 再留一块给排队中的回复 */
+#define MSG_POOL_BLOCK_COUNT 4U
+
+/**
+ * @brief 固定大小的报文缓冲 同一时刻只属于一个使用者
+ * 交给DMA发送后所有权转给发送队列 发送完成时自动归还
+ */
+typedef struct MsgBuffer {
+  uint8_t data[MSG_POOL_BLOCK_SIZE];
+  uint16_t length;
+  // 发送队列中的下一块
+  struct MsgBuffer *next;
+} MsgBuffer;
+
+void msg_pool_init(void);
+/**
+ * @brief 中断中也可以调用
+ *
+ * @return 没有空闲块时返回NULL
+ */
+MsgBuffer *msg_pool_acquire(void);
+/**
+ * @brief 没有空闲块时睡眠等待发送完成归还 只能在线程模式下调用
+ */
+MsgBuffer *msg_pool_acquire_wait(void);
+void msg_pool_release(MsgBuffer *buffer);
+uint8_t msg_pool_free_count(void);
+/**
+ * @brief 按length用DMA发送 调用后buffer不再属于调用者
+ * UART正忙时排队 在上一块发送完成的回调里接着发
+ * 失败时buffer也已归还
+ */
+HAL_StatusTypeDef msg_pool_transmit_dma(UART_HandleTypeDef *huart,
+                                        MsgBuffer *buffer);
+/**
+ * @brief 等待该UART的发送队列清空 之后可以直接用阻塞发送
+ */
+void msg_pool_flush(UART_HandleTypeDef *huart);
+/**
+ * @brief 该UART的发送队列为空时返回1
+ */
+uint8_t msg_pool_is_tx_idle(UART_HandleTypeDef *huart);
+/**
+ * @brief 在HAL_UART_TxCpltCallback中调用
+ */
+void msg_pool_tx_cplt_callback(UART_HandleTypeDef *huart);
+
+#endif /* __MSG_POOL_H */
@@ -0,0 +1,39 @@
+#ifndef __POWER_H
+#define __POWER_H
+#include "main.h"
+#include <stdint.h>
+
+/* TIM1计数频率 切换时钟后按此值重新计算预分频 */
+#define POWER_TIM1_TICK_HZ 10000U
+
+typedef enum {
+  // HSI 8MHz 不开PLL 空闲和等待时使用
+  POWER_PROFILE_LOW = 0,
+  // PLL倍频 HSE可用时72MHz 否则HSI/2*16=64MHz 换算和组帧时使用
+  POWER_PROFILE_BURST,
+} PowerProfile;
+
+/**
+ * @brief 打开外部晶振后立即返回 起振结果由调度器轮询
+ * 探测结束前高速档使用HSI
+ */
+void power_init(void);
+/**
+ * @brief 切换时钟档位 并重新计算UART波特率 I2C时序 TIM1预分频
+ * 有外设正在收发时不切换 返回HAL_BUSY
+ */
+HAL_StatusTypeDef power_set_profile(PowerProfile profile);
+PowerProfile power_get_profile(void);
+void power_burst_begin(void);
+/**
+ * @brief 最外层的end切回低速档 外设正忙时推迟到power_sleep_until中空闲后再切
+ */
+void power_burst_end(void);
+/**
+ * @brief 进入Sleep模式 直到wake_flag被中断置位
+ * 关中断后再检查标志 避免检查与WFI之间到来的中断被错过
+ * 每次被唤醒时重试推迟的切回低速档
+ */
+void power_sleep_until(volatile uint8_t *wake_flag);
+
+#endif /* __POWER_H */
@@ -0,0 +1,69 @@
+#ifndef __PROFILER_H
+#define __PROFILER_H
+#include "main.h"
+#include <stdint.h>
+
+/* 置0可在编译期去掉所有打点 */
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+/* 直方图按2的幂划分微秒区间: [0,1) [1,2) [2,4) ... [2^18, ∞) */
+#define PROFILER_HISTOGRAM_BUCKETS 20
+
+/**
+ * @brief 一次采样链路上的各个阶段
+ * 每个阶段记录的是距离上一次打点的耗时
+ * 用trace_now_us()计时 不用DWT的CYCCNT 它的频率随时钟档位变化 Sleep时也不计数
+ */
+typedef enum {
+  // 收到测量命令 -> 发出AHT20触发命令
+  PROFILE_STAGE_TRIGGER = 0,
+  // 触发命令I2C DMA发送完成
+  PROFILE_STAGE_TX_CPLT,
+  // 75ms等待定时器到期
+  PROFILE_STAGE_TIMER_EXPIRE,
+  // I2C DMA读取6字节完成
+  PROFILE_STAGE_RX_CPLT,
+  // 原始数据转换为温湿度
+  PROFILE_STAGE_CONVERT,
+  // 组好发往ESP01S的帧
+  PROFILE_STAGE_FRAME_BUILD,
+  // ESP01S回复ACK
+  PROFILE_STAGE_LINK_ACK,
+  PROFILE_STAGE_COUNT
+} ProfileStage;
+
+typedef struct {
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t total_us;
+  uint16_t histogram[PROFILER_HISTOGRAM_BUCKETS];
+} ProfileStageStats;
+
+void profiler_init(void);
+void profiler_reset(void);
+/**
+ * @brief 开始一次新的采样链路计时
+ */
+void profiler_begin(void);
+/**
+ * @brief 记录某阶段结束 耗时为距上一次打点的时间
+ */
+void profiler_mark(ProfileStage stage);
+void profiler_get_stats(ProfileStage stage, ProfileStageStats *stats);
+/**
+ * @brief 把所有阶段的统计以文本形式通过UART发送出去
+ */
+void profiler_dump(UART_HandleTypeDef *huart);
+
+#if PROFILER_ENABLED
+#define PROFILE_BEGIN() profiler_begin()
+#define PROFILE_MARK(stage) profiler_mark(stage)
+#else
+#define PROFILE_BEGIN() ((void)0)
+#define PROFILE_MARK(stage) ((void)0)
+#endif
+
+#endif /* __PROFILER_H */
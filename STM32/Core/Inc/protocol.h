@@ -0,0 +1,824 @@
+/* 由Protocol/generate.py根据Protocol/protocol.json生成 不要手动修改 */
+#ifndef __PROTOCOL_H
+#define __PROTOCOL_H
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+手机(蓝牙) STM32 ESP01S之间的帧格式 所有帧为 id checksum 字段... \r\n 多字节字段为小端
+*/
+#define PROTOCOL_HEADER_SIZE 2U
+#define PROTOCOL_TRAILER_SIZE 2U
+/* STM32的MsgBuffer按它分配 最长的WIFI配置帧正好装下 */
+#define PROTOCOL_MAX_FRAME_SIZE 101U
+/* 802.11规定SSID最长32字节 */
+#define PROTOCOL_SSID_MAX_LENGTH 32U
+/* WPA2口令最长63字节 */
+#define PROTOCOL_PASSWORD_MAX_LENGTH 63U
+/* humidity_centi的上限 flash日志也用它判断记录是否写完 */
+#define PROTOCOL_HUMIDITY_CENTI_MAX 10000U
+
+/**
+ * @brief 修正表命令的操作
+ */
+typedef enum {
+  // 清空暂存表
+  PROTOCOL_CALIBRATION_OP_BEGIN = 0,
+  // 写入暂存表中的一段点
+  PROTOCOL_CALIBRATION_OP_WRITE = 1,
+  // 写入flash并生效
+  PROTOCOL_CALIBRATION_OP_COMMIT = 2,
+  // 擦除修正表
+  PROTOCOL_CALIBRATION_OP_CLEAR = 3,
+} ProtocolCalibrationOp;
+
+/**
+ * @brief 修正表中的子表
+ */
+typedef enum {
+  // 只随温度变化的温度修正量
+  PROTOCOL_CALIBRATION_TABLE_TEMPERATURE = 0,
+  // 随温度和湿度变化的湿度修正量
+  PROTOCOL_CALIBRATION_TABLE_HUMIDITY = 1,
+} ProtocolCalibrationTable;
+
+/**
+ * @brief flash中缓存的一条样本
+ */
+typedef struct __attribute__((packed)) {
+  uint16_t sequence;
+  int16_t temperature_centi;  // 摄氏度 * 100
+  uint16_t humidity_centi;  // %RH * 100
+  uint32_t timestamp;  // Unix时间 秒 未同步时为0
+} ProtocolSampleRecord;
+_Static_assert(sizeof(ProtocolSampleRecord) == 10, "ProtocolSampleRecord layout");
+
+/**
+ * @brief 帧中除checksum外所有字节之和取反 checksum字节本身按0计算
+ */
+static inline uint8_t protocol_checksum(const uint8_t frame[], uint16_t length) {
+  uint8_t sum = 0;
+  for (uint16_t i = 0; i < length; i++) {
+    sum += frame[i];
+  }
+  return (uint8_t)~(uint8_t)(sum - frame[1]);
+}
+
+/**
+ * @brief 在body后追加\r\n并填写checksum
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_seal(uint8_t frame[], uint16_t body_length) {
+  frame[body_length] = '\r';
+  frame[body_length + 1] = '\n';
+  uint16_t length = body_length + PROTOCOL_TRAILER_SIZE;
+  frame[1] = protocol_checksum(frame, length);
+  return length;
+}
+
+/**
+ * @brief 以\r\n结尾 且所有字节之和为0xFF
+ */
+static inline uint8_t protocol_is_valid(const uint8_t frame[], uint16_t length) {
+  if (length < PROTOCOL_HEADER_SIZE + PROTOCOL_TRAILER_SIZE ||
+      frame[length - 2] != '\r' || frame[length - 1] != '\n') {
+    return 0;
+  }
+  uint8_t sum = 0;
+  for (uint16_t i = 0; i < length; i++) {
+    sum += frame[i];
+  }
+  return sum == 0xFF;
+}
+
+/**
+ * @brief 摄氏度换算为temperature_centi 四舍五入 超出int16时取边界
+ * 实时帧 flash日志 推送和Modbus用同一种舍入 同一个样本在各处的值一致
+ */
+static inline int16_t protocol_temperature_centi(float celsius) {
+  float centi = celsius * 100.0f;
+  if (!(centi > INT16_MIN)) {
+    return INT16_MIN;
+  }
+  if (centi > INT16_MAX) {
+    return INT16_MAX;
+  }
+  return (int16_t)lroundf(centi);
+}
+
+/**
+ * @brief %RH换算为humidity_centi 四舍五入 限制在0到PROTOCOL_HUMIDITY_CENTI_MAX
+ */
+static inline uint16_t protocol_humidity_centi(float percent) {
+  float centi = percent * 100.0f;
+  if (!(centi > 0.0f)) {
+    return 0;
+  }
+  if (centi > PROTOCOL_HUMIDITY_CENTI_MAX) {
+    return PROTOCOL_HUMIDITY_CENTI_MAX;
+  }
+  return (uint16_t)lroundf(centi);
+}
+
+/* ---- phone: 手机通过蓝牙串口(USART3)与STM32通信 ---- */
+
+/**
+ * @brief 触发AHT20测量 (->)
+ */
+#define PROTOCOL_PHONE_MEASURE_ID 0x00U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+} ProtocolPhoneMeasure;
+_Static_assert(sizeof(ProtocolPhoneMeasure) == 2, "ProtocolPhoneMeasure layout");
+#define PROTOCOL_PHONE_MEASURE_SIZE 4U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolPhoneMeasure *
+protocol_phone_measure_view(const uint8_t frame[], uint16_t length) {
+  if (length != PROTOCOL_PHONE_MEASURE_SIZE ||
+      frame[0] != PROTOCOL_PHONE_MEASURE_ID) {
+    return NULL;
+  }
+  return (const ProtocolPhoneMeasure *)frame;
+}
+
+/**
+ * @brief 编码整帧
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_phone_measure_pack(uint8_t frame[]) {
+  ProtocolPhoneMeasure *message = (ProtocolPhoneMeasure *)frame;
+  message->id = PROTOCOL_PHONE_MEASURE_ID;
+  return protocol_seal(frame, sizeof(*message));
+}
+
+/**
+ * @brief 设置ESP01S的WIFI连接信息 (->)
+ */
+#define PROTOCOL_PHONE_SET_WIFI_ID 0x01U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint8_t ssid_length;
+  uint8_t password_length;
+  uint8_t text[];  // ssid后紧跟password 都不带结尾的0
+} ProtocolPhoneSetWifi;
+_Static_assert(sizeof(ProtocolPhoneSetWifi) == 4, "ProtocolPhoneSetWifi layout");
+#define PROTOCOL_PHONE_SET_WIFI_MAX_SSID_LENGTH 32U
+#define PROTOCOL_PHONE_SET_WIFI_MAX_PASSWORD_LENGTH 63U
+#define PROTOCOL_PHONE_SET_WIFI_SIZE(count) \
+  (sizeof(ProtocolPhoneSetWifi) + (count) * sizeof(uint8_t) + PROTOCOL_TRAILER_SIZE)
+#define PROTOCOL_PHONE_SET_WIFI_MAX_SIZE 101U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolPhoneSetWifi *
+protocol_phone_set_wifi_view(const uint8_t frame[], uint16_t length) {
+  if (length < PROTOCOL_PHONE_SET_WIFI_SIZE(0) ||
+      frame[0] != PROTOCOL_PHONE_SET_WIFI_ID) {
+    return NULL;
+  }
+  const ProtocolPhoneSetWifi *message = (const ProtocolPhoneSetWifi *)frame;
+  if (message->ssid_length > PROTOCOL_PHONE_SET_WIFI_MAX_SSID_LENGTH ||
+      message->password_length > PROTOCOL_PHONE_SET_WIFI_MAX_PASSWORD_LENGTH ||
+      length != PROTOCOL_PHONE_SET_WIFI_SIZE(message->ssid_length + message->password_length)) {
+    return NULL;
+  }
+  return message;
+}
+
+/**
+ * @brief 写好帧头 之后直接在缓冲中填写字段和tail 最后调用seal
+ */
+static inline ProtocolPhoneSetWifi *protocol_phone_set_wifi_init(uint8_t frame[]) {
+  ProtocolPhoneSetWifi *message = (ProtocolPhoneSetWifi *)frame;
+  message->id = PROTOCOL_PHONE_SET_WIFI_ID;
+  return message;
+}
+
+/**
+ * @brief 按计数字段确定长度 追加\r\n和checksum
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_phone_set_wifi_seal(uint8_t frame[]) {
+  const ProtocolPhoneSetWifi *message = (const ProtocolPhoneSetWifi *)frame;
+  uint16_t length = PROTOCOL_PHONE_SET_WIFI_SIZE(message->ssid_length + message->password_length);
+  return protocol_seal(frame, length - PROTOCOL_TRAILER_SIZE);
+}
+
+/**
+ * @brief 输出各阶段耗时统计 (->)
+ */
+#define PROTOCOL_PHONE_PROFILE_DUMP_ID 0x02U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint8_t reset;  // 为1时输出后清零
+} ProtocolPhoneProfileDump;
+_Static_assert(sizeof(ProtocolPhoneProfileDump) == 3, "ProtocolPhoneProfileDump layout");
+#define PROTOCOL_PHONE_PROFILE_DUMP_SIZE 5U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolPhoneProfileDump *
+protocol_phone_profile_dump_view(const uint8_t frame[], uint16_t length) {
+  if (length != PROTOCOL_PHONE_PROFILE_DUMP_SIZE ||
+      frame[0] != PROTOCOL_PHONE_PROFILE_DUMP_ID) {
+    return NULL;
+  }
+  return (const ProtocolPhoneProfileDump *)frame;
+}
+
+/**
+ * @brief 编码整帧
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_phone_profile_dump_pack(
+    uint8_t frame[], uint8_t reset) {
+  ProtocolPhoneProfileDump *message = (ProtocolPhoneProfileDump *)frame;
+  message->id = PROTOCOL_PHONE_PROFILE_DUMP_ID;
+  message->reset = reset;
+  return protocol_seal(frame, sizeof(*message));
+}
+
+/**
+ * @brief 订阅二进制样本推送 (->)
+ */
+#define PROTOCOL_PHONE_SUBSCRIBE_ID 0x03U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint16_t interval_ms;  // 采样间隔 0为取消订阅
+} ProtocolPhoneSubscribe;
+_Static_assert(sizeof(ProtocolPhoneSubscribe) == 4, "ProtocolPhoneSubscribe layout");
+#define PROTOCOL_PHONE_SUBSCRIBE_SIZE 6U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolPhoneSubscribe *
+protocol_phone_subscribe_view(const uint8_t frame[], uint16_t length) {
+  if (length != PROTOCOL_PHONE_SUBSCRIBE_SIZE ||
+      frame[0] != PROTOCOL_PHONE_SUBSCRIBE_ID) {
+    return NULL;
+  }
+  return (const ProtocolPhoneSubscribe *)frame;
+}
+
+/**
+ * @brief 编码整帧
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_phone_subscribe_pack(
+    uint8_t frame[], uint16_t interval_ms) {
+  ProtocolPhoneSubscribe *message = (ProtocolPhoneSubscribe *)frame;
+  message->id = PROTOCOL_PHONE_SUBSCRIBE_ID;
+  message->interval_ms = interval_ms;
+  return protocol_seal(frame, sizeof(*message));
+}
+
+/**
+ * @brief 修改USART3波特率 先用旧波特率回复ACK再切换 (->)
+ */
+#define PROTOCOL_PHONE_SET_BAUD_ID 0x04U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint32_t baud_rate;
+} ProtocolPhoneSetBaud;
+_Static_assert(sizeof(ProtocolPhoneSetBaud) == 6, "ProtocolPhoneSetBaud layout");
+#define PROTOCOL_PHONE_SET_BAUD_SIZE 8U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolPhoneSetBaud *
+protocol_phone_set_baud_view(const uint8_t frame[], uint16_t length) {
+  if (length != PROTOCOL_PHONE_SET_BAUD_SIZE ||
+      frame[0] != PROTOCOL_PHONE_SET_BAUD_ID) {
+    return NULL;
+  }
+  return (const ProtocolPhoneSetBaud *)frame;
+}
+
+/**
+ * @brief 编码整帧
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_phone_set_baud_pack(
+    uint8_t frame[], uint32_t baud_rate) {
+  ProtocolPhoneSetBaud *message = (ProtocolPhoneSetBaud *)frame;
+  message->id = PROTOCOL_PHONE_SET_BAUD_ID;
+  message->baud_rate = baud_rate;
+  return protocol_seal(frame, sizeof(*message));
+}
+
+/**
+ * @brief 修正表的begin commit clear操作 (->)
+ */
+#define PROTOCOL_PHONE_CALIBRATION_CONTROL_ID 0x05U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint8_t op;  // ProtocolCalibrationOp
+} ProtocolPhoneCalibrationControl;
+_Static_assert(sizeof(ProtocolPhoneCalibrationControl) == 3, "ProtocolPhoneCalibrationControl layout");
+#define PROTOCOL_PHONE_CALIBRATION_CONTROL_SIZE 5U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolPhoneCalibrationControl *
+protocol_phone_calibration_control_view(const uint8_t frame[], uint16_t length) {
+  if (length != PROTOCOL_PHONE_CALIBRATION_CONTROL_SIZE ||
+      frame[0] != PROTOCOL_PHONE_CALIBRATION_CONTROL_ID) {
+    return NULL;
+  }
+  return (const ProtocolPhoneCalibrationControl *)frame;
+}
+
+/**
+ * @brief 编码整帧
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_phone_calibration_control_pack(
+    uint8_t frame[], uint8_t op) {
+  ProtocolPhoneCalibrationControl *message = (ProtocolPhoneCalibrationControl *)frame;
+  message->id = PROTOCOL_PHONE_CALIBRATION_CONTROL_ID;
+  message->op = op;
+  return protocol_seal(frame, sizeof(*message));
+}
+
+/**
+ * @brief 修正表的write操作 一帧最多22个点 湿度网格要分两次写 (->)
+ */
+#define PROTOCOL_PHONE_CALIBRATION_WRITE_ID 0x05U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint8_t op;  // ProtocolCalibrationOp
+  uint8_t table;  // ProtocolCalibrationTable
+  uint8_t start;
+  uint8_t count;
+  int32_t values[];  // q31
+} ProtocolPhoneCalibrationWrite;
+_Static_assert(sizeof(ProtocolPhoneCalibrationWrite) == 6, "ProtocolPhoneCalibrationWrite layout");
+#define PROTOCOL_PHONE_CALIBRATION_WRITE_MAX_COUNT 22U
+#define PROTOCOL_PHONE_CALIBRATION_WRITE_SIZE(count) \
+  (sizeof(ProtocolPhoneCalibrationWrite) + (count) * sizeof(int32_t) + PROTOCOL_TRAILER_SIZE)
+#define PROTOCOL_PHONE_CALIBRATION_WRITE_MAX_SIZE 96U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolPhoneCalibrationWrite *
+protocol_phone_calibration_write_view(const uint8_t frame[], uint16_t length) {
+  if (length < PROTOCOL_PHONE_CALIBRATION_WRITE_SIZE(0) ||
+      frame[0] != PROTOCOL_PHONE_CALIBRATION_WRITE_ID) {
+    return NULL;
+  }
+  const ProtocolPhoneCalibrationWrite *message = (const ProtocolPhoneCalibrationWrite *)frame;
+  if (message->count > PROTOCOL_PHONE_CALIBRATION_WRITE_MAX_COUNT ||
+      length != PROTOCOL_PHONE_CALIBRATION_WRITE_SIZE(message->count)) {
+    return NULL;
+  }
+  return message;
+}
+
+/**
+ * @brief 写好帧头 之后直接在缓冲中填写字段和tail 最后调用seal
+ */
+static inline ProtocolPhoneCalibrationWrite *protocol_phone_calibration_write_init(uint8_t frame[]) {
+  ProtocolPhoneCalibrationWrite *message = (ProtocolPhoneCalibrationWrite *)frame;
+  message->id = PROTOCOL_PHONE_CALIBRATION_WRITE_ID;
+  return message;
+}
+
+/**
+ * @brief 按计数字段确定长度 追加\r\n和checksum
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_phone_calibration_write_seal(uint8_t frame[]) {
+  const ProtocolPhoneCalibrationWrite *message = (const ProtocolPhoneCalibrationWrite *)frame;
+  uint16_t length = PROTOCOL_PHONE_CALIBRATION_WRITE_SIZE(message->count);
+  return protocol_seal(frame, length - PROTOCOL_TRAILER_SIZE);
+}
+
+/**
+ * @brief 订阅模式下推送的样本 帧头与命令字不重叠 (<-)
+ */
+#define PROTOCOL_PHONE_STREAM_SAMPLE_ID 0x10U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint16_t sequence;
+  int16_t temperature_centi;
+  uint16_t humidity_centi;
+  uint32_t timestamp;  // Unix时间 秒 未同步时为0
+  uint8_t coalesced;  // 上一帧之后被合并掉的样本数
+} ProtocolPhoneStreamSample;
+_Static_assert(sizeof(ProtocolPhoneStreamSample) == 13, "ProtocolPhoneStreamSample layout");
+#define PROTOCOL_PHONE_STREAM_SAMPLE_SIZE 15U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolPhoneStreamSample *
+protocol_phone_stream_sample_view(const uint8_t frame[], uint16_t length) {
+  if (length != PROTOCOL_PHONE_STREAM_SAMPLE_SIZE ||
+      frame[0] != PROTOCOL_PHONE_STREAM_SAMPLE_ID) {
+    return NULL;
+  }
+  return (const ProtocolPhoneStreamSample *)frame;
+}
+
+/**
+ * @brief 编码整帧
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_phone_stream_sample_pack(
+    uint8_t frame[], uint16_t sequence, int16_t temperature_centi, uint16_t humidity_centi, uint32_t timestamp, uint8_t coalesced) {
+  ProtocolPhoneStreamSample *message = (ProtocolPhoneStreamSample *)frame;
+  message->id = PROTOCOL_PHONE_STREAM_SAMPLE_ID;
+  message->sequence = sequence;
+  message->temperature_centi = temperature_centi;
+  message->humidity_centi = humidity_centi;
+  message->timestamp = timestamp;
+  message->coalesced = coalesced;
+  return protocol_seal(frame, sizeof(*message));
+}
+
+/* ---- esp: STM32通过USART2与ESP01S通信 ESP01S对每帧回复ACK\r\n ---- */
+
+/**
+ * @brief 转发手机设置的WIFI连接信息 (->)
+ */
+#define PROTOCOL_ESP_WIFI_CONFIG_ID 0x00U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint8_t ssid_length;
+  uint8_t password_length;
+  uint8_t text[];  // ssid后紧跟password 都不带结尾的0
+} ProtocolEspWifiConfig;
+_Static_assert(sizeof(ProtocolEspWifiConfig) == 4, "ProtocolEspWifiConfig layout");
+#define PROTOCOL_ESP_WIFI_CONFIG_MAX_SSID_LENGTH 32U
+#define PROTOCOL_ESP_WIFI_CONFIG_MAX_PASSWORD_LENGTH 63U
+#define PROTOCOL_ESP_WIFI_CONFIG_SIZE(count) \
+  (sizeof(ProtocolEspWifiConfig) + (count) * sizeof(uint8_t) + PROTOCOL_TRAILER_SIZE)
+#define PROTOCOL_ESP_WIFI_CONFIG_MAX_SIZE 101U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolEspWifiConfig *
+protocol_esp_wifi_config_view(const uint8_t frame[], uint16_t length) {
+  if (length < PROTOCOL_ESP_WIFI_CONFIG_SIZE(0) ||
+      frame[0] != PROTOCOL_ESP_WIFI_CONFIG_ID) {
+    return NULL;
+  }
+  const ProtocolEspWifiConfig *message = (const ProtocolEspWifiConfig *)frame;
+  if (message->ssid_length > PROTOCOL_ESP_WIFI_CONFIG_MAX_SSID_LENGTH ||
+      message->password_length > PROTOCOL_ESP_WIFI_CONFIG_MAX_PASSWORD_LENGTH ||
+      length != PROTOCOL_ESP_WIFI_CONFIG_SIZE(message->ssid_length + message->password_length)) {
+    return NULL;
+  }
+  return message;
+}
+
+/**
+ * @brief 写好帧头 之后直接在缓冲中填写字段和tail 最后调用seal
+ */
+static inline ProtocolEspWifiConfig *protocol_esp_wifi_config_init(uint8_t frame[]) {
+  ProtocolEspWifiConfig *message = (ProtocolEspWifiConfig *)frame;
+  message->id = PROTOCOL_ESP_WIFI_CONFIG_ID;
+  return message;
+}
+
+/**
+ * @brief 按计数字段确定长度 追加\r\n和checksum
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_esp_wifi_config_seal(uint8_t frame[]) {
+  const ProtocolEspWifiConfig *message = (const ProtocolEspWifiConfig *)frame;
+  uint16_t length = PROTOCOL_ESP_WIFI_CONFIG_SIZE(message->ssid_length + message->password_length);
+  return protocol_seal(frame, length - PROTOCOL_TRAILER_SIZE);
+}
+
+/**
+ * @brief 一个实时样本 (->)
+ */
+#define PROTOCOL_ESP_SAMPLE_ID 0x01U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  float temperature;
+  float humidity;
+  uint32_t timestamp;  // Unix时间 秒 未同步时为0
+} ProtocolEspSample;
+_Static_assert(sizeof(ProtocolEspSample) == 14, "ProtocolEspSample layout");
+#define PROTOCOL_ESP_SAMPLE_SIZE 16U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolEspSample *
+protocol_esp_sample_view(const uint8_t frame[], uint16_t length) {
+  if (length != PROTOCOL_ESP_SAMPLE_SIZE ||
+      frame[0] != PROTOCOL_ESP_SAMPLE_ID) {
+    return NULL;
+  }
+  return (const ProtocolEspSample *)frame;
+}
+
+/**
+ * @brief 编码整帧
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_esp_sample_pack(
+    uint8_t frame[], float temperature, float humidity, uint32_t timestamp) {
+  ProtocolEspSample *message = (ProtocolEspSample *)frame;
+  message->id = PROTOCOL_ESP_SAMPLE_ID;
+  message->temperature = temperature;
+  message->humidity = humidity;
+  message->timestamp = timestamp;
+  return protocol_seal(frame, sizeof(*message));
+}
+
+/**
+ * @brief 带追踪信息的实时样本 每次重传前更新age_us并重新计算checksum (->)
+ */
+#define PROTOCOL_ESP_TRACED_SAMPLE_ID 0x04U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  float temperature;
+  float humidity;
+  uint32_t timestamp;  // Unix时间 秒 未同步时为0
+  uint16_t trace_id;  // 每次测量加1 跳过0
+  uint32_t conversion_us;  // 从发出测量命令到换算完成
+  uint32_t age_us;  // 从换算完成到这次发送开始 含排队和重传
+} ProtocolEspTracedSample;
+_Static_assert(sizeof(ProtocolEspTracedSample) == 24, "ProtocolEspTracedSample layout");
+#define PROTOCOL_ESP_TRACED_SAMPLE_SIZE 26U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolEspTracedSample *
+protocol_esp_traced_sample_view(const uint8_t frame[], uint16_t length) {
+  if (length != PROTOCOL_ESP_TRACED_SAMPLE_SIZE ||
+      frame[0] != PROTOCOL_ESP_TRACED_SAMPLE_ID) {
+    return NULL;
+  }
+  return (const ProtocolEspTracedSample *)frame;
+}
+
+/**
+ * @brief 编码整帧
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_esp_traced_sample_pack(
+    uint8_t frame[], float temperature, float humidity, uint32_t timestamp, uint16_t trace_id, uint32_t conversion_us, uint32_t age_us) {
+  ProtocolEspTracedSample *message = (ProtocolEspTracedSample *)frame;
+  message->id = PROTOCOL_ESP_TRACED_SAMPLE_ID;
+  message->temperature = temperature;
+  message->humidity = humidity;
+  message->timestamp = timestamp;
+  message->trace_id = trace_id;
+  message->conversion_us = conversion_us;
+  message->age_us = age_us;
+  return protocol_seal(frame, sizeof(*message));
+}
+
+/**
+ * @brief 补发链路断开期间缓存在flash中的样本 按时间顺序 (->)
+ */
+#define PROTOCOL_ESP_SAMPLE_BATCH_ID 0x02U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint8_t count;
+  ProtocolSampleRecord records[];
+} ProtocolEspSampleBatch;
+_Static_assert(sizeof(ProtocolEspSampleBatch) == 3, "ProtocolEspSampleBatch layout");
+#define PROTOCOL_ESP_SAMPLE_BATCH_MAX_COUNT 9U
+#define PROTOCOL_ESP_SAMPLE_BATCH_SIZE(count) \
+  (sizeof(ProtocolEspSampleBatch) + (count) * sizeof(ProtocolSampleRecord) + PROTOCOL_TRAILER_SIZE)
+#define PROTOCOL_ESP_SAMPLE_BATCH_MAX_SIZE 95U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolEspSampleBatch *
+protocol_esp_sample_batch_view(const uint8_t frame[], uint16_t length) {
+  if (length < PROTOCOL_ESP_SAMPLE_BATCH_SIZE(0) ||
+      frame[0] != PROTOCOL_ESP_SAMPLE_BATCH_ID) {
+    return NULL;
+  }
+  const ProtocolEspSampleBatch *message = (const ProtocolEspSampleBatch *)frame;
+  if (message->count > PROTOCOL_ESP_SAMPLE_BATCH_MAX_COUNT ||
+      length != PROTOCOL_ESP_SAMPLE_BATCH_SIZE(message->count)) {
+    return NULL;
+  }
+  return message;
+}
+
+/**
+ * @brief 写好帧头 之后直接在缓冲中填写字段和tail 最后调用seal
+ */
+static inline ProtocolEspSampleBatch *protocol_esp_sample_batch_init(uint8_t frame[]) {
+  ProtocolEspSampleBatch *message = (ProtocolEspSampleBatch *)frame;
+  message->id = PROTOCOL_ESP_SAMPLE_BATCH_ID;
+  return message;
+}
+
+/**
+ * @brief 按计数字段确定长度 追加\r\n和checksum
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_esp_sample_batch_seal(uint8_t frame[]) {
+  const ProtocolEspSampleBatch *message = (const ProtocolEspSampleBatch *)frame;
+  uint16_t length = PROTOCOL_ESP_SAMPLE_BATCH_SIZE(message->count);
+  return protocol_seal(frame, length - PROTOCOL_TRAILER_SIZE);
+}
+
+/**
+ * @brief 请求ESP01S的当前时间 ESP01S用time_reply代替ACK (->)
+ */
+#define PROTOCOL_ESP_TIME_REQUEST_ID 0x03U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+} ProtocolEspTimeRequest;
+_Static_assert(sizeof(ProtocolEspTimeRequest) == 2, "ProtocolEspTimeRequest layout");
+#define PROTOCOL_ESP_TIME_REQUEST_SIZE 4U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolEspTimeRequest *
+protocol_esp_time_request_view(const uint8_t frame[], uint16_t length) {
+  if (length != PROTOCOL_ESP_TIME_REQUEST_SIZE ||
+      frame[0] != PROTOCOL_ESP_TIME_REQUEST_ID) {
+    return NULL;
+  }
+  return (const ProtocolEspTimeRequest *)frame;
+}
+
+/**
+ * @brief 编码整帧
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_esp_time_request_pack(uint8_t frame[]) {
+  ProtocolEspTimeRequest *message = (ProtocolEspTimeRequest *)frame;
+  message->id = PROTOCOL_ESP_TIME_REQUEST_ID;
+  return protocol_seal(frame, sizeof(*message));
+}
+
+/**
+ * @brief ESP01S的当前时间 (<-)
+ */
+#define PROTOCOL_ESP_TIME_REPLY_ID 0x03U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint32_t epoch_seconds;  // 为0表示主站还没设置过时间
+  uint16_t milliseconds;
+} ProtocolEspTimeReply;
+_Static_assert(sizeof(ProtocolEspTimeReply) == 8, "ProtocolEspTimeReply layout");
+#define PROTOCOL_ESP_TIME_REPLY_SIZE 10U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolEspTimeReply *
+protocol_esp_time_reply_view(const uint8_t frame[], uint16_t length) {
+  if (length != PROTOCOL_ESP_TIME_REPLY_SIZE ||
+      frame[0] != PROTOCOL_ESP_TIME_REPLY_ID) {
+    return NULL;
+  }
+  return (const ProtocolEspTimeReply *)frame;
+}
+
+/**
+ * @brief 编码整帧
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_esp_time_reply_pack(
+    uint8_t frame[], uint32_t epoch_seconds, uint16_t milliseconds) {
+  ProtocolEspTimeReply *message = (ProtocolEspTimeReply *)frame;
+  message->id = PROTOCOL_ESP_TIME_REPLY_ID;
+  message->epoch_seconds = epoch_seconds;
+  message->milliseconds = milliseconds;
+  return protocol_seal(frame, sizeof(*message));
+}
+
+/* ---- push: ESP01S通过MQTT或UDP主动推送样本 一帧就是一条MQTT消息或一个UDP数据报 ---- */
+
+/**
+ * @brief 一批样本 按时间顺序 实时样本的sequence为0 (<-)
+ */
+#define PROTOCOL_PUSH_SAMPLES_ID 0x20U
+typedef struct __attribute__((packed)) {
+  uint8_t id;
+  uint8_t checksum;
+  uint16_t sequence;  // 每发一帧加1 接收端据此发现丢失
+  uint8_t count;
+  ProtocolSampleRecord records[];
+} ProtocolPushSamples;
+_Static_assert(sizeof(ProtocolPushSamples) == 5, "ProtocolPushSamples layout");
+#define PROTOCOL_PUSH_SAMPLES_MAX_COUNT 9U
+#define PROTOCOL_PUSH_SAMPLES_SIZE(count) \
+  (sizeof(ProtocolPushSamples) + (count) * sizeof(ProtocolSampleRecord) + PROTOCOL_TRAILER_SIZE)
+#define PROTOCOL_PUSH_SAMPLES_MAX_SIZE 97U
+
+/**
+ * @brief 在接收缓冲上直接解析 不检查checksum
+ *
+ * @return 格式不对时返回NULL
+ */
+static inline const ProtocolPushSamples *
+protocol_push_samples_view(const uint8_t frame[], uint16_t length) {
+  if (length < PROTOCOL_PUSH_SAMPLES_SIZE(0) ||
+      frame[0] != PROTOCOL_PUSH_SAMPLES_ID) {
+    return NULL;
+  }
+  const ProtocolPushSamples *message = (const ProtocolPushSamples *)frame;
+  if (message->count > PROTOCOL_PUSH_SAMPLES_MAX_COUNT ||
+      length != PROTOCOL_PUSH_SAMPLES_SIZE(message->count)) {
+    return NULL;
+  }
+  return message;
+}
+
+/**
+ * @brief 写好帧头 之后直接在缓冲中填写字段和tail 最后调用seal
+ */
+static inline ProtocolPushSamples *protocol_push_samples_init(uint8_t frame[]) {
+  ProtocolPushSamples *message = (ProtocolPushSamples *)frame;
+  message->id = PROTOCOL_PUSH_SAMPLES_ID;
+  return message;
+}
+
+/**
+ * @brief 按计数字段确定长度 追加\r\n和checksum
+ *
+ * @return 整帧长度
+ */
+static inline uint16_t protocol_push_samples_seal(uint8_t frame[]) {
+  const ProtocolPushSamples *message = (const ProtocolPushSamples *)frame;
+  uint16_t length = PROTOCOL_PUSH_SAMPLES_SIZE(message->count);
+  return protocol_seal(frame, length - PROTOCOL_TRAILER_SIZE);
+}
+
+#endif /* __PROTOCOL_H */
@@ -0,0 +1,62 @@
+#ifndef __SAMPLE_LOG_H
+#define __SAMPLE_LOG_H
+#include "main.h"
+#include "protocol.h"
+#include <stdint.h>
+
+/* 与链接脚本中的SAMPLE_LOG区域一致 */
+#define SAMPLE_LOG_START_ADDRESS 0x0800E000U
+#define SAMPLE_LOG_PAGE_COUNT 8U
+/* 记录中加入时间戳后换了magic 旧格式的页按无效页处理 */
+#define SAMPLE_LOG_MAGIC 0x32474C53U /* "SLG2" */
+/* 一批补发的样本数 受限于通信缓冲: 3字节头 + 9*10字节 + \r\n */
+#define SAMPLE_LOG_BATCH_SIZE PROTOCOL_ESP_SAMPLE_BATCH_MAX_COUNT
+
+/**
+ * @brief 每页开头的页头 page_sequence越大页越新
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t page_sequence;
+} SampleLogPageHeader;
+
+/**
+ * @brief 一条样本 12字节 按字段顺序写入
+ * humidity最后写入 它是合法值(<=PROTOCOL_HUMIDITY_CENTI_MAX)即表示整条记录完整
+ * status为0xFFFF表示未发送 F1允许在已写入的半字上再写0x0000 用来标记已发送
+ */
+typedef struct {
+  uint16_t sequence;
+  int16_t temperature;   // 摄氏度 * 100
+  uint32_t timestamp;    // Unix时间 秒 未同步时为0
+  uint16_t humidity;     // %RH * 100
+  uint16_t status;
+} SampleLogRecord;
+
+#define SAMPLE_LOG_RECORDS_PER_PAGE                                            \
+  ((FLASH_PAGE_SIZE - sizeof(SampleLogPageHeader)) / sizeof(SampleLogRecord))
+
+/**
+ * @brief 上电时扫描日志区 恢复写指针和补发位置
+ */
+void sample_log_init(void);
+/**
+ * @brief 追加一条样本 温湿度按protocol_temperature_centi等四舍五入
+ * 写指针后面的一页在空闲时预先擦除 换页时只写页头
+ * 预擦除还没做完时才在这里同步擦除
+ */
+HAL_StatusTypeDef sample_log_append(float temperature, float humidity,
+                                    uint32_t timestamp);
+uint8_t sample_log_has_pending(void);
+/**
+ * @brief 从最早的未发送样本开始 取出最多max_count条 不改变补发位置
+ *
+ * @return 取出的条数
+ */
+uint8_t sample_log_peek_batch(SampleLogRecord records[], uint8_t max_count);
+/**
+ * @brief 把上一次peek取出的样本标记为已发送
+ */
+void sample_log_commit_batch(void);
+
+#endif /* __SAMPLE_LOG_H */
@@ -0,0 +1,66 @@
+#ifndef __SCHEDULER_H
+#define __SCHEDULER_H
+#include "main.h"
+#include <stdint.h>
+
+/**
+ * @brief 事件按优先级从高到低排列 同时挂起时先处理靠前的
+ * 中断里只投递事件 实际工作都在主循环中逐个执行完
+ */
+typedef enum {
+  // 采集: AHT20上电初始化的下一步 参数为I2CEngineStatus
+  EVENT_SENSOR_BOOT = 0,
+  // 采集: AHT20触发命令发送完成 参数为I2CEngineStatus
+  EVENT_SENSOR_TRIGGERED,
+  // 采集: 75ms测量等待结束
+  EVENT_SENSOR_WAIT_DONE,
+  // 采集: 读出6字节结果 参数为I2CEngineStatus
+  EVENT_SENSOR_READ_DONE,
+  // 链路: 收到ESP01S的应答 参数为接收长度
+  EVENT_LINK_RX,
+  // 链路: 等待应答超时
+  EVENT_LINK_TIMEOUT,
+  // 命令: 收到一条蓝牙命令 参数为接收长度
+  EVENT_COMMAND_RECEIVED,
+  // 订阅: 到了下一次采样推送的时间
+  EVENT_STREAM_TICK,
+  // 时间: 向ESP01S请求参考时间
+  EVENT_TIME_SYNC,
+  // 日志: 链路和命令接收空闲时预先擦除下一页
+  EVENT_SAMPLE_LOG_ERASE,
+  // 电源: 上电后轮询外部晶振是否起振
+  EVENT_POWER_HSE_PROBE,
+  // 监督: 检查任务心跳并喂狗 优先级最低 其他事件积压时也会被推迟
+  EVENT_SUPERVISOR_TICK,
+  EVENT_COUNT
+} SchedulerEvent;
+
+/**
+ * @brief 事件处理函数 必须很快返回 不能阻塞等待
+ */
+typedef void (*SchedulerHandler)(uint32_t arg);
+
+void scheduler_init(void);
+void scheduler_register(SchedulerEvent event, SchedulerHandler handler);
+/**
+ * @brief 中断中也可以调用 事件未处理前重复投递只保留最后一次的参数
+ */
+void scheduler_post(SchedulerEvent event, uint32_t arg);
+/**
+ * @brief delay_ms后投递event period_ms不为0时之后按周期重复
+ * 每个事件只有一个定时器 重新启动会覆盖之前的设置
+ */
+void scheduler_start_timer(SchedulerEvent event, uint32_t delay_ms,
+                           uint32_t period_ms);
+void scheduler_stop_timer(SchedulerEvent event);
+/**
+ * @brief 处理一个最高优先级的事件 没有事件时进入Sleep
+ * 在主循环中反复调用
+ */
+void scheduler_dispatch(void);
+/**
+ * @brief 在SysTick中每1ms调用一次
+ */
+void scheduler_tick(void);
+
+#endif /* __SCHEDULER_H */
@@ -0,0 +1,29 @@
+#ifndef __STREAM_H
+#define __STREAM_H
+#include "main.h"
+#include <stdint.h>
+
+/* 一次测量约80ms 间隔不能比这个更短 */
+#define STREAM_MIN_INTERVAL_MS 100U
+
+/**
+ * @brief 注册定时采样事件
+ */
+void stream_init(void);
+/**
+ * @brief 按interval_ms周期采样并推送二进制帧 为0时取消订阅
+ */
+void stream_subscribe(uint16_t interval_ms);
+uint8_t stream_is_active(void);
+/**
+ * @brief 每个样本完成后调用 发送队列未空时只保留最新的样本
+ */
+void stream_on_sample(float temperature, float humidity, uint32_t timestamp);
+/**
+ * @brief 修改USART3波特率 调用前需要等发送队列清空
+ *
+ * @return 不支持的波特率返回HAL_ERROR
+ */
+HAL_StatusTypeDef stream_set_baud_rate(uint32_t baud_rate);
+
+#endif /* __STREAM_H */
@@ -0,0 +1,66 @@
+#ifndef __SUPERVISOR_H
+#define __SUPERVISOR_H
+#include "main.h"
+#include <stdint.h>
+
+/* LSI约40kHz 64分频后每个计数1.6ms 2500个计数约4s */
+#define SUPERVISOR_IWDG_RELOAD 2500U
+/* 喂狗和检查心跳的周期 */
+#define SUPERVISOR_CHECK_PERIOD_MS 500U
+/* 备份寄存器中崩溃记录的有效标志 */
+#define SUPERVISOR_CRASH_MAGIC 0xC7A5U
+
+/**
+ * @brief 受监督的任务 工作期间必须在各自的期限内报告进展
+ */
+typedef enum {
+  // AHT20上电初始化和测量流程
+  SUPERVISED_SENSOR = 0,
+  // ESP01S链路的ARQ状态机
+  SUPERVISED_LINK,
+  SUPERVISED_TASK_COUNT
+} SupervisedTask;
+
+typedef enum {
+  CRASH_NONE = 0,
+  // Error_Handler() detail为调用者地址
+  CRASH_ERROR_HANDLER,
+  // HardFault detail为SCB->CFSR
+  CRASH_HARD_FAULT,
+  // 任务心跳超时 detail为超时任务的位掩码
+  CRASH_HEARTBEAT,
+  // 主循环卡住没有喂狗 由复位原因推断
+  CRASH_WATCHDOG,
+} CrashReason;
+
+/**
+ * @brief 保存在备份寄存器中 复位后仍然有效
+ */
+typedef struct {
+  CrashReason reason;
+  uint32_t detail;
+  uint16_t count;
+} CrashRecord;
+
+/**
+ * @brief 读取上一次的崩溃记录 启动独立看门狗和周期检查
+ */
+void supervisor_init(void);
+/**
+ * @brief 任务有进展时调用 同时把任务标记为工作中
+ */
+void supervisor_heartbeat(SupervisedTask task);
+/**
+ * @brief 任务没有待完成的工作 不再检查它的心跳
+ */
+void supervisor_idle(SupervisedTask task);
+/**
+ * @brief 写入崩溃记录 之后通常紧接着复位
+ */
+void supervisor_record_crash(CrashReason reason, uint32_t detail);
+/**
+ * @brief 上电后读出的上一次崩溃记录 reason为CRASH_NONE表示正常复位
+ */
+const CrashRecord *supervisor_last_crash(void);
+
+#endif /* __SUPERVISOR_H */
@@ -0,0 +1,37 @@
+#ifndef __TIMEBASE_H
+#define __TIMEBASE_H
+#include "main.h"
+#include <stdint.h>
+
+/* 上电后第一次同步的延时 给ESP01S留出启动时间 */
+#define TIMEBASE_FIRST_SYNC_MS 2000U
+/* 之后每分钟向ESP01S同步一次 */
+#define TIMEBASE_SYNC_PERIOD_MS 60000U
+/* 115200波特率下10字节的时间应答约1ms */
+#define TIMEBASE_REPLY_TRANSFER_MS 1U
+
+/**
+ * @brief 启动周期同步定时器
+ */
+void timebase_init(void);
+/**
+ * @brief 当前的Unix时间 秒
+ * 以HAL_GetTick()这个32位毫秒计数为基础 加上最近一次同步的偏移
+ *
+ * @return 还没有同步过时返回0 表示时间未知
+ */
+uint32_t timebase_now(void);
+uint8_t timebase_is_synced(void);
+/**
+ * @brief 用ESP01S回复的参考时间校准
+ * ESP01S在串口空闲约1ms后就认为请求收完 随后立即取时间回复
+ * 所以参考时间对应的是回复开始发送的时刻
+ *
+ * @param epoch_seconds 参考时间的秒 为0表示ESP01S自己也还没有时间
+ * @param milliseconds 参考时间的毫秒部分
+ * @param response_tick 收到回复时的HAL_GetTick()
+ */
+void timebase_apply_reference(uint32_t epoch_seconds, uint16_t milliseconds,
+                              uint32_t response_tick);
+
+#endif /* __TIMEBASE_H */
@@ -0,0 +1,42 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+#include "main.h"
+#include <stdint.h>
+
+/* 置0时发送不带追踪信息的普通样本帧 */
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+/**
+ * @brief 一次测量的追踪信息 随样本帧发给ESP01S
+ */
+typedef struct {
+  // 每次测量加1 跳过0 0表示没有追踪信息
+  uint16_t id;
+  // 从发出测量命令到换算完成
+  uint32_t conversion_us;
+  // 换算完成时的trace_now_us()
+  uint32_t converted_at_us;
+} TraceStamp;
+
+/**
+ * @brief 微秒时间 HAL_GetTick()加上SysTick在当前毫秒内的计数
+ * 不用DWT的CYCCNT 高速档和低速档切换时它的频率会变
+ * 约71分钟回绕 只用来求间隔
+ */
+uint32_t trace_now_us(void);
+/**
+ * @brief 发出测量命令时调用
+ */
+void trace_begin(void);
+/**
+ * @brief 换算完成时调用 分配这次测量的trace_id
+ */
+TraceStamp trace_converted(void);
+/**
+ * @brief 从换算完成到现在的时间
+ */
+uint32_t trace_age_us(const TraceStamp *stamp);
+
+#endif /* __TRACE_H */
@@ -44,6 +44,10 @@ void MX_USART2_UART_Init(void);
 void MX_USART3_UART_Init(void);
 
 /* USER CODE BEGIN Prototypes */
+/**
+ * @brief 是否有字节正在移入 此时改波特率会弄坏它
+ */
+uint8_t uart_is_receiving(UART_HandleTypeDef *huart);
 
 /* USER CODE END Prototypes */
 
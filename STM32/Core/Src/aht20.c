@@ -2,49 +2,166 @@
 #include <stdio.h>
 #include <string.h>
 #include "aht20.h"
-#include "i2c.h"
+#include "calibration.h"
+#include "i2c_engine.h"
 #include "main.h"
+#include "msg_pool.h"
 #include "tim.h"
 #include "usart.h"
 #include "communicate.h"
+#include "power.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "stream.h"
+#include "supervisor.h"
+#include "timebase.h"
+#include "trace.h"
 
 #define BUSY_MSG "Busy"
 #define START_MSG "Start"
+/* 上电后至少等40ms才能通信 */
+#define AHT20_POWER_UP_MS 40
+/* 发送校准命令后等待10ms 读状态失败时也按这个间隔重试 */
+#define AHT20_CALIBRATE_MS 10
 AHT20 aht20 = {0};
 
+static void AHT20_TriggerDone(I2CEngineStatus status);
+static void AHT20_ReadDone(I2CEngineStatus status);
+static void AHT20_HandleTriggered(uint32_t status);
+static void AHT20_HandleWaitDone(uint32_t arg);
+static void AHT20_HandleReadDone(uint32_t status);
+static void AHT20_BootStepDone(I2CEngineStatus status);
+static void AHT20_HandleBoot(uint32_t status);
+static void AHT20_BootDone(void);
+static void AHT20_ReportBootTime(void);
+
 void AHT20MeasureTrigger(void) {
-  if (aht20.is_busy) {
-    strcpy(communication_msg, BUSY_MSG);
-    HAL_UART_Transmit_DMA(&huart3, (uint8_t *)communication_msg, strlen(BUSY_MSG));
+  if (aht20.boot_stage != AHT20_BOOT_READY) {
+    // 还在上电初始化 第一次测量会自动进行
+    reply_to_phone(BUSY_MSG);
+  } else if (aht20.is_busy) {
+    reply_to_phone(BUSY_MSG);
     AHT20_DMATxCpltOrWait1MoreTime();
   } else {
-    strcpy(communication_msg, START_MSG);
-    HAL_UART_Transmit_DMA(&huart3, (uint8_t *)communication_msg, strlen(START_MSG));
+    PROFILE_BEGIN();
+    reply_to_phone(START_MSG);
     AHT20_SendMeasurement();
   }
 }
 
 void AHT20_Init(void) {
   aht20 = (AHT20){0};
-  // 上电后等待40ms
-  HAL_Delay(40);
-  HAL_I2C_Master_Receive(&hi2c1, AHT20_ADDRESS, aht20.rx_tx_buffer, 1, HAL_MAX_DELAY);
-  if (!(aht20.rx_tx_buffer[0] & 0x08)) {
-    aht20.rx_tx_buffer[0] = 0xBE;
-    aht20.rx_tx_buffer[1] = 0x08;
-    aht20.rx_tx_buffer[2] = 0x00;
-    HAL_I2C_Master_Transmit(&hi2c1, AHT20_ADDRESS, aht20.rx_tx_buffer, 3, HAL_MAX_DELAY);
+  scheduler_register(EVENT_SENSOR_TRIGGERED, AHT20_HandleTriggered);
+  scheduler_register(EVENT_SENSOR_WAIT_DONE, AHT20_HandleWaitDone);
+  scheduler_register(EVENT_SENSOR_READ_DONE, AHT20_HandleReadDone);
+  scheduler_register(EVENT_SENSOR_BOOT, AHT20_HandleBoot);
+  // SysTick从HAL_Init开始计数 40ms从上电算起 与其余外设初始化同时等待
+  uint32_t elapsed = HAL_GetTick();
+  aht20.boot_stage = AHT20_BOOT_POWER_UP;
+  supervisor_heartbeat(SUPERVISED_SENSOR);
+  scheduler_start_timer(EVENT_SENSOR_BOOT,
+                        elapsed < AHT20_POWER_UP_MS ? AHT20_POWER_UP_MS - elapsed : 0,
+                        0);
+}
+
+static void AHT20_BootStepDone(I2CEngineStatus status) {
+  scheduler_post(EVENT_SENSOR_BOOT, status);
+}
+
+/**
+ * @brief 上电初始化的状态机 每一步由定时器或I2C完成事件推进
+ * 读状态字 未校准时发送校准命令并等待10ms 然后立即做第一次测量
+ */
+static void AHT20_HandleBoot(uint32_t status) {
+  supervisor_heartbeat(SUPERVISED_SENSOR);
+  switch (aht20.boot_stage) {
+  case AHT20_BOOT_POWER_UP: {
+    aht20.boot_stage = AHT20_BOOT_STATUS;
+    I2CTransaction status_poll = {
+        .address = AHT20_ADDRESS,
+        .is_read = 1,
+        .length = 1,
+        .buffer = aht20.rx_tx_buffer,
+        .callback = AHT20_BootStepDone,
+    };
+    i2c_engine_submit(&status_poll);
+    break;
+  }
+  case AHT20_BOOT_STATUS:
+    if (status != I2C_ENGINE_OK) {
+      // 传感器还没准备好 稍后再读
+      aht20.boot_stage = AHT20_BOOT_POWER_UP;
+      scheduler_start_timer(EVENT_SENSOR_BOOT, AHT20_CALIBRATE_MS, 0);
+    } else if (aht20.rx_tx_buffer[0] & 0x08) {
+      AHT20_BootDone();
+    } else {
+      aht20.boot_stage = AHT20_BOOT_CALIBRATE;
+      aht20.rx_tx_buffer[0] = 0xBE;
+      aht20.rx_tx_buffer[1] = 0x08;
+      aht20.rx_tx_buffer[2] = 0x00;
+      I2CTransaction calibrate = {
+          .address = AHT20_ADDRESS,
+          .is_read = 0,
+          .length = 3,
+          .buffer = aht20.rx_tx_buffer,
+          .callback = AHT20_BootStepDone,
+      };
+      i2c_engine_submit(&calibrate);
+    }
+    break;
+  case AHT20_BOOT_CALIBRATE:
+    aht20.boot_stage = AHT20_BOOT_CALIBRATE_WAIT;
+    scheduler_start_timer(EVENT_SENSOR_BOOT, AHT20_CALIBRATE_MS, 0);
+    break;
+  case AHT20_BOOT_CALIBRATE_WAIT:
+    AHT20_BootDone();
+    break;
+  default:
+    break;
   }
 }
 
+/**
+ * @brief 掉电恢复后尽快发布 不等手机的测量命令
+ */
+static void AHT20_BootDone(void) {
+  aht20.boot_stage = AHT20_BOOT_READY;
+  PROFILE_BEGIN();
+  AHT20_SendMeasurement();
+}
+
 void AHT20_SendMeasurement(void) {
   aht20.rx_tx_buffer[0] = 0xAC;
   aht20.rx_tx_buffer[1] = 0x33;
   aht20.rx_tx_buffer[2] = 0x00;
   aht20.is_busy = 1;
-  // 回调函数是AHT20_DMATxCpltOrWait1MoreTime
-  HAL_I2C_Master_Transmit_DMA(&hi2c1, AHT20_ADDRESS, aht20.rx_tx_buffer, 3);
-  __HAL_DMA_DISABLE_IT(hi2c1.hdmatx, DMA_IT_HT);
+  supervisor_heartbeat(SUPERVISED_SENSOR);
+  trace_begin();
+  I2CTransaction trigger = {
+      .address = AHT20_ADDRESS,
+      .is_read = 0,
+      .length = 3,
+      .buffer = aht20.rx_tx_buffer,
+      .callback = AHT20_TriggerDone,
+  };
+  i2c_engine_submit(&trigger);
+  PROFILE_MARK(PROFILE_STAGE_TRIGGER);
+}
+
+static void AHT20_TriggerDone(I2CEngineStatus status) {
+  PROFILE_MARK(PROFILE_STAGE_TX_CPLT);
+  scheduler_post(EVENT_SENSOR_TRIGGERED, status);
+}
+
+static void AHT20_HandleTriggered(uint32_t status) {
+  if (status == I2C_ENGINE_OK) {
+    supervisor_heartbeat(SUPERVISED_SENSOR);
+    AHT20_DMATxCpltOrWait1MoreTime();
+  } else {
+    // 触发失败 放弃这次测量 等下一次命令
+    aht20.is_busy = 0;
+    supervisor_idle(SUPERVISED_SENSOR);
+  }
 }
 
 void AHT20_DMATxCpltOrWait1MoreTime(void) {
@@ -54,13 +171,43 @@ void AHT20_DMATxCpltOrWait1MoreTime(void) {
   HAL_TIM_Base_Start_IT(&htim1);
 }
 
+/**
+ * @brief 状态字和温湿度一次读出 状态字的busy位在AHT20_DMARxCplt中检查
+ */
 void AHT20_GetMeasurement(void) {
-  HAL_I2C_Master_Receive_DMA(&hi2c1, AHT20_ADDRESS, aht20.rx_tx_buffer, 6);
-  __HAL_DMA_DISABLE_IT(hi2c1.hdmarx, DMA_IT_HT);
+  I2CTransaction read = {
+      .address = AHT20_ADDRESS,
+      .is_read = 1,
+      .length = 6,
+      .buffer = aht20.rx_tx_buffer,
+      .callback = AHT20_ReadDone,
+  };
+  i2c_engine_submit(&read);
+}
+
+static void AHT20_ReadDone(I2CEngineStatus status) {
+  PROFILE_MARK(PROFILE_STAGE_RX_CPLT);
+  scheduler_post(EVENT_SENSOR_READ_DONE, status);
+}
+
+static void AHT20_HandleReadDone(uint32_t status) {
+  supervisor_heartbeat(SUPERVISED_SENSOR);
+  if (status == I2C_ENGINE_OK) {
+    AHT20_DMARxCplt();
+  } else {
+    // 读失败时再等一个周期重读
+    AHT20_DMATxCpltOrWait1MoreTime();
+  }
 }
 
 void AHT20_WaitMeasDone(void) {
     HAL_TIM_Base_Stop_IT(&htim1);
+    scheduler_post(EVENT_SENSOR_WAIT_DONE, 0);
+}
+
+static void AHT20_HandleWaitDone(uint32_t arg) {
+    (void)arg;
+    supervisor_heartbeat(SUPERVISED_SENSOR);
     AHT20_GetMeasurement();
 }
 
@@ -73,20 +220,56 @@ void FloatToStringTwoDecimal(float value, char* str) {
 void AHT20_DMARxCplt(void) {
     uint8_t status = aht20.rx_tx_buffer[0];
     if ((status & 0x80) == 0x00) {
+        // 换算 格式化和组帧用高速档
+        power_burst_begin();
         aht20.origin_humidity = (uint32_t)aht20.rx_tx_buffer[1] << 12 | (uint32_t)aht20.rx_tx_buffer[2] << 4 | ((uint32_t)aht20.rx_tx_buffer[3] >> 4 & 0x0F);
         aht20.origin_temperature = ((uint32_t)aht20.rx_tx_buffer[3] & 0x0F) << 16 | (uint32_t)aht20.rx_tx_buffer[4] << 8 | (uint32_t)aht20.rx_tx_buffer[5];
 
         float humidity = (float)aht20.origin_humidity / (1 << 20) * 100.0f;
         float temperature = (float)aht20.origin_temperature / (1 << 20) * 200 - 50;
-        static char msg[40];
+        calibration_apply(aht20.origin_temperature, aht20.origin_humidity,
+                          &temperature, &humidity);
+        // 时间戳在测量完成时取 补发时不会变成发送时间
+        uint32_t timestamp = timebase_now();
+        PROFILE_MARK(PROFILE_STAGE_CONVERT);
+        TraceStamp trace = trace_converted();
         char temp_str[8], humid_str[8];
         FloatToStringTwoDecimal(temperature, temp_str);
         FloatToStringTwoDecimal(humidity, humid_str);
-        sprintf(msg,"温度: %s°C, 湿度: %s%%", temp_str, humid_str);
-        HAL_UART_Transmit(&huart3, (uint8_t *)msg, strlen(msg), HAL_MAX_DELAY);
-        transmit_temp_and_humi_to_esp(temperature, humidity);
+        // 拿不到空闲缓冲时只丢这条显示 订阅模式下只推送二进制帧
+        MsgBuffer *reply = stream_is_active() ? NULL : msg_pool_acquire();
+        if (reply != NULL) {
+            reply->length = snprintf((char *)reply->data, sizeof(reply->data),
+                                     "温度: %s°C, 湿度: %s%%", temp_str, humid_str);
+        }
+        transmit_temp_and_humi_to_esp(temperature, humidity, timestamp, &trace);
+        // 帧已开始发送 发完后在主循环空闲时切回低速档 等ACK时是低速档
+        power_burst_end();
+        if (reply != NULL) {
+            msg_pool_transmit_dma(&huart3, reply);
+        }
+        stream_on_sample(temperature, humidity, timestamp);
+        if (aht20.boot_to_first_sample_ms == 0) {
+            AHT20_ReportBootTime();
+        }
         aht20.is_busy = 0;
+        supervisor_idle(SUPERVISED_SENSOR);
     } else {
         AHT20_DMATxCpltOrWait1MoreTime();
     }
 }
+
+/**
+ * @brief 记录并发送从上电到第一个样本完成的时间
+ */
+static void AHT20_ReportBootTime(void) {
+    aht20.boot_to_first_sample_ms = HAL_GetTick();
+    MsgBuffer *report = msg_pool_acquire();
+    if (report == NULL) {
+        return;
+    }
+    report->length = snprintf((char *)report->data, sizeof(report->data),
+                              "boot: %lu ms\r\n",
+                              (unsigned long)aht20.boot_to_first_sample_ms);
+    msg_pool_transmit_dma(&huart3, report);
+}
@@ -0,0 +1,154 @@
+#include "calibration.h"
+#include "main.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* 20位原始读数乘以段数后 整数部分就是12.20格式中的表索引 */
+#define AXIS_FRACTION_BITS 20U
+
+static uint32_t compute_checksum(const CalibrationTable *table);
+static HAL_StatusTypeDef erase_page(void);
+static q31_t clamp_grid_axis(uint32_t raw);
+static float q31_to_offset(q31_t value);
+
+static const CalibrationTable *active_table = NULL;
+static arm_bilinear_interp_instance_q31 humidity_grid;
+/* 上传过程中的修正表 commit时整体写入flash */
+static CalibrationTable staging = {0};
+
+void calibration_init(void) {
+  const CalibrationTable *table = (const CalibrationTable *)CALIBRATION_ADDRESS;
+  active_table = NULL;
+  if (table->magic != CALIBRATION_MAGIC ||
+      table->checksum != compute_checksum(table)) {
+    return;
+  }
+  humidity_grid.numRows = CALIBRATION_GRID_SIZE;
+  humidity_grid.numCols = CALIBRATION_GRID_SIZE;
+  humidity_grid.pData = (q31_t *)table->humidity_offset;
+  active_table = table;
+}
+
+uint8_t calibration_is_active(void) { return active_table != NULL; }
+
+void calibration_apply(uint32_t raw_temperature, uint32_t raw_humidity,
+                       float *temperature, float *humidity) {
+  if (active_table == NULL) {
+    return;
+  }
+  // 超出最后一个点时arm_linear_interp_q31返回表尾 不会越界
+  q31_t temperature_axis =
+      (q31_t)(raw_temperature * (CALIBRATION_TEMPERATURE_POINTS - 1));
+  q31_t temperature_offset = arm_linear_interp_q31(
+      (q31_t *)active_table->temperature_offset, temperature_axis,
+      CALIBRATION_TEMPERATURE_POINTS);
+  // X沿一行内的湿度点 Y选择温度行
+  q31_t humidity_offset = arm_bilinear_interp_q31(
+      &humidity_grid, clamp_grid_axis(raw_humidity),
+      clamp_grid_axis(raw_temperature));
+
+  *temperature += q31_to_offset(temperature_offset);
+  *humidity += q31_to_offset(humidity_offset);
+  if (*humidity < 0.0f) {
+    *humidity = 0.0f;
+  } else if (*humidity > 100.0f) {
+    *humidity = 100.0f;
+  }
+}
+
+void calibration_upload_begin(void) {
+  memset(&staging, 0, sizeof(staging));
+}
+
+HAL_StatusTypeDef calibration_upload_write(CalibrationTableId table,
+                                           uint8_t start, uint8_t count,
+                                           const uint8_t values[]) {
+  q31_t *destination;
+  uint8_t points;
+  if (table == CALIBRATION_TABLE_TEMPERATURE) {
+    destination = staging.temperature_offset;
+    points = CALIBRATION_TEMPERATURE_POINTS;
+  } else if (table == CALIBRATION_TABLE_HUMIDITY) {
+    destination = staging.humidity_offset;
+    points = CALIBRATION_HUMIDITY_POINTS;
+  } else {
+    return HAL_ERROR;
+  }
+  if ((uint16_t)start + count > points) {
+    return HAL_ERROR;
+  }
+  // 命令中的数据不一定4字节对齐
+  memcpy(&destination[start], values, (size_t)count * sizeof(q31_t));
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef calibration_upload_commit(void) {
+  staging.magic = CALIBRATION_MAGIC;
+  staging.checksum = compute_checksum(&staging);
+
+  // 擦写期间不能再读旧表
+  active_table = NULL;
+  HAL_StatusTypeDef status = erase_page();
+  if (status != HAL_OK) {
+    return status;
+  }
+  const uint32_t *words = (const uint32_t *)&staging;
+  HAL_FLASH_Unlock();
+  for (uint32_t i = 0; i < sizeof(staging) / sizeof(uint32_t); i++) {
+    status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD,
+                               CALIBRATION_ADDRESS + i * sizeof(uint32_t),
+                               words[i]);
+    if (status != HAL_OK) {
+      break;
+    }
+  }
+  HAL_FLASH_Lock();
+  calibration_init();
+  if (status == HAL_OK && !calibration_is_active()) {
+    status = HAL_ERROR;
+  }
+  return status;
+}
+
+HAL_StatusTypeDef calibration_clear(void) {
+  active_table = NULL;
+  return erase_page();
+}
+
+static uint32_t compute_checksum(const CalibrationTable *table) {
+  const uint32_t *words = (const uint32_t *)table;
+  uint32_t sum = 0;
+  for (uint32_t i = 0; i < offsetof(CalibrationTable, checksum) / sizeof(uint32_t);
+       i++) {
+    sum += words[i];
+  }
+  return ~sum;
+}
+
+static HAL_StatusTypeDef erase_page(void) {
+  FLASH_EraseInitTypeDef erase = {0};
+  erase.TypeErase = FLASH_TYPEERASE_PAGES;
+  erase.PageAddress = CALIBRATION_ADDRESS;
+  erase.NbPages = 1;
+  uint32_t page_error = 0;
+
+  HAL_FLASH_Unlock();
+  HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &page_error);
+  HAL_FLASH_Lock();
+  return status;
+}
+
+/**
+ * @brief arm_bilinear_interp_q31会读取索引+1的点 在最后一格末端会越界
+ * 所以把坐标限制在最后一格之内
+ */
+static q31_t clamp_grid_axis(uint32_t raw) {
+  uint32_t axis = raw * (CALIBRATION_GRID_SIZE - 1);
+  uint32_t max_axis = ((CALIBRATION_GRID_SIZE - 1) << AXIS_FRACTION_BITS) - 1;
+  return (q31_t)(axis > max_axis ? max_axis : axis);
+}
+
+static float q31_to_offset(q31_t value) {
+  return (float)value / 2147483648.0f * CALIBRATION_OFFSET_FULL_SCALE;
+}
@@ -1,151 +1,460 @@
 #include "communicate.h"
 #include "aht20.h"
+#include "calibration.h"
 #include "main.h"
+#include "msg_pool.h"
+#include "profiler.h"
+#include "protocol.h"
+#include "sample_log.h"
+#include "scheduler.h"
+#include "stream.h"
+#include "supervisor.h"
+#include "timebase.h"
+#include "trace.h"
 #include "stm32f1xx_hal_def.h"
 #include "stm32f1xx_hal_uart.h"
 #include "usart.h"
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include <sys/_intsup.h>
-static void transmit_with_ARQ(UART_HandleTypeDef *huart2,
-                              uint8_t *communication_msg, uint16_t msg_size);
-static uint8_t is_data_broken(const uint8_t data[], uint16_t length);
+/* 正常情况下的重传次数 超过后认为ESP01S离线 */
+#define ARQ_MAX_ATTEMPTS 3
+/* ESP01S不在时WIFI配置不能一直占着链路 超过后通知手机 */
+#define ARQ_WIFI_MAX_ATTEMPTS 10
+/* 每次发送后等待ACK的时间 */
+#define ARQ_ACK_TIMEOUT_MS 1000
+/* USART2还在忙时 隔这么久再试 不计入重传次数 */
+#define ARQ_BUSY_RETRY_MS 10
+#define ACK_MSG "ACK\r\n"
 
 typedef enum {
-  // 触发AHT20测量
-  HEADER_MEASURE = 0x00,
-  // 设置ESP01S的WIFI连接信息
-  HEADER_SET_WIFI = 0x01,
-} CommandType;
+  // 实时样本 失败时写入flash
+  LINK_FRAME_SAMPLE,
+  // flash中的一批样本 收到ACK后标记为已发送
+  LINK_FRAME_BATCH,
+  LINK_FRAME_WIFI,
+  // 时间同步请求 ESP01S用当前时间代替ACK应答
+  LINK_FRAME_TIME,
+} LinkFrameType;
 
-typedef enum {
-  // SSID长度Header索引
-  INDEX_CHECK_SUM = 1,
-  INDEX_SSID_LENGTH = 2,
-  // 密码长度Header索引
-  INDEX_PASSWORD_LENGTH = 3
-} CommandIndex;
+/**
+ * @brief 正在等待ESP01S应答的一帧 frame为NULL表示链路空闲
+ */
+typedef struct {
+  MsgBuffer *frame;
+  LinkFrameType type;
+  uint8_t attempt;
+  uint8_t max_attempts;
+  // 这一次已发出 正在等ACK 为0时超时事件只是重新发送
+  uint8_t is_sent;
+  float temperature;
+  float humidity;
+  uint32_t timestamp;
+  TraceStamp trace;
+} LinkTransfer;
 
-typedef enum {
-  HEADER_ESP01S_SET_WIFI = 0x00,
-  // 发送温湿度给ESP01S
-  HEADER_ESP01S_RECEIVE_TEMP_AND_HUMI = 0x01
-} ESP01SCommandType;
+static void start_command_receive(void);
+static void handle_command(uint32_t rx_length);
+static void execute_command(const uint8_t command[], uint16_t length);
+static void execute_calibration(const uint8_t command[], uint16_t length);
+static void handle_link_rx(uint32_t rx_length);
+static void handle_link_timeout(uint32_t arg);
+static void start_transfer(MsgBuffer *frame, LinkFrameType type,
+                           uint8_t max_attempts);
+static void send_attempt(void);
+static void retry_or_give_up(void);
+static void finish_transfer(void);
+static void drain_sample_log(void);
+static uint8_t is_data_broken(const uint8_t data[], uint16_t length);
+static void apply_time_reply(uint16_t rx_length);
+
+/* 命令接收一直使用这一块缓冲 */
+static MsgBuffer *command_buffer = NULL;
+/* ESP01S重启或断网时置0 期间的样本先写入flash */
+static uint8_t is_esp_link_up = 1;
+static LinkTransfer link = {0};
+/* 链路忙时收到的WIFI配置 当前这帧结束后发送 */
+static MsgBuffer *queued_wifi_frame = NULL;
+/* ACK或时间同步的应答 */
+static uint8_t link_reply[12] = {0};
+
+void communicate_init(void) {
+  scheduler_register(EVENT_COMMAND_RECEIVED, handle_command);
+  scheduler_register(EVENT_LINK_RX, handle_link_rx);
+  scheduler_register(EVENT_LINK_TIMEOUT, handle_link_timeout);
+  command_buffer = msg_pool_acquire();
+  start_command_receive();
+}
+
+/**
+ * @brief USART3空闲中断只投递事件 在主循环中处理命令
+ */
+void command_rx_event_callback(uint16_t rx_length) {
+  scheduler_post(EVENT_COMMAND_RECEIVED, rx_length);
+}
+
+void link_rx_event_callback(uint16_t rx_length) {
+  scheduler_post(EVENT_LINK_RX, rx_length);
+}
 
 /**
- * @brief 等待 蓝牙模块通过USART3发送的命令
+ * @brief 线程模式下没有空闲缓冲时等待 中断中直接丢弃这条回复
+ */
+void reply_to_phone(const char *text) {
+  MsgBuffer *reply =
+      __get_IPSR() ? msg_pool_acquire() : msg_pool_acquire_wait();
+  if (reply == NULL) {
+    return;
+  }
+  size_t length = strlen(text);
+  if (length > sizeof(reply->data)) {
+    length = sizeof(reply->data);
+  }
+  memcpy(reply->data, text, length);
+  reply->length = (uint16_t)length;
+  msg_pool_transmit_dma(&huart3, reply);
+}
+
+static void start_command_receive(void) {
+  HAL_UARTEx_ReceiveToIdle_IT(&huart3, command_buffer->data,
+                              sizeof(command_buffer->data));
+}
+
+/**
+ * @brief 处理蓝牙模块通过USART3发送的命令
  * 命令格式第一个字节为命令字节，后面跟随参数。
- *
  */
-void wait_for_command(void) {
-  for (uint16_t rx_length = 0;;) {
-    HAL_UARTEx_ReceiveToIdle(&huart3, (uint8_t *)&communication_msg,
-                             sizeof(communication_msg), &rx_length,
-                             HAL_MAX_DELAY);
-    if (is_command_end((uint8_t *)communication_msg, rx_length)) {
-      if (is_data_broken((uint8_t *)communication_msg, rx_length)) {
-        strcpy(communication_msg, "NAK\r\n");
-        HAL_UART_Transmit(&huart3, (uint8_t *)communication_msg,
-                          strlen(communication_msg), HAL_MAX_DELAY);
-        rx_length = 0;
-        continue;
-      } else {
-        char ack_msg[] = "ACK\r\n";
-        HAL_UART_Transmit(&huart3, (uint8_t *)ack_msg, strlen(ack_msg),
-                          HAL_MAX_DELAY);
-        break;
-      }
-    } else {
-      strcpy(communication_msg, "wrong format\r\n");
-      HAL_UART_Transmit(&huart3, (uint8_t *)communication_msg,
-                        strlen(communication_msg), HAL_MAX_DELAY);
-    }
+static void handle_command(uint32_t rx_length) {
+  uint8_t *command = command_buffer->data;
+  if (!is_command_end(command, rx_length)) {
+    reply_to_phone("wrong format\r\n");
+  } else if (is_data_broken(command, rx_length)) {
+    reply_to_phone("NAK\r\n");
+  } else {
+    reply_to_phone("ACK\r\n");
+    command_buffer->length = rx_length;
+    execute_command(command, rx_length);
   }
+  start_command_receive();
+}
 
-  if (communication_msg[0] == HEADER_MEASURE) {
+/**
+ * @brief 按生成的帧格式在接收缓冲上直接解析 长度或字段越界时当作未知命令
+ */
+static void execute_command(const uint8_t command[], uint16_t length) {
+  const ProtocolPhoneSetWifi *wifi;
+  const ProtocolPhoneProfileDump *profile;
+  const ProtocolPhoneSubscribe *subscribe;
+  const ProtocolPhoneSetBaud *baud;
+  if (protocol_phone_measure_view(command, length) != NULL) {
     AHT20MeasureTrigger();
-  } else if (communication_msg[0] == HEADER_SET_WIFI) {
-    SetWIFIConfiguration(communication_msg);
+  } else if ((wifi = protocol_phone_set_wifi_view(command, length)) != NULL) {
+    SetWIFIConfiguration(wifi);
+  } else if ((profile = protocol_phone_profile_dump_view(command, length)) !=
+             NULL) {
+    // 统计输出用阻塞发送 先等排队的回复发完
+    msg_pool_flush(&huart3);
+    profiler_dump(&huart3);
+    if (profile->reset == 0x01) {
+      profiler_reset();
+    }
+  } else if ((subscribe = protocol_phone_subscribe_view(command, length)) !=
+             NULL) {
+    stream_subscribe(subscribe->interval_ms);
+  } else if ((baud = protocol_phone_set_baud_view(command, length)) != NULL) {
+    // ACK还在用旧波特率发送
+    msg_pool_flush(&huart3);
+    if (stream_set_baud_rate(baud->baud_rate) != HAL_OK) {
+      reply_to_phone("unsupported baud\r\n");
+    }
+  } else if (command[0] == PROTOCOL_PHONE_CALIBRATION_WRITE_ID) {
+    execute_calibration(command, length);
   } else {
-    strcpy(communication_msg, "unknown command\r\n");
-    HAL_UART_Transmit(&huart3, (uint8_t *)communication_msg,
-                      strlen(communication_msg), HAL_MAX_DELAY);
-  }
-}
-
-void SetWIFIConfiguration(char upper_msg[]) {
-  /* 1字节命令标识 + 1字节checksum + 1字节表示SSID字节长度 +
-   * 1字节表示SSID密码长度 + SSID最长32字节 + 密码最长63字节 + 1空字符 */
-  uint8_t ssid_length = (uint8_t)upper_msg[INDEX_SSID_LENGTH];
-  uint8_t password_length = (uint8_t)upper_msg[INDEX_PASSWORD_LENGTH];
-
-  char ssid[33] = {0}; // SSID最长32字节 + 1空字符
-  char password[64] = {0};
-
-  uint8_t ssid_start_index = INDEX_PASSWORD_LENGTH + 1;
-  strncpy(ssid, &upper_msg[ssid_start_index], ssid_length);
-  ssid[ssid_length] = '\0';
-
-  uint8_t password_start_index = ssid_start_index + ssid_length;
-  strncpy(password, &upper_msg[password_start_index], password_length);
-  password[password_length] = '\0';
-
-  /*
-  0x00在ESP01S为设置WIFI配置
-  拼接配置数据格式为：
-  0x00 checksum ssid_length password_length ssid password \r\n
-  */
-  communication_msg[0] = 0x00;
-  communication_msg[1] = 0x00; // 初始化校验和为0
-  communication_msg[2] = ssid_length;
-  communication_msg[3] = password_length;
-  uint8_t set_index = 4;
-  memcpy(&communication_msg[set_index], ssid, ssid_length);
-  set_index += ssid_length;
-  memcpy(&communication_msg[set_index], password, password_length);
-  set_index += password_length;
-  communication_msg[set_index] = '\r';
-  set_index++;
-  communication_msg[set_index] = '\n';
-  set_index++;
-  communication_msg[1] = get_checksum((uint8_t *)communication_msg, set_index);
-  communication_msg[set_index] = '\0';
-
-  transmit_with_ARQ(&huart2, (uint8_t *)communication_msg, set_index);
+    reply_to_phone("unknown command\r\n");
+  }
 }
 
 /**
- * @brief 发送温湿度数据到ESP01S
+ * @brief write和其他操作共用命令字 按长度区分
+ * 一帧最多写22个点 湿度网格要分两次写
+ */
+static void execute_calibration(const uint8_t command[], uint16_t length) {
+  HAL_StatusTypeDef status = HAL_ERROR;
+  const ProtocolPhoneCalibrationWrite *write =
+      protocol_phone_calibration_write_view(command, length);
+  const ProtocolPhoneCalibrationControl *control =
+      protocol_phone_calibration_control_view(command, length);
+  if (write != NULL && write->op == PROTOCOL_CALIBRATION_OP_WRITE) {
+    // values在帧中不一定4字节对齐 按字节交给修正表
+    const uint8_t *values =
+        &command[offsetof(ProtocolPhoneCalibrationWrite, values)];
+    status = calibration_upload_write((CalibrationTableId)write->table,
+                                      write->start, write->count, values);
+  } else if (control == NULL) {
+    // 格式不对 回复失败
+  } else if (control->op == PROTOCOL_CALIBRATION_OP_BEGIN) {
+    calibration_upload_begin();
+    status = HAL_OK;
+  } else if (control->op == PROTOCOL_CALIBRATION_OP_COMMIT) {
+    status = calibration_upload_commit();
+  } else if (control->op == PROTOCOL_CALIBRATION_OP_CLEAR) {
+    status = calibration_clear();
+  }
+  reply_to_phone(status == HAL_OK ? "calibration ok\r\n"
+                                  : "calibration failed\r\n");
+}
+
+/**
+ * @brief 把手机发来的WIFI配置原样转发给ESP01S
+ * 两边的帧只有命令字不同 ssid和password直接整段拷贝
+ */
+void SetWIFIConfiguration(const ProtocolPhoneSetWifi *config) {
+  MsgBuffer *frame = msg_pool_acquire_wait();
+  ProtocolEspWifiConfig *esp_msg = protocol_esp_wifi_config_init(frame->data);
+  esp_msg->ssid_length = config->ssid_length;
+  esp_msg->password_length = config->password_length;
+  memcpy(esp_msg->text, config->text,
+         (size_t)config->ssid_length + config->password_length);
+  frame->length = protocol_esp_wifi_config_seal(frame->data);
+
+  if (link.frame != NULL) {
+    // 只保留最新的一次配置
+    msg_pool_release(queued_wifi_frame);
+    queued_wifi_frame = frame;
+    return;
+  }
+  start_transfer(frame, LINK_FRAME_WIFI, ARQ_WIFI_MAX_ATTEMPTS);
+}
+
+/**
+ * @brief 发送温湿度数据到ESP01S 不等待ACK
  * 格式如下
- * 0x01 checksum temperature(4 bytes) humidity(4 bytes) \r\n 一共12字节
+ * 0x01 checksum temperature(4 bytes) humidity(4 bytes) timestamp(4 bytes) \r\n
+ * 一共16字节 TRACE_ENABLED时改用0x04 后面再加trace_id conversion_us age_us
+ * ESP01S离线 链路正忙或flash中还有未补发的样本时 先写入flash再按顺序补发
+ * 补发的样本不带追踪信息
  * @param temperature 
  * @param humidity 
+ * @param timestamp 测量完成时的Unix时间 未同步时为0
+ * @param trace 这次测量的追踪信息
+ */
+void transmit_temp_and_humi_to_esp(float temperature, float humidity,
+                                   uint32_t timestamp, const TraceStamp *trace) {
+  if (link.frame != NULL || !is_esp_link_up || sample_log_has_pending()) {
+    sample_log_append(temperature, humidity, timestamp);
+    if (link.frame == NULL) {
+      drain_sample_log();
+    }
+    return;
+  }
+
+  MsgBuffer *frame = msg_pool_acquire();
+  if (frame == NULL) {
+    sample_log_append(temperature, humidity, timestamp);
+    return;
+  }
+#if TRACE_ENABLED
+  // age_us在每次发送前填写
+  frame->length = protocol_esp_traced_sample_pack(
+      frame->data, temperature, humidity, timestamp, trace->id,
+      trace->conversion_us, 0);
+#else
+  frame->length =
+      protocol_esp_sample_pack(frame->data, temperature, humidity, timestamp);
+#endif
+  PROFILE_MARK(PROFILE_STAGE_FRAME_BUILD);
+  link.temperature = temperature;
+  link.humidity = humidity;
+  link.timestamp = timestamp;
+  link.trace = *trace;
+  start_transfer(frame, LINK_FRAME_SAMPLE, ARQ_MAX_ATTEMPTS);
+}
+
+/**
+ * @brief 从flash取出一批样本发送 收到ACK后在finish_transfer中接着发下一批
+ * 格式如下
+ * 0x02 checksum count
+ * {sequence(2) temperature*100(2) humidity*100(2) timestamp(4)}*count \r\n
+ * 离线时只尝试一次 避免每个新样本都占着链路重传
  */
-void transmit_temp_and_humi_to_esp(float temperature, float humidity) {
-  // 0x01表示发送温湿度
-  communication_msg[0] = HEADER_ESP01S_RECEIVE_TEMP_AND_HUMI;
-  // 初始化校验和为0
-  communication_msg[1] = 0x00;
-  // 温度和湿度各占4字节
-  memcpy(&communication_msg[2], &temperature, sizeof(float));
-  memcpy(&communication_msg[6], &humidity, sizeof(float));
-  communication_msg[10] = '\r';
-  communication_msg[11] = '\n';
-  communication_msg[12] = '\0';
-
-  communication_msg[1] = get_checksum((uint8_t *)communication_msg, 12);
-  transmit_with_ARQ(&huart2, (uint8_t *)communication_msg, 12);
-}
-
-static void transmit_with_ARQ(UART_HandleTypeDef *huart2,
-                              uint8_t *communication_msg, uint16_t msg_size) {
-  static char response_msg[6] = {0};
-  do {
-    HAL_UART_Transmit(huart2, communication_msg, msg_size, HAL_MAX_DELAY);
-    uint16_t rx_length = 0;
-    HAL_UARTEx_ReceiveToIdle(huart2, (uint8_t *)response_msg,
-                             sizeof(response_msg), &rx_length, 1000);
-  } while (strcmp(response_msg, "ACK\r\n") != 0);
+static void drain_sample_log(void) {
+  SampleLogRecord records[SAMPLE_LOG_BATCH_SIZE];
+  uint8_t count = sample_log_peek_batch(records, SAMPLE_LOG_BATCH_SIZE);
+  if (count == 0) {
+    // 只剩已发送或损坏的记录时peek返回0 也要把它们跳过
+    sample_log_commit_batch();
+    return;
+  }
+  MsgBuffer *frame = msg_pool_acquire();
+  if (frame == NULL) {
+    return;
+  }
+  ProtocolEspSampleBatch *batch = protocol_esp_sample_batch_init(frame->data);
+  batch->count = count;
+  for (uint8_t i = 0; i < count; i++) {
+    batch->records[i] = (ProtocolSampleRecord){
+        .sequence = records[i].sequence,
+        .temperature_centi = records[i].temperature,
+        .humidity_centi = records[i].humidity,
+        .timestamp = records[i].timestamp,
+    };
+  }
+  frame->length = protocol_esp_sample_batch_seal(frame->data);
+
+  start_transfer(frame, LINK_FRAME_BATCH,
+                 is_esp_link_up ? ARQ_MAX_ATTEMPTS : 1);
+}
+
+/**
+ * @brief 请求ESP01S的当前时间 链路离线或正忙时跳过
+ * 格式如下
+ * 0x03 checksum \r\n
+ * 只尝试一次 失败不影响链路状态
+ */
+void request_time_sync(void) {
+  if (link.frame != NULL || !is_esp_link_up) {
+    return;
+  }
+  MsgBuffer *frame = msg_pool_acquire();
+  if (frame == NULL) {
+    return;
+  }
+  frame->length = protocol_esp_time_request_pack(frame->data);
+  start_transfer(frame, LINK_FRAME_TIME, 1);
+}
+
+/**
+ * @brief 链路一次只发一帧 帧的所有权交给链路 结束时归还
+ */
+static void start_transfer(MsgBuffer *frame, LinkFrameType type,
+                           uint8_t max_attempts) {
+  link.frame = frame;
+  link.type = type;
+  link.attempt = 0;
+  link.max_attempts = max_attempts;
+  supervisor_heartbeat(SUPERVISED_LINK);
+  send_attempt();
+}
+
+/**
+ * @brief 先挂上接收再发送 避免漏掉很快回来的ACK
+ * USART2正忙时这次不算发出 稍后再试 一直发不出去时由supervisor发现
+ */
+static void send_attempt(void) {
+#if TRACE_ENABLED
+  if (link.type == LINK_FRAME_SAMPLE) {
+    // 重传时样本已经更旧了
+    ProtocolEspTracedSample *sample =
+        (ProtocolEspTracedSample *)link.frame->data;
+    sample->age_us = trace_age_us(&link.trace);
+    protocol_seal(link.frame->data, sizeof(*sample));
+  }
+#endif
+  // 上一次的接收可能还挂着 先停下 再清空它写入的缓冲
+  HAL_UART_AbortReceive(&huart2);
+  memset(link_reply, 0, sizeof(link_reply));
+  if (HAL_UARTEx_ReceiveToIdle_IT(&huart2, link_reply, sizeof(link_reply)) !=
+          HAL_OK ||
+      HAL_UART_Transmit_IT(&huart2, link.frame->data, link.frame->length) !=
+          HAL_OK) {
+    HAL_UART_AbortReceive(&huart2);
+    link.is_sent = 0;
+    scheduler_start_timer(EVENT_LINK_TIMEOUT, ARQ_BUSY_RETRY_MS, 0);
+    return;
+  }
+  supervisor_heartbeat(SUPERVISED_LINK);
+  link.is_sent = 1;
+  scheduler_start_timer(EVENT_LINK_TIMEOUT, ARQ_ACK_TIMEOUT_MS, 0);
+}
+
+static void handle_link_rx(uint32_t rx_length) {
+  if (link.frame == NULL || !link.is_sent) {
+    return;
+  }
+  scheduler_stop_timer(EVENT_LINK_TIMEOUT);
+  if (link.type == LINK_FRAME_TIME) {
+    apply_time_reply(rx_length);
+    finish_transfer();
+    return;
+  }
+  if (rx_length != strlen(ACK_MSG) ||
+      memcmp(link_reply, ACK_MSG, strlen(ACK_MSG)) != 0) {
+    retry_or_give_up();
+    return;
+  }
+
+  if (link.type == LINK_FRAME_SAMPLE) {
+    PROFILE_MARK(PROFILE_STAGE_LINK_ACK);
+  } else if (link.type == LINK_FRAME_BATCH) {
+    sample_log_commit_batch();
+  }
+  if (link.type != LINK_FRAME_WIFI) {
+    is_esp_link_up = 1;
+  }
+  finish_transfer();
+}
+
+static void handle_link_timeout(uint32_t arg) {
+  (void)arg;
+  if (link.frame == NULL) {
+    return;
+  }
+  if (!link.is_sent) {
+    send_attempt();
+    return;
+  }
+  HAL_UART_AbortReceive(&huart2);
+  retry_or_give_up();
+}
+
+static void retry_or_give_up(void) {
+  link.attempt++;
+  if (link.attempt < link.max_attempts) {
+    send_attempt();
+    return;
+  }
+  if (link.type == LINK_FRAME_TIME) {
+    // 旧固件的ESP01S不认识时间请求 不能因此认为链路断开
+    finish_transfer();
+    return;
+  }
+  is_esp_link_up = 0;
+  if (link.type == LINK_FRAME_SAMPLE) {
+    sample_log_append(link.temperature, link.humidity, link.timestamp);
+  } else if (link.type == LINK_FRAME_WIFI) {
+    reply_to_phone("wifi config not delivered\r\n");
+  }
+  finish_transfer();
+}
+
+/**
+ * @brief 一帧结束后依次处理等待中的WIFI配置和flash中的样本
+ */
+static void finish_transfer(void) {
+  msg_pool_release(link.frame);
+  link.frame = NULL;
+  supervisor_idle(SUPERVISED_LINK);
+  if (queued_wifi_frame != NULL) {
+    MsgBuffer *frame = queued_wifi_frame;
+    queued_wifi_frame = NULL;
+    start_transfer(frame, LINK_FRAME_WIFI, ARQ_WIFI_MAX_ATTEMPTS);
+  } else if (is_esp_link_up && sample_log_has_pending()) {
+    drain_sample_log();
+  }
+}
+
+/**
+ * @brief 校验ESP01S回复的时间 格式不对时这一次不同步
+ */
+static void apply_time_reply(uint16_t rx_length) {
+  const ProtocolEspTimeReply *reply =
+      protocol_esp_time_reply_view(link_reply, rx_length);
+  if (reply == NULL || !protocol_is_valid(link_reply, rx_length)) {
+    return;
+  }
+  timebase_apply_reference(reply->epoch_seconds, reply->milliseconds,
+                           HAL_GetTick());
 }
 
 /**
@@ -175,10 +484,3 @@ uint8_t is_command_end(const uint8_t data[], uint16_t length) {
   return (data[length - 2] == '\r' && data[length - 1] == '\n');
 }
 
-uint8_t get_checksum(const uint8_t data[], uint16_t length) {
-  uint8_t checksum = 0;
-  for (uint16_t i = 0; i < length; i++) {
-    checksum += data[i];
-  }
-  return ~checksum;
-}
@@ -21,9 +21,7 @@
 #include "i2c.h"
 
 /* USER CODE BEGIN 0 */
-#include "aht20.h"
 #include "stm32f1xx_hal_i2c.h"
-#include "stm32f1xx_hal_uart.h"
 /* USER CODE END 0 */
 
 I2C_HandleTypeDef hi2c1;
@@ -160,17 +158,5 @@ void HAL_I2C_MspDeInit(I2C_HandleTypeDef* i2cHandle)
 }
 
 /* USER CODE BEGIN 1 */
-void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
-{
-  if (hi2c->Instance == I2C1) {
-    AHT20_DMATxCpltOrWait1MoreTime();
-  }
-}
-
-void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c)
-{
-  if (hi2c->Instance == I2C1) {
-    AHT20_DMARxCplt();
-  }
-}
+/* I2C1的传输由i2c_engine.c直接用LL驱动 不再经过HAL回调 */
 /* USER CODE END 1 */
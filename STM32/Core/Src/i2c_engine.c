@@ -0,0 +1,356 @@
+#include "i2c_engine.h"
+#include "critical.h"
+#include "main.h"
+#include "stm32f1xx_ll_dma.h"
+#include "stm32f1xx_ll_i2c.h"
+#include <stdint.h>
+
+#define ENGINE_I2C I2C1
+#define ENGINE_DMA DMA1
+#define DMA_CHANNEL_TX LL_DMA_CHANNEL_6
+#define DMA_CHANNEL_RX LL_DMA_CHANNEL_7
+#define I2C_GPIO_PORT GPIOB
+#define SCL_PIN GPIO_PIN_6
+#define SDA_PIN GPIO_PIN_7
+/* 最坏情况下从机还差8位数据加1位应答 */
+#define RECOVERY_CLOCK_PULSES 9U
+/* 恢复时按100kHz输出SCL */
+#define RECOVERY_HALF_PERIOD_US 5U
+
+static void configure_peripheral(void);
+static void configure_dma_channel(uint32_t channel, uint32_t direction);
+static void start_next(void);
+static void finish_transaction(I2CEngineStatus status);
+static void stop_dma(void);
+static void delay_us(uint32_t us);
+
+static I2CTransaction queue[I2C_ENGINE_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;
+static volatile uint8_t queue_count = 0;
+static volatile uint8_t is_running = 0;
+/* 写操作时DMA搬完最后一个字节后 还要等BTF才能发STOP */
+static volatile uint8_t is_tx_dma_done = 0;
+static volatile uint32_t transfer_start_tick = 0;
+
+void i2c_engine_init(void) {
+  configure_dma_channel(DMA_CHANNEL_TX, LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+  configure_dma_channel(DMA_CHANNEL_RX, LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+  configure_peripheral();
+  queue_head = 0;
+  queue_count = 0;
+  is_running = 0;
+  // 上次复位时可能正好停在传输中间 从机仍拉住SDA
+  if (LL_I2C_IsActiveFlag_BUSY(ENGINE_I2C)) {
+    i2c_engine_recover_bus();
+  }
+}
+
+void i2c_engine_retime(void) { configure_peripheral(); }
+
+HAL_StatusTypeDef i2c_engine_submit(const I2CTransaction *transaction) {
+  uint32_t primask = enter_critical();
+  if (queue_count >= I2C_ENGINE_QUEUE_SIZE) {
+    exit_critical(primask);
+    return HAL_BUSY;
+  }
+  queue[(queue_head + queue_count) % I2C_ENGINE_QUEUE_SIZE] = *transaction;
+  queue_count++;
+  if (!is_running) {
+    start_next();
+  }
+  exit_critical(primask);
+  return HAL_OK;
+}
+
+uint8_t i2c_engine_is_busy(void) { return is_running || queue_count > 0; }
+
+HAL_StatusTypeDef i2c_engine_wait_idle(uint32_t timeout_ms) {
+  uint32_t start = HAL_GetTick();
+  while (i2c_engine_is_busy()) {
+    if (HAL_GetTick() - start > timeout_ms) {
+      return HAL_TIMEOUT;
+    }
+  }
+  return HAL_OK;
+}
+
+void i2c_engine_recover_bus(void) {
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  LL_I2C_Disable(ENGINE_I2C);
+  HAL_GPIO_WritePin(I2C_GPIO_PORT, SCL_PIN | SDA_PIN, GPIO_PIN_SET);
+  GPIO_InitStruct.Pin = SCL_PIN | SDA_PIN;
+  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+  HAL_GPIO_Init(I2C_GPIO_PORT, &GPIO_InitStruct);
+
+  // 从机在SCL下降沿移出数据 时钟够多时它总会释放SDA
+  for (uint8_t i = 0; i < RECOVERY_CLOCK_PULSES &&
+                      HAL_GPIO_ReadPin(I2C_GPIO_PORT, SDA_PIN) == GPIO_PIN_RESET;
+       i++) {
+    HAL_GPIO_WritePin(I2C_GPIO_PORT, SCL_PIN, GPIO_PIN_RESET);
+    delay_us(RECOVERY_HALF_PERIOD_US);
+    HAL_GPIO_WritePin(I2C_GPIO_PORT, SCL_PIN, GPIO_PIN_SET);
+    delay_us(RECOVERY_HALF_PERIOD_US);
+  }
+
+  // 手动产生STOP: SCL为高时SDA由低变高
+  HAL_GPIO_WritePin(I2C_GPIO_PORT, SCL_PIN, GPIO_PIN_RESET);
+  delay_us(RECOVERY_HALF_PERIOD_US);
+  HAL_GPIO_WritePin(I2C_GPIO_PORT, SDA_PIN, GPIO_PIN_RESET);
+  delay_us(RECOVERY_HALF_PERIOD_US);
+  HAL_GPIO_WritePin(I2C_GPIO_PORT, SCL_PIN, GPIO_PIN_SET);
+  delay_us(RECOVERY_HALF_PERIOD_US);
+  HAL_GPIO_WritePin(I2C_GPIO_PORT, SDA_PIN, GPIO_PIN_SET);
+  delay_us(RECOVERY_HALF_PERIOD_US);
+
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+  HAL_GPIO_Init(I2C_GPIO_PORT, &GPIO_InitStruct);
+
+  // 软件复位清掉卡住的BUSY标志 复位会清空所有配置
+  LL_I2C_EnableReset(ENGINE_I2C);
+  LL_I2C_DisableReset(ENGINE_I2C);
+  configure_peripheral();
+}
+
+void i2c_engine_tick(void) {
+  uint32_t primask = enter_critical();
+  uint8_t is_timeout = is_running && HAL_GetTick() - transfer_start_tick >
+                                         I2C_ENGINE_TIMEOUT_MS;
+  if (is_timeout) {
+    stop_dma();
+    i2c_engine_recover_bus();
+  }
+  exit_critical(primask);
+  // 回调不放在临界区里执行
+  if (is_timeout) {
+    finish_transaction(I2C_ENGINE_TIMEOUT);
+  }
+}
+
+/**
+ * @brief 事件中断 只处理SB ADDR BTF和单字节读的RXNE
+ * 多字节数据全部由DMA搬运
+ */
+void i2c_engine_ev_irq_handler(void) {
+  if (!is_running) {
+    return;
+  }
+  const I2CTransaction *transaction = &queue[queue_head];
+
+  if (LL_I2C_IsActiveFlag_SB(ENGINE_I2C)) {
+    LL_I2C_TransmitData8(ENGINE_I2C, transaction->is_read
+                                         ? (transaction->address | 0x01)
+                                         : transaction->address);
+    return;
+  }
+
+  if (LL_I2C_IsActiveFlag_ADDR(ENGINE_I2C)) {
+    if (transaction->is_read && transaction->length == 1) {
+      // 单字节读不能用DMA 清ADDR前先准备好NACK和STOP
+      LL_I2C_AcknowledgeNextData(ENGINE_I2C, LL_I2C_NACK);
+      LL_I2C_ClearFlag_ADDR(ENGINE_I2C);
+      LL_I2C_GenerateStopCondition(ENGINE_I2C);
+      LL_I2C_EnableIT_BUF(ENGINE_I2C);
+    } else {
+      LL_I2C_ClearFlag_ADDR(ENGINE_I2C);
+    }
+    return;
+  }
+
+  if (LL_I2C_IsActiveFlag_RXNE(ENGINE_I2C) && transaction->is_read &&
+      transaction->length == 1) {
+    transaction->buffer[0] = LL_I2C_ReceiveData8(ENGINE_I2C);
+    LL_I2C_DisableIT_BUF(ENGINE_I2C);
+    finish_transaction(I2C_ENGINE_OK);
+    return;
+  }
+
+  if (LL_I2C_IsActiveFlag_BTF(ENGINE_I2C) && !transaction->is_read &&
+      is_tx_dma_done) {
+    LL_I2C_GenerateStopCondition(ENGINE_I2C);
+    finish_transaction(I2C_ENGINE_OK);
+  }
+}
+
+void i2c_engine_er_irq_handler(void) {
+  I2CEngineStatus status = I2C_ENGINE_BUS_ERROR;
+  if (LL_I2C_IsActiveFlag_AF(ENGINE_I2C)) {
+    LL_I2C_ClearFlag_AF(ENGINE_I2C);
+    LL_I2C_GenerateStopCondition(ENGINE_I2C);
+    status = I2C_ENGINE_NACK;
+  }
+  if (LL_I2C_IsActiveFlag_BERR(ENGINE_I2C)) {
+    LL_I2C_ClearFlag_BERR(ENGINE_I2C);
+  }
+  if (LL_I2C_IsActiveFlag_ARLO(ENGINE_I2C)) {
+    LL_I2C_ClearFlag_ARLO(ENGINE_I2C);
+  }
+  if (LL_I2C_IsActiveFlag_OVR(ENGINE_I2C)) {
+    LL_I2C_ClearFlag_OVR(ENGINE_I2C);
+  }
+  if (!is_running) {
+    return;
+  }
+  stop_dma();
+  if (status == I2C_ENGINE_BUS_ERROR) {
+    i2c_engine_recover_bus();
+  }
+  finish_transaction(status);
+}
+
+void i2c_engine_dma_tx_irq_handler(void) {
+  if (LL_DMA_IsActiveFlag_TE6(ENGINE_DMA)) {
+    LL_DMA_ClearFlag_GI6(ENGINE_DMA);
+    if (is_running) {
+      stop_dma();
+      LL_I2C_GenerateStopCondition(ENGINE_I2C);
+      finish_transaction(I2C_ENGINE_BUS_ERROR);
+    }
+    return;
+  }
+  if (LL_DMA_IsActiveFlag_TC6(ENGINE_DMA)) {
+    LL_DMA_ClearFlag_GI6(ENGINE_DMA);
+    // 最后一个字节还在移位寄存器里 由BTF事件发STOP
+    is_tx_dma_done = 1;
+  }
+}
+
+void i2c_engine_dma_rx_irq_handler(void) {
+  if (LL_DMA_IsActiveFlag_TE7(ENGINE_DMA)) {
+    LL_DMA_ClearFlag_GI7(ENGINE_DMA);
+    if (is_running) {
+      stop_dma();
+      LL_I2C_GenerateStopCondition(ENGINE_I2C);
+      finish_transaction(I2C_ENGINE_BUS_ERROR);
+    }
+    return;
+  }
+  if (LL_DMA_IsActiveFlag_TC7(ENGINE_DMA)) {
+    LL_DMA_ClearFlag_GI7(ENGINE_DMA);
+    // LAST位已让硬件对最后一个字节回NACK
+    LL_I2C_GenerateStopCondition(ENGINE_I2C);
+    finish_transaction(I2C_ENGINE_OK);
+  }
+}
+
+static void configure_peripheral(void) {
+  LL_I2C_InitTypeDef I2C_InitStruct = {0};
+  I2C_InitStruct.PeripheralMode = LL_I2C_MODE_I2C;
+  I2C_InitStruct.ClockSpeed = I2C_ENGINE_CLOCK_SPEED;
+  I2C_InitStruct.DutyCycle = LL_I2C_DUTYCYCLE_2;
+  I2C_InitStruct.OwnAddress1 = 0;
+  I2C_InitStruct.TypeAcknowledge = LL_I2C_ACK;
+  I2C_InitStruct.OwnAddrSize = LL_I2C_OWNADDRESS1_7BIT;
+  LL_I2C_Init(ENGINE_I2C, &I2C_InitStruct);
+
+  // LL按向下取整计算CCR PCLK1为8MHz时会跑到444kHz 改为向上取整
+  uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+  uint32_t period = (pclk1 + I2C_ENGINE_CLOCK_SPEED * 3U - 1U) /
+                    (I2C_ENGINE_CLOCK_SPEED * 3U);
+  LL_I2C_Disable(ENGINE_I2C);
+  MODIFY_REG(ENGINE_I2C->CCR, I2C_CCR_CCR, period);
+  LL_I2C_Enable(ENGINE_I2C);
+
+  LL_I2C_EnableIT_EVT(ENGINE_I2C);
+  LL_I2C_EnableIT_ERR(ENGINE_I2C);
+}
+
+/**
+ * @brief 不开半传输中断 省去HAL里每次都要关HT中断的处理
+ */
+static void configure_dma_channel(uint32_t channel, uint32_t direction) {
+  LL_DMA_InitTypeDef DMA_InitStruct = {0};
+  DMA_InitStruct.PeriphOrM2MSrcAddress = LL_I2C_DMA_GetRegAddr(ENGINE_I2C);
+  DMA_InitStruct.Direction = direction;
+  DMA_InitStruct.Mode = LL_DMA_MODE_NORMAL;
+  DMA_InitStruct.PeriphOrM2MSrcIncMode = LL_DMA_PERIPH_NOINCREMENT;
+  DMA_InitStruct.MemoryOrM2MDstIncMode = LL_DMA_MEMORY_INCREMENT;
+  DMA_InitStruct.PeriphOrM2MSrcDataSize = LL_DMA_PDATAALIGN_BYTE;
+  DMA_InitStruct.MemoryOrM2MDstDataSize = LL_DMA_MDATAALIGN_BYTE;
+  DMA_InitStruct.Priority = LL_DMA_PRIORITY_LOW;
+  LL_DMA_DisableChannel(ENGINE_DMA, channel);
+  LL_DMA_Init(ENGINE_DMA, channel, &DMA_InitStruct);
+  LL_DMA_EnableIT_TC(ENGINE_DMA, channel);
+  LL_DMA_EnableIT_TE(ENGINE_DMA, channel);
+}
+
+/**
+ * @brief 先把DMA准备好再发START 之后由中断推进
+ * 调用者需要处于临界区或中断中
+ */
+static void start_next(void) {
+  if (queue_count == 0) {
+    is_running = 0;
+    return;
+  }
+  const I2CTransaction *transaction = &queue[queue_head];
+  is_running = 1;
+  is_tx_dma_done = 0;
+  transfer_start_tick = HAL_GetTick();
+
+  if (LL_I2C_IsActiveFlag_BUSY(ENGINE_I2C) &&
+      !(ENGINE_I2C->CR1 & I2C_CR1_STOP)) {
+    i2c_engine_recover_bus();
+  }
+  // 等上一次的STOP发完
+  while (ENGINE_I2C->CR1 & I2C_CR1_STOP) {
+  }
+
+  if (transaction->is_read) {
+    LL_I2C_AcknowledgeNextData(ENGINE_I2C, LL_I2C_ACK);
+    if (transaction->length > 1) {
+      LL_DMA_SetMemoryAddress(ENGINE_DMA, DMA_CHANNEL_RX,
+                              (uint32_t)transaction->buffer);
+      LL_DMA_SetDataLength(ENGINE_DMA, DMA_CHANNEL_RX, transaction->length);
+      LL_DMA_EnableChannel(ENGINE_DMA, DMA_CHANNEL_RX);
+      LL_I2C_EnableLastDMA(ENGINE_I2C);
+      LL_I2C_EnableDMAReq_RX(ENGINE_I2C);
+    }
+  } else {
+    LL_DMA_SetMemoryAddress(ENGINE_DMA, DMA_CHANNEL_TX,
+                            (uint32_t)transaction->buffer);
+    LL_DMA_SetDataLength(ENGINE_DMA, DMA_CHANNEL_TX, transaction->length);
+    LL_DMA_EnableChannel(ENGINE_DMA, DMA_CHANNEL_TX);
+    LL_I2C_EnableDMAReq_TX(ENGINE_I2C);
+  }
+  LL_I2C_GenerateStartCondition(ENGINE_I2C);
+}
+
+/**
+ * @brief 出队并回调 回调里可以继续提交新的传输
+ */
+static void finish_transaction(I2CEngineStatus status) {
+  uint32_t primask = enter_critical();
+  stop_dma();
+  I2CEngineCallback callback = queue[queue_head].callback;
+  queue_head = (queue_head + 1) % I2C_ENGINE_QUEUE_SIZE;
+  queue_count--;
+  is_running = 0;
+  exit_critical(primask);
+
+  if (callback != NULL) {
+    callback(status);
+  }
+
+  primask = enter_critical();
+  if (!is_running) {
+    start_next();
+  }
+  exit_critical(primask);
+}
+
+static void stop_dma(void) {
+  LL_I2C_DisableDMAReq_TX(ENGINE_I2C);
+  LL_I2C_DisableDMAReq_RX(ENGINE_I2C);
+  LL_I2C_DisableLastDMA(ENGINE_I2C);
+  LL_DMA_DisableChannel(ENGINE_DMA, DMA_CHANNEL_TX);
+  LL_DMA_DisableChannel(ENGINE_DMA, DMA_CHANNEL_RX);
+}
+
+static void delay_us(uint32_t us) {
+  // 每次循环约4个周期 只用于总线恢复 不需要精确
+  for (volatile uint32_t i = (SystemCoreClock / 4000000U) * us; i > 0; i--) {
+  }
+}
@@ -29,7 +29,17 @@
 #include <stdint.h>
 #include <string.h>
 #include "aht20.h"
+#include "calibration.h"
 #include "communicate.h"
+#include "i2c_engine.h"
+#include "msg_pool.h"
+#include "power.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "stream.h"
+#include "supervisor.h"
+#include "sample_log.h"
+#include "timebase.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -61,7 +71,6 @@ void SystemClock_Config(void);
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
-char communication_msg[99] = {0};
 /* USER CODE END 0 */
 
 /**
@@ -99,16 +108,27 @@ int main(void)
   MX_TIM1_Init();
   MX_USART2_UART_Init();
   /* USER CODE BEGIN 2 */
+  msg_pool_init();
+  scheduler_init();
+  profiler_init();
+  supervisor_init();
+  calibration_init();
+  // AHT20的上电等待尽早开始 与后面的初始化重叠
+  i2c_engine_init();
   AHT20_Init();
+  communicate_init();
+  stream_init();
+  power_init();
+  sample_log_init();
+  timebase_init();
   /* USER CODE END 2 */
 
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
-  strcpy(communication_msg, "hello");
-  HAL_UART_Transmit(&huart3, (uint8_t*)communication_msg, strlen(communication_msg), HAL_MAX_DELAY);
+  reply_to_phone("hello");
   while (1)
   {
-    wait_for_command();
+    scheduler_dispatch();
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
@@ -164,9 +184,10 @@ void Error_Handler(void)
   /* USER CODE BEGIN Error_Handler_Debug */
   /* User can add his own implementation to report the HAL error return state */
   __disable_irq();
-  while (1)
-  {
-  }
+  // 记录出错位置后复位 上电后通过USART3报告
+  supervisor_record_crash(CRASH_ERROR_HANDLER,
+                          (uint32_t)__builtin_return_address(0));
+  NVIC_SystemReset();
   /* USER CODE END Error_Handler_Debug */
 }
 
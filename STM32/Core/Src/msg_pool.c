@@ -0,0 +1,170 @@
+#include "msg_pool.h"
+#include "critical.h"
+#include "main.h"
+#include "usart.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 一个UART的发送队列 head是正在由DMA发送的那一块
+ */
+typedef struct {
+  UART_HandleTypeDef *huart;
+  MsgBuffer *head;
+  MsgBuffer *tail;
+} TxQueue;
+
+static TxQueue *find_queue(UART_HandleTypeDef *huart);
+static HAL_StatusTypeDef start_head(TxQueue *queue);
+
+static MsgBuffer blocks[MSG_POOL_BLOCK_COUNT];
+static MsgBuffer *free_list = NULL;
+static volatile uint8_t free_count = 0;
+/* 只有USART3配置了TX DMA USART2的链路帧由communicate.c用中断发送 */
+static TxQueue tx_queues[] = {
+    {&huart3, NULL, NULL},
+};
+
+void msg_pool_init(void) {
+  free_list = NULL;
+  for (uint8_t i = 0; i < MSG_POOL_BLOCK_COUNT; i++) {
+    blocks[i].next = free_list;
+    free_list = &blocks[i];
+  }
+  free_count = MSG_POOL_BLOCK_COUNT;
+  for (uint8_t i = 0; i < sizeof(tx_queues) / sizeof(tx_queues[0]); i++) {
+    tx_queues[i].head = NULL;
+    tx_queues[i].tail = NULL;
+  }
+}
+
+MsgBuffer *msg_pool_acquire(void) {
+  uint32_t primask = enter_critical();
+  MsgBuffer *buffer = free_list;
+  if (buffer != NULL) {
+    free_list = buffer->next;
+    free_count--;
+  }
+  exit_critical(primask);
+
+  if (buffer != NULL) {
+    buffer->length = 0;
+    buffer->next = NULL;
+  }
+  return buffer;
+}
+
+MsgBuffer *msg_pool_acquire_wait(void) {
+  MsgBuffer *buffer;
+  // 发送完成中断会归还缓冲 SysTick保证最多睡1ms就重新检查
+  while ((buffer = msg_pool_acquire()) == NULL) {
+    __WFI();
+  }
+  return buffer;
+}
+
+void msg_pool_release(MsgBuffer *buffer) {
+  if (buffer == NULL) {
+    return;
+  }
+  uint32_t primask = enter_critical();
+  buffer->next = free_list;
+  free_list = buffer;
+  free_count++;
+  exit_critical(primask);
+}
+
+uint8_t msg_pool_free_count(void) { return free_count; }
+
+HAL_StatusTypeDef msg_pool_transmit_dma(UART_HandleTypeDef *huart,
+                                        MsgBuffer *buffer) {
+  TxQueue *queue = find_queue(huart);
+  if (queue == NULL || buffer->length == 0 ||
+      buffer->length > MSG_POOL_BLOCK_SIZE) {
+    msg_pool_release(buffer);
+    return HAL_ERROR;
+  }
+
+  HAL_StatusTypeDef status = HAL_OK;
+  buffer->next = NULL;
+  uint32_t primask = enter_critical();
+  if (queue->head == NULL) {
+    queue->head = buffer;
+    queue->tail = buffer;
+    status = start_head(queue);
+  } else {
+    queue->tail->next = buffer;
+    queue->tail = buffer;
+  }
+  exit_critical(primask);
+  return status;
+}
+
+void msg_pool_flush(UART_HandleTypeDef *huart) {
+  TxQueue *queue = find_queue(huart);
+  if (queue == NULL) {
+    return;
+  }
+  while (queue->head != NULL) {
+    __WFI();
+  }
+}
+
+uint8_t msg_pool_is_tx_idle(UART_HandleTypeDef *huart) {
+  TxQueue *queue = find_queue(huart);
+  return queue == NULL || queue->head == NULL;
+}
+
+void msg_pool_tx_cplt_callback(UART_HandleTypeDef *huart) {
+  TxQueue *queue = find_queue(huart);
+  if (queue == NULL || queue->head == NULL) {
+    return;
+  }
+  MsgBuffer *done = queue->head;
+  queue->head = done->next;
+  if (queue->head == NULL) {
+    queue->tail = NULL;
+  }
+  msg_pool_release(done);
+  if (queue->head != NULL) {
+    start_head(queue);
+  }
+}
+
+static TxQueue *find_queue(UART_HandleTypeDef *huart) {
+  for (uint8_t i = 0; i < sizeof(tx_queues) / sizeof(tx_queues[0]); i++) {
+    if (tx_queues[i].huart == huart) {
+      return &tx_queues[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief 启动队首的DMA发送 启动失败的块直接归还 接着试下一块
+ * 调用者需要处于临界区或中断中
+ *
+ * @return 原队首的启动结果
+ */
+static HAL_StatusTypeDef start_head(TxQueue *queue) {
+  HAL_StatusTypeDef first_status = HAL_OK;
+  uint8_t is_first = 1;
+  while (queue->head != NULL) {
+    HAL_StatusTypeDef status = HAL_UART_Transmit_DMA(
+        queue->huart, queue->head->data, queue->head->length);
+    if (is_first) {
+      first_status = status;
+      is_first = 0;
+    }
+    if (status == HAL_OK) {
+      break;
+    }
+    MsgBuffer *failed = queue->head;
+    queue->head = failed->next;
+    if (queue->head == NULL) {
+      queue->tail = NULL;
+    }
+    msg_pool_release(failed);
+  }
+  return first_status;
+}
@@ -0,0 +1,207 @@
+#include "power.h"
+#include "i2c_engine.h"
+#include "main.h"
+#include "scheduler.h"
+#include "tim.h"
+#include "usart.h"
+#include <stdint.h>
+
+/* 外部晶振起振期间检查就绪标志的间隔 */
+#define POWER_HSE_POLL_MS 1U
+
+static void handle_hse_probe(uint32_t arg);
+static HAL_StatusTypeDef switch_to_burst(void);
+static HAL_StatusTypeDef switch_to_low(void);
+static uint8_t is_peripheral_busy(void);
+static void retime_peripherals(void);
+static void retime_tim1(void);
+
+static PowerProfile current_profile = POWER_PROFILE_LOW;
+static uint8_t is_hse_available = 0;
+static uint8_t burst_depth = 0;
+/* 打开外部晶振时的HAL_GetTick() */
+static uint32_t hse_probe_start = 0;
+
+/**
+ * @brief 上电时探测外部晶振
+ * HAL_RCC_OscConfig会忙等起振 没有晶振时要等满HSE_STARTUP_TIMEOUT
+ * 所以这里只打开HSE 由handle_hse_probe轮询 只探测这一次
+ * 起振后HSE一直开着 之后的切换只开关PLL和切换SYSCLK
+ */
+void power_init(void) {
+  current_profile = POWER_PROFILE_LOW;
+  burst_depth = 0;
+  is_hse_available = 0;
+  __HAL_RCC_HSE_CONFIG(RCC_HSE_ON);
+  hse_probe_start = HAL_GetTick();
+  scheduler_register(EVENT_POWER_HSE_PROBE, handle_hse_probe);
+  scheduler_start_timer(EVENT_POWER_HSE_PROBE, POWER_HSE_POLL_MS,
+                        POWER_HSE_POLL_MS);
+}
+
+HAL_StatusTypeDef power_set_profile(PowerProfile profile) {
+  if (profile == current_profile) {
+    return HAL_OK;
+  }
+  if (is_peripheral_busy()) {
+    return HAL_BUSY;
+  }
+
+  HAL_StatusTypeDef status;
+  if (profile == POWER_PROFILE_BURST) {
+    status = switch_to_burst();
+  } else {
+    status = switch_to_low();
+  }
+  if (status != HAL_OK) {
+    return status;
+  }
+  current_profile = profile;
+  retime_peripherals();
+  return HAL_OK;
+}
+
+PowerProfile power_get_profile(void) { return current_profile; }
+
+/**
+ * @brief 可嵌套 最外层的begin切到高速档
+ */
+void power_burst_begin(void) {
+  if (burst_depth++ == 0) {
+    power_set_profile(POWER_PROFILE_BURST);
+  }
+}
+
+void power_burst_end(void) {
+  if (burst_depth == 0) {
+    return;
+  }
+  if (--burst_depth == 0) {
+    // 返回HAL_BUSY时由power_sleep_until重试
+    power_set_profile(POWER_PROFILE_LOW);
+  }
+}
+
+void power_sleep_until(volatile uint8_t *wake_flag) {
+  while (!*wake_flag) {
+    if (burst_depth == 0 && current_profile != POWER_PROFILE_LOW) {
+      power_set_profile(POWER_PROFILE_LOW);
+    }
+    __disable_irq();
+    if (!*wake_flag) {
+      // PRIMASK置位时WFI仍会被挂起的中断唤醒 开中断后立即执行对应ISR
+      HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+    }
+    __enable_irq();
+  }
+}
+
+/**
+ * @brief 起振或超时后结束探测
+ * 探测期间is_hse_available为0 高速档用HSI 切换时不碰HSE
+ * 起振成功就让HSE一直开着 每次进入高速档只等PLL锁定 不再等晶振起振
+ */
+static void handle_hse_probe(uint32_t arg) {
+  (void)arg;
+  uint8_t is_ready = __HAL_RCC_GET_FLAG(RCC_FLAG_HSERDY) != RESET;
+  if (!is_ready && HAL_GetTick() - hse_probe_start <= HSE_STARTUP_TIMEOUT) {
+    return;
+  }
+  scheduler_stop_timer(EVENT_POWER_HSE_PROBE);
+  if (!is_ready) {
+    __HAL_RCC_HSE_CONFIG(RCC_HSE_OFF);
+  }
+  is_hse_available = is_ready;
+}
+
+static HAL_StatusTypeDef switch_to_burst(void) {
+  RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+  RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+
+  // HSE在探测成功后一直开着 这里只配置PLL
+  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+  if (is_hse_available) {
+    // 8MHz * 9 = 72MHz
+    RCC_OscInitStruct.HSEPredivValue = RCC_HSE_PREDIV_DIV1;
+    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+    RCC_OscInitStruct.PLL.PLLMUL = RCC_PLL_MUL9;
+  } else {
+    // 4MHz * 16 = 64MHz 这是HSI能达到的最高频率
+    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSI_DIV2;
+    RCC_OscInitStruct.PLL.PLLMUL = RCC_PLL_MUL16;
+  }
+  if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK) {
+    return HAL_ERROR;
+  }
+  // 等PLL锁定期间可能开始收新的字节 切SYSCLK前再查一次
+  if (is_peripheral_busy()) {
+    __HAL_RCC_PLL_DISABLE();
+    return HAL_BUSY;
+  }
+
+  // APB1最高36MHz 需要二分频
+  RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK |
+                                RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+  RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2;
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+  return HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_2);
+}
+
+static HAL_StatusTypeDef switch_to_low(void) {
+  RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+  RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+
+  // 与SystemClock_Config()一致
+  RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK |
+                                RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_HSI;
+  RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK) {
+    return HAL_ERROR;
+  }
+
+  // 已切回HSI 关掉PLL省电 HSE留着下次进入高速档用
+  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_OFF;
+  return HAL_RCC_OscConfig(&RCC_OscInitStruct);
+}
+
+/**
+ * @brief 正在收发的字节会因为时钟切换而损坏
+ * USART3的命令接收和USART2等ACK的接收一直挂着 只在已有字节到来时算忙
+ */
+static uint8_t is_peripheral_busy(void) {
+  return huart2.gState != HAL_UART_STATE_READY ||
+         huart3.gState != HAL_UART_STATE_READY ||
+         uart_is_receiving(&huart2) || uart_is_receiving(&huart3) ||
+         i2c_engine_is_busy();
+}
+
+static void retime_peripherals(void) {
+  uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+  huart2.Instance->BRR = UART_BRR_SAMPLING16(pclk1, huart2.Init.BaudRate);
+  huart3.Instance->BRR = UART_BRR_SAMPLING16(pclk1, huart3.Init.BaudRate);
+  i2c_engine_retime();
+  retime_tim1();
+}
+
+/**
+ * @brief 保持TIM1每个计数为0.1ms 正在计时的75ms等待不受影响
+ */
+static void retime_tim1(void) {
+  // APB2不分频 TIM1时钟等于PCLK2
+  uint32_t prescaler = HAL_RCC_GetPCLK2Freq() / POWER_TIM1_TICK_HZ - 1;
+  uint32_t counter = __HAL_TIM_GET_COUNTER(&htim1);
+  htim1.Init.Prescaler = prescaler;
+  __HAL_TIM_SET_PRESCALER(&htim1, prescaler);
+  // 预分频只在更新事件时装载 置URS使UG不产生更新中断
+  htim1.Instance->CR1 |= TIM_CR1_URS;
+  htim1.Instance->EGR = TIM_EGR_UG;
+  htim1.Instance->CR1 &= ~TIM_CR1_URS;
+  __HAL_TIM_SET_COUNTER(&htim1, counter);
+}
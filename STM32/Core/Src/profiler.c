@@ -0,0 +1,105 @@
+#include "profiler.h"
+#include "main.h"
+#include "trace.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *const kStageNames[PROFILE_STAGE_COUNT] = {
+    "TRIGGER", "TX_CPLT", "TIMER", "RX_CPLT", "CONVERT", "FRAME", "LINK_ACK",
+};
+
+static ProfileStageStats stage_stats[PROFILE_STAGE_COUNT];
+/* 上一次打点时的trace_now_us() */
+static volatile uint32_t last_mark_us = 0;
+static volatile uint8_t is_chain_running = 0;
+
+static uint8_t get_bucket_index(uint32_t us);
+
+void profiler_init(void) { profiler_reset(); }
+
+void profiler_reset(void) {
+  __disable_irq();
+  for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++) {
+    stage_stats[i] = (ProfileStageStats){0};
+    stage_stats[i].min_us = UINT32_MAX;
+  }
+  is_chain_running = 0;
+  __enable_irq();
+}
+
+void profiler_begin(void) {
+  last_mark_us = trace_now_us();
+  is_chain_running = 1;
+}
+
+/**
+ * @brief 会在中断里被调用 只做加法和比较
+ * 计数回绕时无符号减法仍然正确 前提是两次打点间隔小于约71分钟
+ */
+void profiler_mark(ProfileStage stage) {
+  if (!is_chain_running || stage >= PROFILE_STAGE_COUNT) {
+    return;
+  }
+  uint32_t now = trace_now_us();
+  uint32_t elapsed_us = now - last_mark_us;
+  last_mark_us = now;
+
+  ProfileStageStats *stats = &stage_stats[stage];
+  stats->count++;
+  stats->total_us += elapsed_us;
+  if (elapsed_us < stats->min_us) {
+    stats->min_us = elapsed_us;
+  }
+  if (elapsed_us > stats->max_us) {
+    stats->max_us = elapsed_us;
+  }
+  uint16_t *bucket = &stats->histogram[get_bucket_index(elapsed_us)];
+  if (*bucket != UINT16_MAX) {
+    (*bucket)++;
+  }
+
+  if (stage == PROFILE_STAGE_LINK_ACK) {
+    is_chain_running = 0;
+  }
+}
+
+void profiler_get_stats(ProfileStage stage, ProfileStageStats *stats) {
+  __disable_irq();
+  *stats = stage_stats[stage];
+  __enable_irq();
+}
+
+/**
+ * @brief 每个阶段一行 格式如下
+ * NAME n=count min=us max=us mean=us hist=b0,b1,...,b19\r\n
+ */
+void profiler_dump(UART_HandleTypeDef *huart) {
+  char line[200];
+  for (uint8_t stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+    ProfileStageStats stats;
+    profiler_get_stats((ProfileStage)stage, &stats);
+    uint32_t mean_us = stats.count ? (uint32_t)(stats.total_us / stats.count) : 0;
+    uint32_t min_us = stats.count ? stats.min_us : 0;
+    int length = snprintf(line, sizeof(line),
+                          "%s n=%lu min=%lu max=%lu mean=%lu hist=",
+                          kStageNames[stage], (unsigned long)stats.count,
+                          (unsigned long)min_us, (unsigned long)stats.max_us,
+                          (unsigned long)mean_us);
+    for (uint8_t i = 0; i < PROFILER_HISTOGRAM_BUCKETS; i++) {
+      length += snprintf(&line[length], sizeof(line) - length, "%u%s",
+                         stats.histogram[i],
+                         i + 1 < PROFILER_HISTOGRAM_BUCKETS ? "," : "\r\n");
+    }
+    HAL_UART_Transmit(huart, (uint8_t *)line, strlen(line), HAL_MAX_DELAY);
+  }
+}
+
+static uint8_t get_bucket_index(uint32_t us) {
+  if (us == 0) {
+    return 0;
+  }
+  uint8_t index = (uint8_t)(32 - __CLZ(us));
+  return index < PROFILER_HISTOGRAM_BUCKETS ? index
+                                            : PROFILER_HISTOGRAM_BUCKETS - 1;
+}
@@ -0,0 +1,334 @@
+#include "sample_log.h"
+#include "main.h"
+#include "scheduler.h"
+#include "usart.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define ERASED_HALFWORD 0xFFFFU
+#define RECORD_SENT 0x0000U
+/* 链路或命令接收正忙时 隔这么久再试预擦除 */
+#define ERASE_RETRY_MS 10U
+
+typedef struct {
+  uint8_t page;
+  uint16_t slot;
+} LogPosition;
+
+static void handle_erase(uint32_t arg);
+static uint8_t is_uart_idle(void);
+static HAL_StatusTypeDef erase_page(uint8_t page);
+static HAL_StatusTypeDef write_page_header(uint8_t page, uint32_t page_sequence);
+static uint8_t is_page_erased(uint8_t page);
+static uint32_t page_address(uint8_t page);
+static const SampleLogRecord *record_at(LogPosition position);
+static void advance(LogPosition *position);
+static uint8_t is_record_erased(const SampleLogRecord *record);
+static uint8_t is_record_pending(const SampleLogRecord *record);
+static uint16_t find_first_erased_slot(uint8_t page);
+static uint16_t find_next_sequence(uint8_t newest_page, uint8_t valid_pages);
+
+/* 下一条样本写入的位置 slot等于每页条数时表示当前页已写满 */
+static LogPosition write_position = {0};
+/* 最早的未发送样本 */
+static LogPosition read_position = {0};
+/* read_position到write_position之间的槽位数 */
+static uint16_t unread_slots = 0;
+/* 上一次peek走过的槽位数 commit时据此前移read_position */
+static uint16_t peek_slots = 0;
+static uint32_t newest_page_sequence = 0;
+static uint16_t next_sequence = 0;
+/* 写指针所在页的下一页已擦除 换页时不用再擦 */
+static uint8_t is_next_page_erased = 0;
+
+void sample_log_init(void) {
+  scheduler_register(EVENT_SAMPLE_LOG_ERASE, handle_erase);
+  uint8_t valid_pages = 0;
+  uint8_t newest_page = 0;
+  uint8_t oldest_page = 0;
+  uint32_t oldest_page_sequence = UINT32_MAX;
+  newest_page_sequence = 0;
+
+  for (uint8_t page = 0; page < SAMPLE_LOG_PAGE_COUNT; page++) {
+    const SampleLogPageHeader *header =
+        (const SampleLogPageHeader *)page_address(page);
+    if (header->magic != SAMPLE_LOG_MAGIC) {
+      continue;
+    }
+    valid_pages++;
+    if (header->page_sequence >= newest_page_sequence) {
+      newest_page_sequence = header->page_sequence;
+      newest_page = page;
+    }
+    if (header->page_sequence < oldest_page_sequence) {
+      oldest_page_sequence = header->page_sequence;
+      oldest_page = page;
+    }
+  }
+
+  peek_slots = 0;
+  if (valid_pages == 0) {
+    // 第一次使用 日志区还是空的
+    newest_page_sequence = 1;
+    erase_page(0);
+    write_page_header(0, newest_page_sequence);
+    write_position = (LogPosition){0, 0};
+    read_position = write_position;
+    unread_slots = 0;
+    next_sequence = 0;
+    is_next_page_erased = is_page_erased(1);
+    return;
+  }
+
+  write_position.page = newest_page;
+  write_position.slot = find_first_erased_slot(newest_page);
+  next_sequence = find_next_sequence(newest_page, valid_pages);
+
+  // 页是按顺序轮流使用的 从最旧页开头走到写指针 第一条未发送的就是补发起点
+  uint16_t used_slots =
+      (valid_pages - 1) * SAMPLE_LOG_RECORDS_PER_PAGE + write_position.slot;
+  read_position = (LogPosition){oldest_page, 0};
+  unread_slots = used_slots;
+  while (unread_slots > 0 && !is_record_pending(record_at(read_position))) {
+    advance(&read_position);
+    unread_slots--;
+  }
+  is_next_page_erased =
+      is_page_erased((newest_page + 1) % SAMPLE_LOG_PAGE_COUNT);
+  if (!is_next_page_erased) {
+    scheduler_post(EVENT_SAMPLE_LOG_ERASE, 0);
+  }
+}
+
+HAL_StatusTypeDef sample_log_append(float temperature, float humidity,
+                                    uint32_t timestamp) {
+  if (write_position.slot >= SAMPLE_LOG_RECORDS_PER_PAGE) {
+    uint8_t next_page = (write_position.page + 1) % SAMPLE_LOG_PAGE_COUNT;
+    // 预擦除还没轮到 只能在这里等整页擦除
+    if (!is_next_page_erased && erase_page(next_page) != HAL_OK) {
+      return HAL_ERROR;
+    }
+    if (write_page_header(next_page, newest_page_sequence + 1) != HAL_OK) {
+      return HAL_ERROR;
+    }
+    newest_page_sequence++;
+    write_position = (LogPosition){next_page, 0};
+    is_next_page_erased = 0;
+    scheduler_post(EVENT_SAMPLE_LOG_ERASE, 0);
+  }
+
+  SampleLogRecord record = {
+      .sequence = next_sequence,
+      .temperature = protocol_temperature_centi(temperature),
+      .timestamp = timestamp,
+      .humidity = protocol_humidity_centi(humidity),
+      .status = ERASED_HALFWORD,
+  };
+  uint32_t address = (uint32_t)record_at(write_position);
+  HAL_StatusTypeDef status;
+  HAL_FLASH_Unlock();
+  // humidity最后写 作为整条记录写完的标志
+  status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD,
+                             address + offsetof(SampleLogRecord, sequence),
+                             record.sequence);
+  if (status == HAL_OK) {
+    status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD,
+                               address + offsetof(SampleLogRecord, temperature),
+                               (uint16_t)record.temperature);
+  }
+  if (status == HAL_OK) {
+    status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD,
+                               address + offsetof(SampleLogRecord, timestamp),
+                               record.timestamp);
+  }
+  if (status == HAL_OK) {
+    status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD,
+                               address + offsetof(SampleLogRecord, humidity),
+                               record.humidity);
+  }
+  HAL_FLASH_Lock();
+
+  // 即使写失败这个槽位也已被弄脏 跳过它
+  write_position.slot++;
+  unread_slots++;
+  next_sequence++;
+  return status;
+}
+
+uint8_t sample_log_has_pending(void) { return unread_slots > 0; }
+
+uint8_t sample_log_peek_batch(SampleLogRecord records[], uint8_t max_count) {
+  LogPosition position = read_position;
+  uint8_t count = 0;
+  peek_slots = 0;
+  while (peek_slots < unread_slots && count < max_count) {
+    const SampleLogRecord *record = record_at(position);
+    if (is_record_pending(record)) {
+      records[count++] = *record;
+    }
+    advance(&position);
+    peek_slots++;
+  }
+  return count;
+}
+
+void sample_log_commit_batch(void) {
+  if (peek_slots > unread_slots) {
+    peek_slots = unread_slots;
+  }
+  HAL_FLASH_Unlock();
+  for (; peek_slots > 0; peek_slots--) {
+    const SampleLogRecord *record = record_at(read_position);
+    if (is_record_pending(record)) {
+      HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD,
+                        (uint32_t)&record->status, RECORD_SENT);
+    }
+    advance(&read_position);
+    unread_slots--;
+  }
+  HAL_FLASH_Lock();
+}
+
+/**
+ * @brief 把写指针后面的一页擦好 换页时就不用在采样路径上等约20ms的擦除
+ * 擦除期间CPU取指停顿 中断也得不到响应 所以只在USART2没有收发
+ * USART3也没有正在收的命令时进行 否则稍后再试
+ */
+static void handle_erase(uint32_t arg) {
+  (void)arg;
+  if (is_next_page_erased) {
+    return;
+  }
+  if (!is_uart_idle()) {
+    scheduler_start_timer(EVENT_SAMPLE_LOG_ERASE, ERASE_RETRY_MS, 0);
+    return;
+  }
+  uint8_t next_page = (write_position.page + 1) % SAMPLE_LOG_PAGE_COUNT;
+  if (erase_page(next_page) == HAL_OK) {
+    is_next_page_erased = 1;
+  }
+}
+
+/**
+ * @brief 没有正在等的ACK 也没有正在收的字节
+ */
+static uint8_t is_uart_idle(void) {
+  return huart2.gState == HAL_UART_STATE_READY &&
+         huart2.RxState == HAL_UART_STATE_READY &&
+         !uart_is_receiving(&huart3);
+}
+
+/**
+ * @brief 擦掉的是最旧的一页 其中未发送的样本只能丢弃
+ */
+static HAL_StatusTypeDef erase_page(uint8_t page) {
+  if (unread_slots > 0 && read_position.page == page) {
+    uint16_t dropped = SAMPLE_LOG_RECORDS_PER_PAGE - read_position.slot;
+    unread_slots = unread_slots > dropped ? unread_slots - dropped : 0;
+    read_position = unread_slots > 0
+                        ? (LogPosition){(uint8_t)((page + 1) %
+                                                  SAMPLE_LOG_PAGE_COUNT),
+                                        0}
+                        : write_position;
+    // 正在发送的那批可能已被擦掉 作废它 收到ACK时不再标记
+    peek_slots = 0;
+  }
+
+  FLASH_EraseInitTypeDef erase = {0};
+  erase.TypeErase = FLASH_TYPEERASE_PAGES;
+  erase.PageAddress = page_address(page);
+  erase.NbPages = 1;
+  uint32_t page_error = 0;
+  HAL_FLASH_Unlock();
+  HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &page_error);
+  HAL_FLASH_Lock();
+  return status;
+}
+
+/**
+ * @brief 先写page_sequence再写magic 掉电时不会留下序号错误的合法页
+ */
+static HAL_StatusTypeDef write_page_header(uint8_t page,
+                                           uint32_t page_sequence) {
+  uint32_t address = page_address(page);
+  HAL_FLASH_Unlock();
+  HAL_StatusTypeDef status = HAL_FLASH_Program(
+      FLASH_TYPEPROGRAM_WORD,
+      address + offsetof(SampleLogPageHeader, page_sequence), page_sequence);
+  if (status == HAL_OK) {
+    status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD,
+                               address + offsetof(SampleLogPageHeader, magic),
+                               SAMPLE_LOG_MAGIC);
+  }
+  HAL_FLASH_Lock();
+  return status;
+}
+
+/**
+ * @brief 整页都是0xFF 掉电打断的擦除会留下零星的非0xFF字
+ */
+static uint8_t is_page_erased(uint8_t page) {
+  const uint32_t *words = (const uint32_t *)page_address(page);
+  for (uint32_t i = 0; i < FLASH_PAGE_SIZE / sizeof(uint32_t); i++) {
+    if (words[i] != 0xFFFFFFFFU) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static uint32_t page_address(uint8_t page) {
+  return SAMPLE_LOG_START_ADDRESS + (uint32_t)page * FLASH_PAGE_SIZE;
+}
+
+static const SampleLogRecord *record_at(LogPosition position) {
+  uint32_t address = page_address(position.page) + sizeof(SampleLogPageHeader) +
+                     (uint32_t)position.slot * sizeof(SampleLogRecord);
+  return (const SampleLogRecord *)address;
+}
+
+static void advance(LogPosition *position) {
+  position->slot++;
+  if (position->slot >= SAMPLE_LOG_RECORDS_PER_PAGE) {
+    position->slot = 0;
+    position->page = (position->page + 1) % SAMPLE_LOG_PAGE_COUNT;
+  }
+}
+
+static uint8_t is_record_erased(const SampleLogRecord *record) {
+  return record->sequence == ERASED_HALFWORD &&
+         (uint16_t)record->temperature == ERASED_HALFWORD &&
+         record->timestamp == 0xFFFFFFFFU &&
+         record->humidity == ERASED_HALFWORD &&
+         record->status == ERASED_HALFWORD;
+}
+
+/**
+ * @brief 写完整且还没发送 写了一半的记录humidity仍为0xFFFF
+ */
+static uint8_t is_record_pending(const SampleLogRecord *record) {
+  return record->humidity <= PROTOCOL_HUMIDITY_CENTI_MAX &&
+         record->status == ERASED_HALFWORD;
+}
+
+static uint16_t find_first_erased_slot(uint8_t page) {
+  uint16_t slot = SAMPLE_LOG_RECORDS_PER_PAGE;
+  // 从后往前找 最后一个非空槽位之后就是写指针
+  while (slot > 0 && is_record_erased(record_at((LogPosition){page, slot - 1}))) {
+    slot--;
+  }
+  return slot;
+}
+
+static uint16_t find_next_sequence(uint8_t newest_page, uint8_t valid_pages) {
+  LogPosition last = {newest_page, write_position.slot};
+  if (last.slot == 0) {
+    if (valid_pages < 2) {
+      return 0;
+    }
+    last.page = (newest_page + SAMPLE_LOG_PAGE_COUNT - 1) % SAMPLE_LOG_PAGE_COUNT;
+    last.slot = SAMPLE_LOG_RECORDS_PER_PAGE;
+  }
+  last.slot--;
+  return record_at(last)->sequence + 1;
+}
@@ -0,0 +1,90 @@
+#include "scheduler.h"
+#include "critical.h"
+#include "main.h"
+#include "power.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  // 为0表示定时器没有运行
+  uint32_t remaining_ms;
+  uint32_t period_ms;
+} SchedulerTimer;
+
+static SchedulerHandler handlers[EVENT_COUNT];
+static uint32_t event_args[EVENT_COUNT];
+static SchedulerTimer timers[EVENT_COUNT];
+/* 第n位表示第n个事件挂起 */
+static volatile uint32_t pending_events = 0;
+static volatile uint8_t is_event_pending = 0;
+
+void scheduler_init(void) {
+  for (uint8_t i = 0; i < EVENT_COUNT; i++) {
+    handlers[i] = NULL;
+    event_args[i] = 0;
+    timers[i] = (SchedulerTimer){0, 0};
+  }
+  pending_events = 0;
+  is_event_pending = 0;
+}
+
+void scheduler_register(SchedulerEvent event, SchedulerHandler handler) {
+  handlers[event] = handler;
+}
+
+void scheduler_post(SchedulerEvent event, uint32_t arg) {
+  uint32_t primask = enter_critical();
+  event_args[event] = arg;
+  pending_events |= 1UL << event;
+  is_event_pending = 1;
+  exit_critical(primask);
+}
+
+void scheduler_start_timer(SchedulerEvent event, uint32_t delay_ms,
+                           uint32_t period_ms) {
+  uint32_t primask = enter_critical();
+  // 至少等一个完整的tick
+  timers[event].remaining_ms = delay_ms + 1;
+  timers[event].period_ms = period_ms;
+  exit_critical(primask);
+}
+
+void scheduler_stop_timer(SchedulerEvent event) {
+  uint32_t primask = enter_critical();
+  timers[event] = (SchedulerTimer){0, 0};
+  exit_critical(primask);
+}
+
+void scheduler_dispatch(void) {
+  uint32_t primask = enter_critical();
+  uint32_t pending = pending_events;
+  if (pending == 0) {
+    is_event_pending = 0;
+    exit_critical(primask);
+    power_sleep_until(&is_event_pending);
+    return;
+  }
+  // 最低位的事件优先级最高
+  SchedulerEvent event = (SchedulerEvent)__CLZ(__RBIT(pending));
+  uint32_t arg = event_args[event];
+  pending_events = pending & ~(1UL << event);
+  exit_critical(primask);
+
+  if (handlers[event] != NULL) {
+    handlers[event](arg);
+  }
+}
+
+void scheduler_tick(void) {
+  // SysTick优先级最低 其他中断可能在这里投递事件或重设定时器
+  uint32_t primask = enter_critical();
+  for (uint8_t i = 0; i < EVENT_COUNT; i++) {
+    if (timers[i].remaining_ms == 0 || --timers[i].remaining_ms > 0) {
+      continue;
+    }
+    timers[i].remaining_ms = timers[i].period_ms;
+    pending_events |= 1UL << i;
+    is_event_pending = 1;
+  }
+  exit_critical(primask);
+}
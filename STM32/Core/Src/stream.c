@@ -0,0 +1,114 @@
+#include "stream.h"
+#include "aht20.h"
+#include "main.h"
+#include "msg_pool.h"
+#include "profiler.h"
+#include "protocol.h"
+#include "scheduler.h"
+#include "usart.h"
+#include <stdint.h>
+
+static void handle_stream_tick(uint32_t arg);
+static void send_pending_sample(void);
+
+/* 蓝牙串口模块支持的波特率 */
+static const uint32_t kSupportedBaudRates[] = {9600, 19200, 38400, 57600,
+                                               115200};
+
+static uint16_t stream_interval_ms = 0;
+static uint16_t stream_sequence = 0;
+/* 链路忙时暂存的最新样本 */
+static uint8_t has_pending_sample = 0;
+static int16_t pending_temperature = 0;
+static uint16_t pending_humidity = 0;
+static uint32_t pending_timestamp = 0;
+/* 上一帧之后被合并掉的样本数 */
+static uint8_t coalesced_count = 0;
+
+void stream_init(void) {
+  scheduler_register(EVENT_STREAM_TICK, handle_stream_tick);
+}
+
+void stream_subscribe(uint16_t interval_ms) {
+  has_pending_sample = 0;
+  coalesced_count = 0;
+  if (interval_ms == 0) {
+    stream_interval_ms = 0;
+    scheduler_stop_timer(EVENT_STREAM_TICK);
+    return;
+  }
+  if (interval_ms < STREAM_MIN_INTERVAL_MS) {
+    interval_ms = STREAM_MIN_INTERVAL_MS;
+  }
+  stream_interval_ms = interval_ms;
+  stream_sequence = 0;
+  scheduler_start_timer(EVENT_STREAM_TICK, 0, interval_ms);
+}
+
+uint8_t stream_is_active(void) { return stream_interval_ms != 0; }
+
+void stream_on_sample(float temperature, float humidity, uint32_t timestamp) {
+  if (!stream_is_active()) {
+    return;
+  }
+  if (has_pending_sample && coalesced_count < UINT8_MAX) {
+    coalesced_count++;
+  }
+  pending_temperature = protocol_temperature_centi(temperature);
+  pending_humidity = protocol_humidity_centi(humidity);
+  pending_timestamp = timestamp;
+  has_pending_sample = 1;
+  send_pending_sample();
+}
+
+HAL_StatusTypeDef stream_set_baud_rate(uint32_t baud_rate) {
+  uint8_t is_supported = 0;
+  for (uint8_t i = 0;
+       i < sizeof(kSupportedBaudRates) / sizeof(kSupportedBaudRates[0]); i++) {
+    is_supported |= kSupportedBaudRates[i] == baud_rate;
+  }
+  if (!is_supported) {
+    return HAL_ERROR;
+  }
+  // power.c切换时钟时也按Init.BaudRate重算BRR
+  huart3.Init.BaudRate = baud_rate;
+  huart3.Instance->BRR =
+      UART_BRR_SAMPLING16(HAL_RCC_GetPCLK1Freq(), huart3.Init.BaudRate);
+  return HAL_OK;
+}
+
+/**
+ * @brief 到点时触发一次测量 上一次还没完成就跳过
+ * 同时把之前因链路忙而积压的样本发出去
+ */
+static void handle_stream_tick(uint32_t arg) {
+  (void)arg;
+  send_pending_sample();
+  if (aht20.boot_stage != AHT20_BOOT_READY || aht20.is_busy) {
+    return;
+  }
+  PROFILE_BEGIN();
+  AHT20_SendMeasurement();
+}
+
+/**
+ * @brief 9600波特率下一帧约11ms 上一帧还在队列里时不再排队
+ * 新样本覆盖暂存的旧样本 帧中的coalesced告诉对端丢了几个
+ */
+static void send_pending_sample(void) {
+  if (!has_pending_sample || !msg_pool_is_tx_idle(&huart3)) {
+    return;
+  }
+  MsgBuffer *frame = msg_pool_acquire();
+  if (frame == NULL) {
+    return;
+  }
+  frame->length = protocol_phone_stream_sample_pack(
+      frame->data, stream_sequence, pending_temperature, pending_humidity,
+      pending_timestamp, coalesced_count);
+
+  stream_sequence++;
+  has_pending_sample = 0;
+  coalesced_count = 0;
+  msg_pool_transmit_dma(&huart3, frame);
+}
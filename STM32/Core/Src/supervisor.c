@@ -0,0 +1,137 @@
+#include "supervisor.h"
+#include "main.h"
+#include "msg_pool.h"
+#include "scheduler.h"
+#include "usart.h"
+#include <stdint.h>
+#include <stdio.h>
+
+static void handle_supervisor_tick(uint32_t arg);
+static void enable_backup_access(void);
+static void load_crash_record(void);
+static void report_last_crash(void);
+
+/* 任务工作期间两次心跳之间允许的最长时间 */
+static const uint32_t kTaskDeadlineMs[SUPERVISED_TASK_COUNT] = {
+    // 一次测量约80ms 传感器忙时每75ms重读一次
+    1000,
+    // 每次发送后最多等1s的ACK
+    3000,
+};
+static const char *const kCrashReasonNames[] = {
+    "NONE", "ERROR_HANDLER", "HARD_FAULT", "HEARTBEAT", "WATCHDOG",
+};
+
+static IWDG_HandleTypeDef hiwdg;
+static uint32_t last_heartbeat[SUPERVISED_TASK_COUNT];
+/* 第n位表示第n个任务正在工作 */
+static uint8_t active_tasks = 0;
+static CrashRecord last_crash = {0};
+
+void supervisor_init(void) {
+  enable_backup_access();
+  load_crash_record();
+  __HAL_RCC_CLEAR_RESET_FLAGS();
+
+  active_tasks = 0;
+  scheduler_register(EVENT_SUPERVISOR_TICK, handle_supervisor_tick);
+  scheduler_start_timer(EVENT_SUPERVISOR_TICK, SUPERVISOR_CHECK_PERIOD_MS,
+                        SUPERVISOR_CHECK_PERIOD_MS);
+
+  // 调试器暂停内核时看门狗也暂停
+  __HAL_DBGMCU_FREEZE_IWDG();
+  hiwdg.Instance = IWDG;
+  hiwdg.Init.Prescaler = IWDG_PRESCALER_64;
+  hiwdg.Init.Reload = SUPERVISOR_IWDG_RELOAD;
+  HAL_IWDG_Init(&hiwdg);
+
+  report_last_crash();
+}
+
+void supervisor_heartbeat(SupervisedTask task) {
+  last_heartbeat[task] = HAL_GetTick();
+  active_tasks |= 1U << task;
+}
+
+void supervisor_idle(SupervisedTask task) { active_tasks &= ~(1U << task); }
+
+/**
+ * @brief 可能在外设初始化之前或HardFault中调用 自己打开备份域
+ * magic最后写入 写到一半复位时不会留下半条记录
+ */
+void supervisor_record_crash(CrashReason reason, uint32_t detail) {
+  enable_backup_access();
+  BKP->DR2 = (uint16_t)reason;
+  BKP->DR3 = (uint16_t)(detail & 0xFFFF);
+  BKP->DR4 = (uint16_t)(detail >> 16);
+  BKP->DR5 = (uint16_t)(BKP->DR5 + 1);
+  BKP->DR1 = SUPERVISOR_CRASH_MAGIC;
+}
+
+const CrashRecord *supervisor_last_crash(void) { return &last_crash; }
+
+/**
+ * @brief 所有工作中的任务都按时报告了进展才喂狗
+ * 某个任务卡住时记录后立即复位 不等看门狗超时
+ * 主循环本身卡住时这里不会运行 由看门狗在约4s后复位
+ */
+static void handle_supervisor_tick(uint32_t arg) {
+  (void)arg;
+  uint32_t now = HAL_GetTick();
+  uint8_t stalled_tasks = 0;
+  for (uint8_t task = 0; task < SUPERVISED_TASK_COUNT; task++) {
+    if ((active_tasks & (1U << task)) &&
+        now - last_heartbeat[task] > kTaskDeadlineMs[task]) {
+      stalled_tasks |= 1U << task;
+    }
+  }
+  if (stalled_tasks != 0) {
+    supervisor_record_crash(CRASH_HEARTBEAT, stalled_tasks);
+    NVIC_SystemReset();
+  }
+  HAL_IWDG_Refresh(&hiwdg);
+}
+
+static void enable_backup_access(void) {
+  __HAL_RCC_PWR_CLK_ENABLE();
+  __HAL_RCC_BKP_CLK_ENABLE();
+  HAL_PWR_EnableBkUpAccess();
+}
+
+/**
+ * @brief 备份寄存器DR1~DR5: magic reason detail低16位 detail高16位 累计次数
+ * 没有记录但复位原因是看门狗时 说明主循环卡住了
+ */
+static void load_crash_record(void) {
+  if (BKP->DR1 == SUPERVISOR_CRASH_MAGIC) {
+    last_crash.reason = (CrashReason)BKP->DR2;
+    last_crash.detail = (uint32_t)BKP->DR3 | (uint32_t)BKP->DR4 << 16;
+  } else if (__HAL_RCC_GET_FLAG(RCC_FLAG_IWDGRST)) {
+    last_crash.reason = CRASH_WATCHDOG;
+    last_crash.detail = 0;
+    BKP->DR5 = (uint16_t)(BKP->DR5 + 1);
+  } else {
+    last_crash.reason = CRASH_NONE;
+    last_crash.detail = 0;
+  }
+  last_crash.count = (uint16_t)BKP->DR5;
+  // 已经读出 下次复位不再重复报告
+  BKP->DR1 = 0;
+}
+
+static void report_last_crash(void) {
+  if (last_crash.reason == CRASH_NONE ||
+      last_crash.reason > CRASH_WATCHDOG) {
+    return;
+  }
+  MsgBuffer *report = msg_pool_acquire();
+  if (report == NULL) {
+    return;
+  }
+  report->length = snprintf((char *)report->data, sizeof(report->data),
+                            "crash: %s detail=0x%08lx count=%u\r\n",
+                            kCrashReasonNames[last_crash.reason],
+                            (unsigned long)last_crash.detail,
+                            last_crash.count);
+  msg_pool_transmit_dma(&huart3, report);
+}
@@ -22,6 +22,7 @@
 
 /* USER CODE BEGIN 0 */
 #include "aht20.h"
+#include "profiler.h"
 /* USER CODE END 0 */
 
 TIM_HandleTypeDef htim1;
@@ -111,6 +112,7 @@ void HAL_TIM_Base_MspDeInit(TIM_HandleTypeDef* tim_baseHandle)
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
   if (htim->Instance == TIM1) {
+    PROFILE_MARK(PROFILE_STAGE_TIMER_EXPIRE);
     AHT20_WaitMeasDone();
   }
 }
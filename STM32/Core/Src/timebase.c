@@ -0,0 +1,48 @@
+#include "timebase.h"
+#include "communicate.h"
+#include "main.h"
+#include "scheduler.h"
+#include <stdint.h>
+
+static void handle_time_sync(uint32_t arg);
+
+/* 同步时刻的Unix时间 以毫秒计 */
+static uint64_t sync_epoch_ms = 0;
+/* 同步时刻的HAL_GetTick() */
+static uint32_t sync_tick = 0;
+static uint8_t is_synced = 0;
+
+void timebase_init(void) {
+  scheduler_register(EVENT_TIME_SYNC, handle_time_sync);
+  scheduler_start_timer(EVENT_TIME_SYNC, TIMEBASE_FIRST_SYNC_MS,
+                        TIMEBASE_SYNC_PERIOD_MS);
+}
+
+uint32_t timebase_now(void) {
+  if (!is_synced) {
+    return 0;
+  }
+  // 无符号相减 计数回绕后仍然正确
+  uint32_t elapsed_ms = HAL_GetTick() - sync_tick;
+  return (uint32_t)((sync_epoch_ms + elapsed_ms) / 1000U);
+}
+
+uint8_t timebase_is_synced(void) { return is_synced; }
+
+void timebase_apply_reference(uint32_t epoch_seconds, uint16_t milliseconds,
+                              uint32_t response_tick) {
+  if (epoch_seconds == 0) {
+    return;
+  }
+  sync_epoch_ms = (uint64_t)epoch_seconds * 1000U + milliseconds;
+  sync_tick = response_tick - TIMEBASE_REPLY_TRANSFER_MS;
+  is_synced = 1;
+}
+
+/**
+ * @brief 链路正忙时跳过这一次 等下一个周期
+ */
+static void handle_time_sync(uint32_t arg) {
+  (void)arg;
+  request_time_sync();
+}
@@ -0,0 +1,50 @@
+#include "trace.h"
+#include "main.h"
+#include <stdint.h>
+
+static uint16_t last_trace_id = 0;
+/* 最近一次发出测量命令时的trace_now_us() */
+static uint32_t begin_us = 0;
+
+/**
+ * @brief 两次读到的毫秒数相同才用中间读到的SysTick计数
+ * 否则读VAL时刚好跨过一毫秒 重新读
+ * 在比SysTick优先级高的中断或关中断时调用 计数器可能已重装而uwTick还没加1
+ * 这时SysTick中断挂起 VAL接近LOAD 补上这1ms
+ */
+uint32_t trace_now_us(void) {
+  uint32_t tick;
+  uint32_t value;
+  uint8_t is_tick_pending;
+  do {
+    tick = HAL_GetTick();
+    value = SysTick->VAL;
+    is_tick_pending = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+  } while (tick != HAL_GetTick());
+  // SysTick向下计数 LOAD+1个时钟为1ms 切换时钟档位时HAL会重设LOAD
+  uint32_t period = SysTick->LOAD + 1U;
+  // 读VAL之后才重装的 VAL接近0 不能补
+  if (is_tick_pending && value > period / 2U) {
+    tick++;
+  }
+  return tick * 1000U + (period - 1U - value) * 1000U / period;
+}
+
+void trace_begin(void) { begin_us = trace_now_us(); }
+
+TraceStamp trace_converted(void) {
+  uint32_t now = trace_now_us();
+  last_trace_id++;
+  if (last_trace_id == 0) {
+    last_trace_id = 1;
+  }
+  return (TraceStamp){
+      .id = last_trace_id,
+      .conversion_us = now - begin_us,
+      .converted_at_us = now,
+  };
+}
+
+uint32_t trace_age_us(const TraceStamp *stamp) {
+  return trace_now_us() - stamp->converted_at_us;
+}
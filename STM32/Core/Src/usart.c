@@ -22,6 +22,8 @@
 #include "usart.h"
 
 /* USER CODE BEGIN 0 */
+#include "communicate.h"
+#include "msg_pool.h"
 /* USER CODE END 0 */
 
 UART_HandleTypeDef huart2;
@@ -115,7 +117,9 @@ void HAL_UART_MspInit(UART_HandleTypeDef* uartHandle)
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
   /* USER CODE BEGIN USART2_MspInit 1 */
-
+    /* ESP01S链路用中断收发 */
+    HAL_NVIC_SetPriority(USART2_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
   /* USER CODE END USART2_MspInit 1 */
   }
   else if(uartHandle->Instance==USART3)
@@ -185,7 +189,7 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* uartHandle)
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_2|GPIO_PIN_3);
 
   /* USER CODE BEGIN USART2_MspDeInit 1 */
-
+    HAL_NVIC_DisableIRQ(USART2_IRQn);
   /* USER CODE END USART2_MspDeInit 1 */
   }
   else if(uartHandle->Instance==USART3)
@@ -214,4 +218,38 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* uartHandle)
 }
 
 /* USER CODE BEGIN 1 */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+  if (huart->Instance == USART3) {
+    command_rx_event_callback(Size);
+  } else if (huart->Instance == USART2) {
+    link_rx_event_callback(Size);
+  }
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+  msg_pool_tx_cplt_callback(huart);
+}
+
+/**
+  * @brief F1的USART没有BUSY标志 按以下任一情况认为正在接收
+  * 数据寄存器中有未取走的字节 挂着的接收已收到一部分还没等到空闲
+  * RX引脚为低 即正处于起始位或数据位中
+  */
+uint8_t uart_is_receiving(UART_HandleTypeDef *huart)
+{
+  if (__HAL_UART_GET_FLAG(huart, UART_FLAG_RXNE)) {
+    return 1;
+  }
+  if (huart->RxState == HAL_UART_STATE_BUSY_RX &&
+      huart->RxXferCount != huart->RxXferSize) {
+    return 1;
+  }
+  // 空闲时线路为高电平 USART2_RX为PA3 USART3_RX为PB11
+  if (huart->Instance == USART2) {
+    return HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_3) == GPIO_PIN_RESET;
+  }
+  return HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_11) == GPIO_PIN_RESET;
+}
 /* USER CODE END 1 */